@@ -0,0 +1,688 @@
+#include "../shared/board.h"
+#include "../shared/constants.h"
+#include "../shared/engine.h"
+#include "../shared/evaluation.h"
+#include "../shared/game_log.h"
+#include "../shared/mask_cache.h"
+#include "../shared/multiplayer.h"
+#include "../shared/observation.h"
+#include "../shared/perft.h"
+#include "../shared/replay.h"
+#include "../shared/sampling.h"
+#include "../shared/simd_mask.h"
+#include "../shared/undo.h"
+#include "../shared/vec_env.h"
+#ifdef BENCH_WITH_TORCH
+#include "../ext/chinese_checkers.h"
+#endif
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+static void print_usage() {
+    std::cerr << "Usage: ./build/bench [-n <n_positions>] [-r <repeats>] [-d <max_perft_depth>] [-o <json_file>] [--perft]\n"
+              << "  writes the perft counts and ns/op of every benchmark as JSON to stdout (or -o).\n"
+              << "  --perft only runs the perft suite and the make/unmake and replay checks. exits with 1 if a count, a\n"
+              << "  mask, an unmake or a replay seek is off\n";
+    std::exit(1);
+}
+
+// the pre-table version of set_action_mask, kept as the baseline: neighbors are rebuilt from the row
+// parity offsets and every target goes through is_valid_cell
+static void set_action_mask_neighbors(GameState_t game_state, int* dest) {
+    auto player = *game_state.current_player;
+    auto last_skipped_piece = *game_state.last_skipped_piece;
+    auto skip_move = last_skipped_piece != -1;
+    auto last_direction = *game_state.last_direction;
+
+    for (int i = 0; i < (int)N_PIECES_PER_PLAYER; i++) {
+        if (skip_move && last_skipped_piece != i) {
+            continue;
+        }
+        auto piece = (player == 1) ? game_state.player_1_pieces[i] : game_state.player_2_pieces[i];
+        auto neighbors = get_neighbors(piece, true);
+        for (int j = 0; j < (int)N_DIRECTIONS; j++) {
+            auto one_step = neighbors[j];
+            if (!is_valid_cell(one_step)) {
+                continue;
+            }
+            if (!game_state.occupied(one_step)) {
+                if (!skip_move) {
+                    dest[i * N_DIRECTIONS + j] = 1;
+                }
+            } else {
+                auto offset = double_step_neighbors[j];
+                point_t two_step = {piece.first + offset[0], piece.second + offset[1]};
+                if (!is_valid_cell(two_step) || game_state.occupied(two_step)) {
+                    continue;
+                }
+                if (skip_move && (((last_direction - j + N_DIRECTIONS) % N_DIRECTIONS) == 3)) {
+                    continue;
+                }
+                dest[i * N_DIRECTIONS + j] = 1;
+            }
+        }
+    }
+    if (skip_move) {
+        dest[N_MOVES - 1] = 1;
+    }
+}
+
+static int sample_legal_move(GameState_t game_state, std::mt19937& rng) {
+    int mask[N_MOVES] = {0};
+    set_action_mask(game_state, mask);
+    int legal[N_MOVES];
+    int n_legal = 0;
+    for (int k = 0; k < (int)N_MOVES; k++) {
+        if (mask[k])
+            legal[n_legal++] = k;
+    }
+    return legal[rng() % n_legal];
+}
+
+// n_positions states reached by random play from the start position, so the benchmark sees a mix of
+// opening, mid-game and mid-hop positions
+static std::vector<int> random_positions(int n_positions, std::mt19937& rng) {
+    std::vector<int> states(n_positions * TOTAL_STATE);
+    for (int i = 0; i < n_positions; i++) {
+        GameState_t game_state(states.data() + i * TOTAL_STATE);
+        initialize_state(game_state);
+        int n_moves = rng() % 400;
+        for (int m = 0; m < n_moves && *game_state.winner == 0; m++) {
+            update_state(game_state, sample_legal_move(game_state, rng));
+        }
+    }
+    return states;
+}
+
+struct bench_result_t {
+    std::string name;
+    int batch;
+    double ns_per_op;
+};
+
+static const int N_PERFT_GENERATORS = 4;
+
+struct perft_result_t {
+    std::string position;
+    int depth;
+    uint64_t expected;
+    // nodes and ns/node of perft, perft_bitboard, perft_mask_cache and the 2-player perft_multiplayer
+    uint64_t nodes[N_PERFT_GENERATORS];
+    double ns_per_node[N_PERFT_GENERATORS];
+};
+
+static const char* perft_generators[N_PERFT_GENERATORS] = {"tables", "bitboard", "mask_cache", "multiplayer"};
+
+template <typename F>
+static double seconds_of(const F& fn) {
+    auto start = std::chrono::high_resolution_clock::now();
+    fn();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+static bool run_perft(int max_depth, std::vector<perft_result_t>& results) {
+    bool ok = true;
+    std::vector<int> state(TOTAL_STATE);
+    GameState_t game_state(state.data());
+    for (const auto& position : perft_positions()) {
+        setup_perft_position(position, game_state);
+        BitboardState_t bb_state;
+        to_bitboard(game_state, bb_state);
+        MultiplayerState_t<2> star_state;
+        initialize_multiplayer(star_state);
+        for (int move : position.moves)
+            update_state_multiplayer(star_state, move);
+        int depths = std::min(max_depth, (int)position.nodes.size());
+        for (int depth = 1; depth <= depths; depth++) {
+            perft_result_t result{position.name, depth, position.nodes[depth - 1], {}, {}};
+            double seconds[N_PERFT_GENERATORS];
+            seconds[0] = seconds_of([&]() { result.nodes[0] = perft(game_state, depth); });
+            seconds[1] = seconds_of([&]() { result.nodes[1] = perft_bitboard(bb_state, depth); });
+            seconds[2] = seconds_of([&]() { result.nodes[2] = perft_mask_cache(game_state, depth); });
+            seconds[3] = seconds_of([&]() { result.nodes[3] = perft_multiplayer(star_state, depth); });
+            // untimed, it walks the same tree as perft with a copy and a compare around every make/unmake
+            try {
+                if (perft_checked(game_state, depth) != result.nodes[0]) {
+                    std::cerr << "perft_checked " << position.name << " depth " << depth << " disagrees with perft\n";
+                    ok = false;
+                }
+            } catch (const std::logic_error& e) {
+                std::cerr << "perft " << position.name << " depth " << depth << ": " << e.what() << "\n";
+                ok = false;
+            }
+            for (int g = 0; g < N_PERFT_GENERATORS; g++) {
+                result.ns_per_node[g] = seconds[g] * 1e9 / (double)result.nodes[g];
+                if (result.nodes[g] != result.expected) {
+                    std::cerr << "perft " << position.name << " depth " << depth << " (" << perft_generators[g]
+                              << "): " << result.nodes[g] << " nodes, expected " << result.expected << "\n";
+                    ok = false;
+                }
+            }
+            results.push_back(result);
+        }
+    }
+    return ok;
+}
+
+// UndoStack_t on a random line in both layouts: every unmake and unmake_all restore the state byte for byte, a
+// full stack refuses a make and an empty one an unmake
+template <typename State, typename Buffer>
+static bool check_undo_stack_layout(const char* layout, size_t state_size, std::mt19937& rng) {
+    static const size_t CAPACITY = 24;
+    std::vector<Buffer> state(state_size), root, saved(CAPACITY * state_size);
+    State game_state(state.data());
+    initialize_state(game_state);
+    root = state;
+    UndoStack_t undo(CAPACITY);
+    bool ok = true;
+    for (size_t k = 0; k < CAPACITY && *game_state.winner == 0; k++) {
+        int mask[N_MOVES] = {0};
+        set_action_mask(game_state, mask);
+        std::vector<int> legal;
+        for (int move = 0; move < (int)N_MOVES; move++)
+            if (mask[move])
+                legal.push_back(move);
+        int move = legal[rng() % legal.size()];
+        std::copy(state.begin(), state.end(), saved.begin() + k * state_size);
+        // a trial move and its take-back, then the move for real
+        undo.make(game_state, move);
+        undo.unmake(game_state);
+        if (!std::equal(state.begin(), state.end(), saved.begin() + k * state_size)) {
+            std::cerr << "undo stack (" << layout << "): unmake of move " << move << " didn't restore the state\n";
+            ok = false;
+        }
+        undo.make(game_state, move);
+    }
+    bool threw = false;
+    if (undo.size() == CAPACITY && *game_state.winner == 0) {
+        int mask[N_MOVES] = {0};
+        set_action_mask(game_state, mask);
+        auto before = state;
+        try {
+            undo.make(game_state, std::find(mask, mask + N_MOVES, 1) - mask);
+        } catch (const std::length_error&) {
+            threw = true;
+        }
+        if (!threw || state != before) {
+            std::cerr << "undo stack (" << layout << "): make on a full stack didn't throw\n";
+            ok = false;
+        }
+    }
+    size_t n_made = undo.size();
+    undo.unmake(game_state);
+    if (!std::equal(state.begin(), state.end(), saved.begin() + (n_made - 1) * state_size)) {
+        std::cerr << "undo stack (" << layout << "): unmake of the last move didn't restore the state\n";
+        ok = false;
+    }
+    undo.unmake_all(game_state);
+    if (state != root || !undo.empty()) {
+        std::cerr << "undo stack (" << layout << "): unmake_all didn't return to the start position\n";
+        ok = false;
+    }
+    threw = false;
+    try {
+        undo.unmake(game_state);
+    } catch (const std::logic_error&) {
+        threw = true;
+    }
+    if (!threw || state != root) {
+        std::cerr << "undo stack (" << layout << "): unmake on an empty stack didn't throw\n";
+        ok = false;
+    }
+    return ok;
+}
+
+static bool check_undo_stack() {
+    std::mt19937 rng(0);
+    bool ok = true;
+    for (int line = 0; line < 16; line++) {
+        ok = check_undo_stack_layout<GameState_t, int>("int", TOTAL_STATE, rng) && ok;
+        ok = check_undo_stack_layout<CompactGameState_t, uint8_t>("compact", COMPACT_STATE, rng) && ok;
+    }
+    return ok;
+}
+
+// Replay_t with a small keyframe cap, so the keyframes get thinned and the interval doubles many times over the
+// game: random seeks (back, forward, past the end) and steps have to land on the states of a linear replay
+static bool check_replay_source(const char* source_name, replay_source_t& source, const std::vector<uint8_t>& actions,
+                                const std::vector<int>& reference, std::mt19937& rng) {
+    const int MAX_KEYFRAMES = 4;
+    uint64_t n_moves = actions.size();
+    Replay_t replay(source, 2, MAX_KEYFRAMES);
+    bool ok = true;
+    auto check = [&](const char* op, uint64_t target) {
+        uint64_t expected = std::min(target, n_moves);
+        const replay_move_t* last = replay.last_move();
+        bool last_ok = expected == 0 || (last && last->action == actions[expected - 1]);
+        if (replay.current() != expected ||
+            !std::equal(reference.begin() + expected * TOTAL_STATE, reference.begin() + (expected + 1) * TOTAL_STATE,
+                        replay.state().grid) ||
+            !last_ok) {
+            std::cerr << "replay (" << source_name << "): " << op << " to move " << target << " landed on move "
+                      << replay.current() << " with a different state\n";
+            ok = false;
+        }
+        if ((int)replay.n_keyframes() > MAX_KEYFRAMES) {
+            std::cerr << "replay (" << source_name << "): " << replay.n_keyframes() << " keyframes, the cap is "
+                      << MAX_KEYFRAMES << "\n";
+            ok = false;
+        }
+    };
+    // the first seeks only know part of the game, the later ones all of it
+    for (int k = 0; k < 400 && ok; k++) {
+        uint64_t target = rng() % (n_moves + 20);
+        if (k % 7 == 0) {
+            replay.step();
+            check("step", replay.current());
+        } else {
+            replay.seek(target);
+            check("seek", target);
+            if (k == 50)
+                replay.read_ahead(n_moves);
+        }
+    }
+    if (!replay.finished() || replay.n_known() != n_moves || !replay.error().empty() ||
+        replay.keyframe_interval() <= 2) {
+        std::cerr << "replay (" << source_name << "): read " << replay.n_known() << " of " << n_moves
+                  << " moves, keyframe interval " << replay.keyframe_interval() << "\n";
+        ok = false;
+    }
+    return ok;
+}
+
+static bool check_replay() {
+    std::mt19937 rng(0);
+    std::vector<int> state(TOTAL_STATE);
+    GameState_t game_state(state.data());
+    initialize_state(game_state);
+    std::vector<uint8_t> actions;
+    std::vector<int> reference(state);
+    std::string text;
+    for (int k = 0; k < 1500 && *game_state.winner == 0; k++) {
+        int move = sample_legal_move(game_state, rng);
+        text += format_move_text(*game_state.current_player, move) + "\n";
+        update_state(game_state, move);
+        actions.push_back((uint8_t)move);
+        reference.insert(reference.end(), state.begin(), state.end());
+    }
+    ArrayReplaySource_t array_source(actions.data(), actions.size());
+    bool ok = check_replay_source("array", array_source, actions, reference, rng);
+    std::istringstream text_stream(text);
+    TextReplaySource_t text_source(text_stream, 0);
+    return check_replay_source("text", text_source, actions, reference, rng) && ok;
+}
+
+// the masks of every implementation have to match the pre-table baseline on the random positions
+static bool check_masks(std::vector<int>& positions, int n_positions) {
+    std::vector<int> reference(n_positions * N_MOVES);
+    std::vector<int> masks(n_positions * N_MOVES);
+    for (int i = 0; i < n_positions; i++) {
+        set_action_mask_neighbors(GameState_t(positions.data() + i * TOTAL_STATE), reference.data() + i * N_MOVES);
+        set_action_mask(GameState_t(positions.data() + i * TOTAL_STATE), masks.data() + i * N_MOVES);
+    }
+    bool ok = true;
+    if (masks != reference) {
+        std::cerr << "set_action_mask disagrees with the neighbor-offset baseline\n";
+        ok = false;
+    }
+    for (auto isa : {simd_isa_t::scalar, simd_isa_t::avx2, simd_isa_t::avx512}) {
+        if (set_simd_isa(isa) != isa)
+            continue;
+        set_action_mask_simd(positions.data(), n_positions, masks.data());
+        if (masks != reference) {
+            std::cerr << simd_isa_name(isa) << " kernel disagrees with set_action_mask\n";
+            ok = false;
+        }
+    }
+    set_simd_isa(detect_simd_isa());
+    return ok;
+}
+
+// every benchmark does about the same total work: `batch` states per round, total_ops / batch rounds
+static int rounds_for(int batch, int64_t total_ops) {
+    return (int)std::max<int64_t>(1, total_ops / batch);
+}
+
+static void bench_engine(const std::vector<int>& positions, int batch, int64_t total_ops,
+                         std::vector<bench_result_t>& results) {
+    int rounds = rounds_for(batch, total_ops);
+    double ops = (double)batch * rounds;
+    std::vector<int> states(positions.begin(), positions.begin() + (size_t)batch * TOTAL_STATE);
+    std::vector<int> masks(batch * N_MOVES);
+    auto state_at = [&](int i) { return GameState_t(states.data() + i * TOTAL_STATE); };
+    auto reset_states = [&]() { std::copy(positions.begin(), positions.begin() + states.size(), states.begin()); };
+
+    auto seconds = seconds_of([&]() {
+        for (int r = 0; r < rounds; r++) {
+            for (int i = 0; i < batch; i++)
+                initialize_state(state_at(i));
+        }
+    });
+    results.push_back({"initialize_state", batch, seconds * 1e9 / ops});
+
+    reset_states();
+    using mask_fn_t = void (*)(GameState_t, int*);
+    for (auto [name, mask_fn] : {std::make_pair("set_action_mask_neighbors", (mask_fn_t)&set_action_mask_neighbors),
+                                 std::make_pair("set_action_mask", (mask_fn_t)&set_action_mask)}) {
+        seconds = seconds_of([&]() {
+            for (int r = 0; r < rounds; r++) {
+                std::memset(masks.data(), 0, masks.size() * sizeof(int));
+                for (int i = 0; i < batch; i++)
+                    mask_fn(state_at(i), masks.data() + i * N_MOVES);
+            }
+        });
+        results.push_back({name, batch, seconds * 1e9 / ops});
+    }
+
+    // the SIMD kernel works on whole batches
+    for (auto isa : {simd_isa_t::scalar, simd_isa_t::avx2, simd_isa_t::avx512}) {
+        if (set_simd_isa(isa) != isa)
+            continue;
+        seconds = seconds_of([&]() {
+            for (int r = 0; r < rounds; r++)
+                set_action_mask_simd(states.data(), batch, masks.data());
+        });
+        results.push_back({std::string("set_action_mask_simd_") + simd_isa_name(isa), batch, seconds * 1e9 / ops});
+    }
+    set_simd_isa(detect_simd_isa());
+
+    // the moves are recorded first so update_state, step_state and the cached step replay the same games. a
+    // finished game restarts from the start position, like step_state does
+    std::mt19937 rng(1);
+    std::vector<int> moves((size_t)rounds * batch);
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < batch; i++) {
+            int move = sample_legal_move(state_at(i), rng);
+            moves[(size_t)r * batch + i] = move;
+            update_state(state_at(i), move);
+            if (*state_at(i).winner != 0)
+                initialize_state(state_at(i));
+        }
+    }
+
+    reset_states();
+    seconds = seconds_of([&]() {
+        for (int r = 0; r < rounds; r++) {
+            for (int i = 0; i < batch; i++) {
+                update_state(state_at(i), moves[(size_t)r * batch + i]);
+                if (*state_at(i).winner != 0)
+                    initialize_state(state_at(i));
+            }
+        }
+    });
+    results.push_back({"update_state", batch, seconds * 1e9 / ops});
+
+    // how search tries a move: copy-make into a scratch state against make/unmake in place. both then play the
+    // move for real so the games go on, which is the update_state time above
+    std::vector<int> scratch(TOTAL_STATE);
+    reset_states();
+    seconds = seconds_of([&]() {
+        for (int r = 0; r < rounds; r++) {
+            for (int i = 0; i < batch; i++) {
+                int move = moves[(size_t)r * batch + i];
+                copy_state(state_at(i), GameState_t(scratch.data()));
+                update_state(GameState_t(scratch.data()), move);
+                update_state(state_at(i), move);
+                if (*state_at(i).winner != 0)
+                    initialize_state(state_at(i));
+            }
+        }
+    });
+    results.push_back({"copy_make", batch, seconds * 1e9 / ops});
+
+    reset_states();
+    seconds = seconds_of([&]() {
+        for (int r = 0; r < rounds; r++) {
+            for (int i = 0; i < batch; i++) {
+                int move = moves[(size_t)r * batch + i];
+                unmake_move(state_at(i), make_move(state_at(i), move));
+                update_state(state_at(i), move);
+                if (*state_at(i).winner != 0)
+                    initialize_state(state_at(i));
+            }
+        }
+    });
+    results.push_back({"make_unmake", batch, seconds * 1e9 / ops});
+
+    float reward;
+    bool done;
+    reset_states();
+    seconds = seconds_of([&]() {
+        for (int r = 0; r < rounds; r++) {
+            for (int i = 0; i < batch; i++)
+                step_state(state_at(i), moves[(size_t)r * batch + i], reward, done, masks.data() + i * N_MOVES);
+        }
+    });
+    results.push_back({"step_state", batch, seconds * 1e9 / ops});
+
+    reset_states();
+    std::vector<mask_cache_t> caches(batch);
+    for (int i = 0; i < batch; i++)
+        init_mask_cache(state_at(i), caches[i]);
+    seconds = seconds_of([&]() {
+        for (int r = 0; r < rounds; r++) {
+            for (int i = 0; i < batch; i++)
+                step_state_cached(state_at(i), caches[i], moves[(size_t)r * batch + i], reward, done,
+                                  masks.data() + i * N_MOVES);
+        }
+    });
+    results.push_back({"step_state_cached", batch, seconds * 1e9 / ops});
+
+    reset_states();
+    seconds = seconds_of([&]() {
+        for (int r = 0; r < rounds; r++) {
+            for (int i = 0; i < batch; i++)
+                step_state_shaped(state_at(i), moves[(size_t)r * batch + i], 0.01f, reward, done,
+                                  masks.data() + i * N_MOVES);
+        }
+    });
+    results.push_back({"step_state_shaped", batch, seconds * 1e9 / ops});
+
+    reset_states();
+    int64_t checksum = 0;
+    seconds = seconds_of([&]() {
+        for (int r = 0; r < rounds; r++) {
+            for (int i = 0; i < batch; i++)
+                checksum += evaluate_state(state_at(i)).distance[0];
+        }
+    });
+    // keeps the loop from being optimized away
+    if (checksum < 0)
+        std::cerr << checksum;
+    results.push_back({"evaluate_state", batch, seconds * 1e9 / ops});
+
+    // the mask and a uniform philox draw from it, what generate does per move
+    int legal[N_MOVES];
+    int n_legal;
+    seconds = seconds_of([&]() {
+        for (int r = 0; r < rounds; r++) {
+            for (int i = 0; i < batch; i++)
+                checksum += sample_action(state_at(i), nullptr, 1, i, r, legal, n_legal);
+        }
+    });
+    if (checksum < 0)
+        std::cerr << checksum;
+    results.push_back({"sample_action", batch, seconds * 1e9 / ops});
+
+    std::vector<float> observations((size_t)batch * OBS_SIZE);
+    for (auto layout : {obs_layout_t::chw, obs_layout_t::hwc}) {
+        seconds = seconds_of([&]() {
+            for (int r = 0; r < rounds; r++) {
+                for (int i = 0; i < batch; i++)
+                    encode_observation(state_at(i), observations.data() + (size_t)i * OBS_SIZE, layout);
+            }
+        });
+        results.push_back({std::string("encode_observation_") + obs_layout_name(layout), batch, seconds * 1e9 / ops});
+    }
+}
+
+// the full send/recv round trip per env step, including the observations. the actions are picked in the
+// calling thread between steps, like a policy would, with a cheap scan of the masks
+static void bench_vec_env(int batch, int64_t total_ops, std::vector<bench_result_t>& results) {
+    int rounds = rounds_for(batch, total_ops);
+    double ops = (double)batch * rounds;
+    std::vector<int> states((size_t)batch * TOTAL_STATE), actions(batch), masks((size_t)batch * N_MOVES);
+    std::vector<float> rewards(batch), observations((size_t)batch * OBS_SIZE);
+    std::unique_ptr<bool[]> dones(new bool[batch]);
+    vec_env_buffers_t buffers{states.data(), actions.data(), rewards.data(), dones.get(), masks.data(),
+                              observations.data(), nullptr, obs_layout_t::chw};
+
+    std::vector<int> worker_counts = {0, 1};
+    if (std::thread::hardware_concurrency() > 1)
+        worker_counts.push_back((int)std::thread::hardware_concurrency());
+    for (int n_workers : worker_counts) {
+        VecEnv_t env(batch, n_workers, buffers);
+        auto seconds = seconds_of([&]() {
+            for (int r = 0; r < rounds; r++) {
+                for (int i = 0; i < batch; i++) {
+                    const int* mask = masks.data() + (size_t)i * N_MOVES;
+                    int move = (r + i) % N_MOVES;
+                    while (!mask[move])
+                        move = (move + 1) % N_MOVES;
+                    actions[i] = move;
+                }
+                env.send();
+                env.recv();
+            }
+        });
+        results.push_back({"vec_env_step_w" + std::to_string(n_workers), batch, seconds * 1e9 / ops});
+    }
+}
+
+#ifdef BENCH_WITH_TORCH
+static void bench_torch(std::vector<int>& positions, int batch, int64_t total_ops, std::vector<bench_result_t>& results) {
+    int rounds = rounds_for(batch, total_ops);
+    double ops = (double)batch * rounds;
+    torch::Tensor tensor;
+    auto seconds = seconds_of([&]() {
+        for (int r = 0; r < rounds; r++)
+            tensor = initialize_state_batched(batch);
+    });
+    results.push_back({"initialize_state_batched", batch, seconds * 1e9 / ops});
+
+    auto state_batch = torch::from_blob(positions.data(), {batch, (long long)TOTAL_STATE}, torch::dtype(torch::kInt32));
+    seconds = seconds_of([&]() {
+        for (int r = 0; r < rounds; r++)
+            tensor = get_action_mask_batched(state_batch, batch);
+    });
+    results.push_back({"get_action_mask_batched", batch, seconds * 1e9 / ops});
+    seconds = seconds_of([&]() {
+        for (int r = 0; r < rounds; r++)
+            tensor = get_action_mask_simd_batched(state_batch, batch);
+    });
+    results.push_back({"get_action_mask_simd_batched", batch, seconds * 1e9 / ops});
+}
+#endif
+
+static std::string to_json(int n_positions, int repeats, const std::vector<perft_result_t>& perft_results,
+                           const std::vector<bench_result_t>& bench_results) {
+    std::ostringstream out;
+    out << "{\n";
+    out << "  \"n_positions\": " << n_positions << ",\n";
+    out << "  \"repeats\": " << repeats << ",\n";
+    out << "  \"simd_isa\": \"" << simd_isa_name(detect_simd_isa()) << "\",\n";
+#ifdef BENCH_WITH_TORCH
+    out << "  \"torch\": true,\n";
+#else
+    out << "  \"torch\": false,\n";
+#endif
+    out << "  \"perft\": [";
+    for (size_t k = 0; k < perft_results.size(); k++) {
+        const auto& result = perft_results[k];
+        out << (k ? "," : "") << "\n    {\"position\": \"" << result.position << "\", \"depth\": " << result.depth
+            << ", \"expected\": " << result.expected;
+        for (int g = 0; g < N_PERFT_GENERATORS; g++) {
+            out << ", \"" << perft_generators[g] << "\": {\"nodes\": " << result.nodes[g]
+                << ", \"ns_per_node\": " << result.ns_per_node[g] << "}";
+        }
+        out << "}";
+    }
+    out << "\n  ],\n";
+    out << "  \"benchmarks\": [";
+    for (size_t k = 0; k < bench_results.size(); k++) {
+        const auto& result = bench_results[k];
+        out << (k ? "," : "") << "\n    {\"name\": \"" << result.name << "\", \"batch\": " << result.batch
+            << ", \"ns_per_op\": " << result.ns_per_op << "}";
+    }
+    out << "\n  ]\n}\n";
+    return out.str();
+}
+
+int main(int argc, char* argv[]) {
+    int n_positions = 4096;
+    int repeats = 200;
+    int max_depth = 1 << 30;
+    bool perft_only = false;
+    std::string json_file;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            n_positions = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+            repeats = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+            max_depth = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            json_file = argv[++i];
+        else if (std::strcmp(argv[i], "--perft") == 0)
+            perft_only = true;
+        else
+            print_usage();
+    }
+    if (n_positions <= 0 || repeats <= 0 || max_depth <= 0)
+        print_usage();
+    // the mask cache's debug check would time a full recomputation on every step
+    set_mask_cache_verify(false);
+
+    std::vector<perft_result_t> perft_results;
+    bool ok = run_perft(max_depth, perft_results);
+    ok = check_undo_stack() && ok;
+    ok = check_replay() && ok;
+    std::vector<bench_result_t> bench_results;
+    if (!perft_only) {
+        std::mt19937 rng(0);
+        auto positions = random_positions(n_positions, rng);
+        ok = check_masks(positions, n_positions) && ok;
+#ifdef BENCH_WITH_TORCH
+        // the batched ops run on one thread so they compare with the engine loops
+        set_parallel_config(1, 0);
+#endif
+        int64_t total_ops = (int64_t)n_positions * repeats;
+        std::vector<int> batches = {1, 64, n_positions};
+        std::sort(batches.begin(), batches.end());
+        batches.erase(std::unique(batches.begin(), batches.end()), batches.end());
+        for (int batch : batches) {
+            if (batch > n_positions)
+                continue;
+            bench_engine(positions, batch, total_ops, bench_results);
+            if (batch == batches.back())
+                bench_vec_env(batch, total_ops, bench_results);
+#ifdef BENCH_WITH_TORCH
+            bench_torch(positions, batch, total_ops, bench_results);
+#endif
+        }
+    }
+
+    auto json = to_json(n_positions, repeats, perft_results, bench_results);
+    if (json_file.empty()) {
+        std::cout << json;
+    } else {
+        std::ofstream out(json_file);
+        out << json;
+        if (!out) {
+            std::cerr << "could not write " << json_file << "\n";
+            return 1;
+        }
+    }
+    return ok ? 0 : 1;
+}
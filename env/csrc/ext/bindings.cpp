@@ -1,14 +1,40 @@
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 #include <torch/extension.h>
+#include <torch/script.h>
+#include <optional>
 #include "../shared/board.h"
-#include "../shared/chinese_checkers.h"
+#include "chinese_checkers.h"
 #include "../shared/constants.h"
+#include "../shared/evaluation.h"
+#include "../shared/game_log.h"
+#include "../shared/mask_cache.h"
+#include "../shared/mcts.h"
+#include "../shared/multiplayer.h"
+#include "../shared/observation.h"
+#include "../shared/simd_mask.h"
+#include "../shared/stats.h"
+#include "../shared/vec_env.h"
 
 namespace py = pybind11;
 
-torch::Tensor init_state_batched_wrap(int64_t n_batch) {
-    return initialize_state_batched((int)n_batch);
+torch::Tensor init_state_batched_wrap(int64_t n_batch, bool compact) {
+    return initialize_state_batched((int)n_batch, compact);
+}
+
+torch::Tensor to_compact_batched_wrap(torch::Tensor game_state_batch) {
+    auto n_batch = game_state_batch.size(0);
+    return to_compact_batched(game_state_batch, (int)n_batch);
+}
+
+torch::Tensor from_compact_batched_wrap(torch::Tensor game_state_batch) {
+    auto n_batch = game_state_batch.size(0);
+    return from_compact_batched(game_state_batch, (int)n_batch);
+}
+
+torch::Tensor get_state_hash_batched_wrap(torch::Tensor game_state_batch) {
+    auto n_batch = game_state_batch.size(0);
+    return get_state_hash_batched(game_state_batch, (int)n_batch);
 }
 
 torch::Tensor get_action_mask_batched_wrap(torch::Tensor game_state_batch) {
@@ -22,6 +48,431 @@ int64_t update_state_batched_wrap(torch::Tensor game_state_batch, torch::Tensor
     return 0;
 }
 
+int64_t get_action_mask_batched_out_wrap(torch::Tensor game_state_batch, torch::Tensor mask_batch) {
+    auto n_batch = game_state_batch.size(0);
+    get_action_mask_batched_out(game_state_batch, mask_batch, (int)n_batch);
+    return 0;
+}
+
+int64_t step_batched_wrap(torch::Tensor game_state_batch, torch::Tensor moves_batch, torch::Tensor reward_batch,
+                          torch::Tensor done_batch, torch::Tensor mask_batch) {
+    auto n_batch = game_state_batch.size(0);
+    step_batched(game_state_batch, moves_batch, reward_batch, done_batch, mask_batch, (int)n_batch);
+    return 0;
+}
+
+torch::Tensor init_mask_cache_batched_wrap(torch::Tensor game_state_batch) {
+    auto n_batch = game_state_batch.size(0);
+    return init_mask_cache_batched(game_state_batch, (int)n_batch);
+}
+
+int64_t step_cached_batched_wrap(torch::Tensor game_state_batch, torch::Tensor cache_batch, torch::Tensor moves_batch,
+                                 torch::Tensor reward_batch, torch::Tensor done_batch, torch::Tensor mask_batch) {
+    auto n_batch = game_state_batch.size(0);
+    step_cached_batched(game_state_batch, cache_batch, moves_batch, reward_batch, done_batch, mask_batch, (int)n_batch);
+    return 0;
+}
+
+torch::Tensor encode_observation_batched_wrap(torch::Tensor game_state_batch, std::string layout,
+                                              std::string dtype) {
+    auto n_batch = game_state_batch.size(0);
+    return encode_observation_batched(game_state_batch, (int)n_batch, obs_layout_from_name(layout), dtype);
+}
+
+int64_t encode_observation_batched_out_wrap(torch::Tensor game_state_batch, torch::Tensor obs_batch,
+                                            std::string layout) {
+    auto n_batch = game_state_batch.size(0);
+    encode_observation_batched_out(game_state_batch, obs_batch, (int)n_batch, obs_layout_from_name(layout));
+    return 0;
+}
+
+int64_t step_observe_batched_wrap(torch::Tensor game_state_batch, torch::Tensor moves_batch, torch::Tensor reward_batch,
+                                  torch::Tensor done_batch, torch::Tensor mask_batch, torch::Tensor obs_batch,
+                                  std::string layout) {
+    auto n_batch = game_state_batch.size(0);
+    step_observe_batched(game_state_batch, moves_batch, reward_batch, done_batch, mask_batch, obs_batch, (int)n_batch,
+                         obs_layout_from_name(layout));
+    return 0;
+}
+
+torch::Tensor evaluate_batched_wrap(torch::Tensor game_state_batch) {
+    auto n_batch = game_state_batch.size(0);
+    return evaluate_batched(game_state_batch, (int)n_batch);
+}
+
+int64_t step_shaped_batched_wrap(torch::Tensor game_state_batch, torch::Tensor moves_batch, torch::Tensor reward_batch,
+                                 torch::Tensor done_batch, torch::Tensor mask_batch, double shaping) {
+    auto n_batch = game_state_batch.size(0);
+    step_shaped_batched(game_state_batch, moves_batch, reward_batch, done_batch, mask_batch, (int)n_batch, shaping);
+    return 0;
+}
+
+torch::Tensor init_episode_tracker_batched_wrap(torch::Tensor game_state_batch) {
+    auto n_batch = game_state_batch.size(0);
+    return init_episode_tracker_batched(game_state_batch, (int)n_batch);
+}
+
+int64_t step_limited_batched_wrap(torch::Tensor game_state_batch, torch::Tensor tracker_batch, torch::Tensor moves_batch,
+                                  torch::Tensor reward_batch, torch::Tensor terminated_batch,
+                                  torch::Tensor truncated_batch, torch::Tensor mask_batch, torch::Tensor max_turns_batch,
+                                  torch::Tensor stall_turns_batch, std::optional<torch::Tensor> final_state_batch) {
+    auto n_batch = game_state_batch.size(0);
+    step_limited_batched(game_state_batch, tracker_batch, moves_batch, reward_batch, terminated_batch, truncated_batch,
+                         mask_batch, max_turns_batch, stall_turns_batch, final_state_batch, (int)n_batch);
+    return 0;
+}
+
+torch::Tensor sample_actions_batched_wrap(torch::Tensor game_state_batch, int64_t seed, int64_t step,
+                                          std::optional<torch::Tensor> logits_batch,
+                                          std::optional<torch::Tensor> env_ids) {
+    auto n_batch = game_state_batch.size(0);
+    return std::get<0>(
+        sample_actions_batched(game_state_batch, seed, step, logits_batch, env_ids, false, (int)n_batch));
+}
+
+std::tuple<torch::Tensor, torch::Tensor, torch::Tensor>
+sample_actions_csr_batched_wrap(torch::Tensor game_state_batch, int64_t seed, int64_t step,
+                                std::optional<torch::Tensor> logits_batch, std::optional<torch::Tensor> env_ids) {
+    auto n_batch = game_state_batch.size(0);
+    return sample_actions_batched(game_state_batch, seed, step, logits_batch, env_ids, true, (int)n_batch);
+}
+
+torch::Tensor transform_state_batched_wrap(torch::Tensor game_state_batch, torch::Tensor symmetry_batch) {
+    auto n_batch = game_state_batch.size(0);
+    return transform_state_batched(game_state_batch, symmetry_batch, (int)n_batch);
+}
+
+torch::Tensor transform_actions_batched_wrap(torch::Tensor action_batch, torch::Tensor symmetry_batch) {
+    return transform_actions_batched(action_batch, symmetry_batch);
+}
+
+torch::Tensor transform_moves_batched_wrap(torch::Tensor moves_batch, torch::Tensor symmetry_batch) {
+    return transform_moves_batched(moves_batch, symmetry_batch);
+}
+
+int64_t multiplayer_state_size_wrap(int64_t n_players) {
+    return (int64_t)multiplayer_state_size((int)n_players);
+}
+
+torch::Tensor initialize_multiplayer_batched_wrap(int64_t n_batch, int64_t n_players) {
+    return initialize_multiplayer_batched((int)n_batch, (int)n_players);
+}
+
+torch::Tensor get_action_mask_multiplayer_batched_wrap(torch::Tensor game_state_batch, int64_t n_players) {
+    auto n_batch = game_state_batch.size(0);
+    return get_action_mask_multiplayer_batched(game_state_batch, (int)n_batch, (int)n_players);
+}
+
+int64_t step_multiplayer_batched_wrap(torch::Tensor game_state_batch, torch::Tensor moves_batch,
+                                      torch::Tensor reward_batch, torch::Tensor done_batch, torch::Tensor mask_batch,
+                                      int64_t n_players) {
+    auto n_batch = game_state_batch.size(0);
+    step_multiplayer_batched(game_state_batch, moves_batch, reward_batch, done_batch, mask_batch, (int)n_batch,
+                             (int)n_players);
+    return 0;
+}
+
+torch::Tensor to_bitboard_batched_wrap(torch::Tensor game_state_batch) {
+    auto n_batch = game_state_batch.size(0);
+    return to_bitboard_batched(game_state_batch, (int)n_batch);
+}
+
+torch::Tensor from_bitboard_batched_wrap(torch::Tensor bitboard_batch) {
+    auto n_batch = bitboard_batch.size(0);
+    return from_bitboard_batched(bitboard_batch, (int)n_batch);
+}
+
+torch::Tensor get_action_mask_bitboard_batched_wrap(torch::Tensor bitboard_batch) {
+    auto n_batch = bitboard_batch.size(0);
+    return get_action_mask_bitboard_batched(bitboard_batch, (int)n_batch);
+}
+
+int64_t update_state_bitboard_batched_wrap(torch::Tensor bitboard_batch, torch::Tensor moves_batch) {
+    auto n_batch = bitboard_batch.size(0);
+    update_state_bitboard_batched(bitboard_batch, moves_batch, (int)n_batch);
+    return 0;
+}
+
+torch::Tensor get_turn_action_mask_batched_wrap(torch::Tensor game_state_batch) {
+    auto n_batch = game_state_batch.size(0);
+    return get_turn_action_mask_batched(game_state_batch, (int)n_batch);
+}
+
+int64_t update_state_turn_batched_wrap(torch::Tensor game_state_batch, torch::Tensor turn_moves_batch) {
+    auto n_batch = game_state_batch.size(0);
+    update_state_turn_batched(game_state_batch, turn_moves_batch, (int)n_batch);
+    return 0;
+}
+
+torch::Tensor get_action_mask_simd_batched_wrap(torch::Tensor game_state_batch) {
+    auto n_batch = game_state_batch.size(0);
+    return get_action_mask_simd_batched(game_state_batch, (int)n_batch);
+}
+
+std::string set_simd_isa_wrap(const std::string& name) {
+    return simd_isa_name(set_simd_isa(simd_isa_from_name(name)));
+}
+
+std::string get_simd_isa_wrap() {
+    return simd_isa_name(get_simd_isa());
+}
+
+void write_game_log_wrap(const std::string& path, torch::Tensor actions, torch::Tensor game_offsets) {
+    TORCH_CHECK(actions.scalar_type() == torch::kUInt8 && actions.dim() == 1, "actions must be a 1-d uint8 tensor");
+    TORCH_CHECK(game_offsets.scalar_type() == torch::kInt64 && game_offsets.dim() == 1 && game_offsets.size(0) >= 2,
+                "game_offsets must be a 1-d int64 tensor with n_games + 1 entries");
+    actions = actions.contiguous();
+    game_offsets = game_offsets.contiguous();
+    auto actions_ptr = actions.data_ptr<uint8_t>();
+    auto offsets_ptr = game_offsets.data_ptr<int64_t>();
+    int64_t n_games = game_offsets.size(0) - 1;
+    TORCH_CHECK(offsets_ptr[0] == 0 && offsets_ptr[n_games] == actions.size(0),
+                "game_offsets must start at 0 and end at the number of actions");
+    GameLogWriter_t writer(path);
+    for (int64_t g = 0; g < n_games; g++) {
+        TORCH_CHECK(offsets_ptr[g] <= offsets_ptr[g + 1], "game_offsets must be non-decreasing");
+        writer.begin_game();
+        for (int64_t k = offsets_ptr[g]; k < offsets_ptr[g + 1]; k++) {
+            writer.write_action(actions_ptr[k]);
+        }
+    }
+    writer.close();
+}
+
+std::tuple<torch::Tensor, torch::Tensor, torch::Tensor, torch::Tensor, double> alphabeta_search_batched_wrap(
+    torch::Tensor game_state_batch, int64_t max_depth, int64_t time_limit_ms, int64_t n_threads, int64_t tt_size_log2) {
+    TORCH_CHECK(max_depth > 0 && n_threads > 0 && tt_size_log2 > 0 && tt_size_log2 < 40, "invalid alpha-beta config");
+    alphabeta_config_t config;
+    config.max_depth = max_depth;
+    config.time_limit_ms = time_limit_ms;
+    config.n_threads = n_threads;
+    config.tt_size_log2 = tt_size_log2;
+    auto n_batch = game_state_batch.size(0);
+    auto results = alphabeta_search_batched(game_state_batch, (int)n_batch, config);
+    double total_seconds = 0.0;
+    int64_t total_nodes = 0;
+    for (int64_t i = 0; i < n_batch; i++) {
+        total_seconds += results[4].data_ptr<double>()[i];
+        total_nodes += results[3].data_ptr<int64_t>()[i];
+    }
+    double nodes_per_second = (total_seconds > 0) ? total_nodes / total_seconds : 0.0;
+    return {results[0], results[1], results[2], results[3], nodes_per_second};
+}
+
+std::pair<int64_t, int64_t> get_parallel_config_wrap() {
+    return {get_num_threads(), get_grain_size()};
+}
+
+// get_stats() as a dict: per kernel calls, states, ns and ns_per_state, then the game counters
+py::dict get_stats_wrap() {
+    auto stats = get_stats();
+    py::dict kernels;
+    for (int k = 0; k < N_KERNELS; k++) {
+        py::dict kernel;
+        kernel["calls"] = stats.calls[k];
+        kernel["states"] = stats.states[k];
+        kernel["ns"] = stats.ns[k];
+        kernel["ns_per_state"] = stats.states[k] ? (double)stats.ns[k] / (double)stats.states[k] : 0.0;
+        kernels[stats_kernel_names[k]] = kernel;
+    }
+    py::dict result;
+    result["enabled"] = stats_enabled;
+    result["kernels"] = kernels;
+    result["legal_moves"] = std::vector<uint64_t>(stats.legal_moves, stats.legal_moves + N_MOVES + 1);
+    result["hop_jumps"] = stats.hop_jumps;
+    result["hop_chains"] = stats.hop_chains;
+    result["wins"] = std::vector<uint64_t>(stats.wins, stats.wins + STATS_MAX_PLAYERS);
+    return result;
+}
+
+// python side of MCTS_t: leaves go to either a python callable or a TorchScript module, both called as
+// evaluator(states, masks) -> (priors, values)
+class MCTS_wrap {
+public:
+    MCTS_wrap(int n_simulations, int leaves_per_tree, double c_puct, double virtual_loss, int max_nodes)
+        : mcts(make_config(n_simulations, leaves_per_tree, c_puct, virtual_loss, max_nodes)) {}
+
+    void load_model(const std::string& path) {
+        model = torch::jit::load(path);
+        model->eval();
+    }
+
+    std::pair<torch::Tensor, torch::Tensor> search(torch::Tensor root_states, py::object evaluator) {
+        TORCH_CHECK(root_states.scalar_type() == torch::kInt32 && root_states.size(1) == (int64_t)TOTAL_STATE,
+                    "MCTS roots must be int32 (n_batch, TOTAL_STATE) game states");
+        TORCH_CHECK(!evaluator.is_none() || model.has_value(), "pass an evaluator or load a TorchScript model first");
+        root_states = root_states.contiguous();
+        auto n_roots = root_states.size(0);
+        auto visit_counts = torch::zeros({n_roots, (long long)N_MOVES}, torch::dtype(torch::kFloat32));
+        auto root_values = torch::zeros({n_roots}, torch::dtype(torch::kFloat32));
+
+        leaf_evaluator_t evaluate;
+        if (evaluator.is_none()) {
+            evaluate = [&](const int* states, const int* masks, int n_leaves, float* priors, float* values) {
+                torch::NoGradGuard no_grad;
+                auto outputs = model->forward({leaf_tensor(states, n_leaves, TOTAL_STATE),
+                                               leaf_tensor(masks, n_leaves, N_MOVES)}).toTuple();
+                copy_outputs(outputs->elements()[0].toTensor(), outputs->elements()[1].toTensor(), n_leaves, priors,
+                             values);
+            };
+        } else {
+            evaluate = [&](const int* states, const int* masks, int n_leaves, float* priors, float* values) {
+                py::gil_scoped_acquire acquire;
+                auto outputs = evaluator(leaf_tensor(states, n_leaves, TOTAL_STATE), leaf_tensor(masks, n_leaves, N_MOVES))
+                                   .cast<std::pair<torch::Tensor, torch::Tensor>>();
+                copy_outputs(outputs.first, outputs.second, n_leaves, priors, values);
+            };
+        }
+
+        {
+            py::gil_scoped_release release;
+            mcts.search(root_states.data_ptr<int>(), (int)n_roots, evaluate, visit_counts.data_ptr<float>(),
+                        root_values.data_ptr<float>());
+        }
+        return {visit_counts, root_values};
+    }
+
+    std::vector<int> tree_sizes() const {
+        return mcts.tree_sizes();
+    }
+
+private:
+    static mcts_config_t make_config(int n_simulations, int leaves_per_tree, double c_puct, double virtual_loss,
+                                     int max_nodes) {
+        TORCH_CHECK(n_simulations > 0 && leaves_per_tree > 0 && max_nodes > 1, "invalid MCTS config");
+        mcts_config_t config;
+        config.n_simulations = n_simulations;
+        config.leaves_per_tree = leaves_per_tree;
+        config.c_puct = c_puct;
+        config.virtual_loss = virtual_loss;
+        config.max_nodes = max_nodes;
+        return config;
+    }
+
+    // the search reuses its leaf buffers, so the evaluator gets copies it's free to keep
+    static torch::Tensor leaf_tensor(const int* data, int n_leaves, size_t width) {
+        return torch::from_blob(const_cast<int*>(data), {n_leaves, (long long)width}, torch::dtype(torch::kInt32))
+            .clone();
+    }
+
+    static void copy_outputs(torch::Tensor priors_out, torch::Tensor values_out, int n_leaves, float* priors,
+                             float* values) {
+        priors_out = priors_out.to(torch::kFloat32).contiguous();
+        values_out = values_out.to(torch::kFloat32).contiguous();
+        TORCH_CHECK(priors_out.numel() == (int64_t)n_leaves * (int64_t)N_MOVES, "evaluator priors must be (n, N_MOVES)");
+        TORCH_CHECK(values_out.numel() == n_leaves, "evaluator values must have one entry per leaf");
+        std::copy_n(priors_out.data_ptr<float>(), priors_out.numel(), priors);
+        std::copy_n(values_out.data_ptr<float>(), n_leaves, values);
+    }
+
+    MCTS_t mcts;
+    std::optional<torch::jit::Module> model;
+};
+
+// python side of VecEnv_t: the buffers are tensors owned here and handed out as they are, so python reads
+// the results and writes the actions in place. send() returns right away and recv() releases the GIL while
+// it waits, so a policy can run on one batch while the workers step the other
+class VecEnv_wrap {
+public:
+    VecEnv_wrap(int n_envs, int n_workers, std::string layout, std::string dtype, int max_turns, int stall_turns)
+        : layout(obs_layout_from_name(layout)) {
+        TORCH_CHECK(n_envs > 0 && n_workers >= 0, "VecEnv needs n_envs > 0 and n_workers >= 0");
+        TORCH_CHECK(max_turns >= 0 && stall_turns >= 0, "VecEnv limits must be >= 0");
+        TORCH_CHECK(dtype == "float32" || dtype == "bfloat16", "observation dtype must be float32 or bfloat16");
+        auto obs_options = torch::dtype(dtype == "bfloat16" ? torch::kBFloat16 : torch::kFloat32);
+        states = torch::empty({n_envs, (long long)TOTAL_STATE}, torch::dtype(torch::kInt32));
+        actions = torch::full({n_envs}, (int)N_MOVES - 1, torch::dtype(torch::kInt32));
+        rewards = torch::zeros({n_envs}, torch::dtype(torch::kFloat32));
+        dones = torch::zeros({n_envs}, torch::dtype(torch::kBool));
+        truncated = torch::zeros({n_envs}, torch::dtype(torch::kBool));
+        final_states = torch::zeros({n_envs, (long long)TOTAL_STATE}, torch::dtype(torch::kInt32));
+        masks = torch::empty({n_envs, (long long)N_MOVES}, torch::dtype(torch::kInt32));
+        observations = (this->layout == obs_layout_t::chw)
+                           ? torch::empty({n_envs, (long long)N_OBS_CHANNELS, (long long)ROWS, (long long)COLS},
+                                          obs_options)
+                           : torch::empty({n_envs, (long long)ROWS, (long long)COLS, (long long)N_OBS_CHANNELS},
+                                          obs_options);
+
+        vec_env_buffers_t buffers;
+        buffers.states = states.data_ptr<int>();
+        buffers.actions = actions.data_ptr<int>();
+        buffers.rewards = rewards.data_ptr<float>();
+        buffers.dones = dones.data_ptr<bool>();
+        buffers.masks = masks.data_ptr<int>();
+        buffers.observations = (dtype == "float32") ? observations.data_ptr<float>() : nullptr;
+        buffers.observations_bf16 =
+            (dtype == "bfloat16") ? reinterpret_cast<uint16_t*>(observations.data_ptr<at::BFloat16>()) : nullptr;
+        buffers.layout = this->layout;
+        buffers.truncated = truncated.data_ptr<bool>();
+        buffers.final_states = final_states.data_ptr<int>();
+        episode_limits_t limits{max_turns, stall_turns};
+        env = std::make_unique<VecEnv_t>(n_envs, n_workers, buffers, limits);
+    }
+
+    std::pair<torch::Tensor, torch::Tensor> reset() {
+        {
+            py::gil_scoped_release release;
+            env->reset();
+        }
+        return {observations, masks};
+    }
+
+    // actions=None steps with whatever is in the actions buffer already
+    void send(std::optional<torch::Tensor> action_batch) {
+        TORCH_CHECK(!sent, "VecEnv.send called again before recv");
+        if (action_batch.has_value()) {
+            TORCH_CHECK(action_batch->numel() == env->n_envs, "actions must hold n_envs moves");
+            actions.copy_(action_batch->reshape({env->n_envs}));
+        }
+        // the workers index pieces with the action, so anything the mask doesn't allow is rejected here
+        auto actions_ptr = actions.data_ptr<int>();
+        auto masks_ptr = masks.data_ptr<int>();
+        for (int i = 0; i < env->n_envs; i++) {
+            int action = actions_ptr[i];
+            TORCH_CHECK(action >= 0 && action < (int)N_MOVES, "action ", action, " of env ", i, " is out of range");
+            TORCH_CHECK(masks_ptr[(size_t)i * N_MOVES + action], "action ", action, " of env ", i, " is not legal");
+        }
+        env->send();
+        sent = true;
+    }
+
+    std::tuple<torch::Tensor, torch::Tensor, torch::Tensor, torch::Tensor> recv() {
+        TORCH_CHECK(sent, "VecEnv.recv called without send");
+        // a failed step is received too, its error is raised from here
+        sent = false;
+        {
+            py::gil_scoped_release release;
+            env->recv();
+        }
+        return {observations, rewards, dones, masks};
+    }
+
+    std::tuple<torch::Tensor, torch::Tensor, torch::Tensor, torch::Tensor>
+    step(std::optional<torch::Tensor> action_batch) {
+        send(action_batch);
+        return recv();
+    }
+
+    bool ready() const {
+        return env->ready();
+    }
+
+    int n_envs() const {
+        return env->n_envs;
+    }
+
+    int n_workers() const {
+        return env->n_workers;
+    }
+
+    const obs_layout_t layout;
+    torch::Tensor states, actions, rewards, dones, truncated, final_states, masks, observations;
+
+private:
+    std::unique_ptr<VecEnv_t> env;
+    bool sent = false;
+};
+
 PYBIND11_MODULE(TORCH_EXTENSION_NAME, m) {
     m.attr("ROWS") = ROWS;
     m.attr("COLS") = COLS;
@@ -29,6 +480,25 @@ PYBIND11_MODULE(TORCH_EXTENSION_NAME, m) {
     m.attr("N_DIRECTIONS") = N_DIRECTIONS;
     m.attr("N_MOVES") = N_MOVES;
     m.attr("TOTAL_STATE") = TOTAL_STATE;
+    m.attr("COMPACT_STATE") = COMPACT_STATE;
+    m.attr("BITBOARD_STATE") = BITBOARD_STATE;
+    m.attr("N_VALID_CELLS") = N_VALID_CELLS;
+    m.attr("N_TURN_MOVES") = N_TURN_MOVES;
+    m.attr("MASK_CACHE_SIZE") = MASK_CACHE_SIZE;
+    m.attr("N_OBS_CHANNELS") = N_OBS_CHANNELS;
+    m.attr("OBS_SIZE") = OBS_SIZE;
+    m.attr("N_SYMMETRIES") = N_SYMMETRIES;
+    m.attr("SYM_IDENTITY") = (int)SYM_IDENTITY;
+    m.attr("SYM_MIRROR") = (int)SYM_MIRROR;
+    m.attr("SYM_SWAP") = (int)SYM_SWAP;
+    m.attr("SYM_MIRROR_SWAP") = (int)SYM_MIRROR_SWAP;
+    m.attr("N_STAR_POINTS") = N_STAR_POINTS;
+    m.attr("N_EVAL_FEATURES") = N_EVAL_FEATURES;
+    m.attr("EVAL_DISTANCE_1") = (int)EVAL_DISTANCE_1;
+    m.attr("EVAL_DISTANCE_2") = (int)EVAL_DISTANCE_2;
+    m.attr("EVAL_HOME_1") = (int)EVAL_HOME_1;
+    m.attr("EVAL_HOME_2") = (int)EVAL_HOME_2;
+    m.attr("EPISODE_TRACKER_SIZE") = EPISODE_TRACKER_SIZE;
 
     m.attr("even_row_neighbors") = py::cast(even_row_neighbors);
     m.attr("odd_row_neighbors") = py::cast(odd_row_neighbors);
@@ -36,24 +506,268 @@ PYBIND11_MODULE(TORCH_EXTENSION_NAME, m) {
     m.attr("min_max_cols") = py::cast(min_max_cols);
     m.attr("player_1_start") = py::cast(player_1_start);
     m.attr("player_2_start") = py::cast(player_2_start);
+    m.attr("step_targets") = py::cast(step_targets);
+    m.attr("jump_targets") = py::cast(jump_targets);
+    m.attr("symmetry_cells") = py::cast(symmetry_tables.cell);
+    m.attr("symmetry_directions") = py::cast(symmetry_tables.direction);
+    m.attr("symmetry_moves") = py::cast(symmetry_tables.move);
+    m.attr("star_point_cells") = py::cast(star_tables.point_cells);
+    m.attr("goal_cells") = py::cast(evaluation_tables.goal_cells);
+    m.attr("valid_cells") = py::cast(bitboard_tables.bit_to_cell);
+    m.attr("zobrist_piece_keys") = py::cast(zobrist_keys.piece);
+    m.attr("zobrist_player_2_key") = py::cast(zobrist_keys.player_2_to_move);
+    m.attr("zobrist_hop_keys") = py::cast(zobrist_keys.hop);
 
-    m.def("initialize_state_batched", &init_state_batched_wrap,
-          "Create n_batch new game states (batched, CPU).");
+    m.def("initialize_state_batched", &init_state_batched_wrap, py::arg("n_batch"), py::arg("compact") = false,
+          "Create n_batch new game states (batched, CPU). compact=True uses the uint8 COMPACT_STATE layout.");
+    m.def("to_compact_batched", &to_compact_batched_wrap,
+          "Convert batched int32 game states to the compact uint8 layout.");
+    m.def("from_compact_batched", &from_compact_batched_wrap,
+          "Convert batched compact uint8 game states to the int32 layout.");
+    m.def("get_state_hash_batched", &get_state_hash_batched_wrap,
+          "Get the 64-bit zobrist hash of batched game states as an int64 tensor.");
     m.def("get_action_mask_batched", &get_action_mask_batched_wrap,
           "Get action mask for batched game states.");
     m.def("update_state_batched", &update_state_batched_wrap,
           "Update batched game states in-place.");
+    m.def("get_action_mask_batched_out", &get_action_mask_batched_out_wrap,
+          "Write action masks for batched game states into a preallocated int32 (n_batch, N_MOVES) tensor.");
+    m.def("step_batched", &step_batched_wrap,
+          "Apply moves, write rewards/dones, reset finished games and write the next action masks, all in-place.");
+    m.def("init_mask_cache_batched", &init_mask_cache_batched_wrap,
+          "Build the incremental action-mask caches of batched game states, uint8 (n_batch, MASK_CACHE_SIZE).");
+    m.def("step_cached_batched", &step_cached_batched_wrap,
+          "step_batched that keeps the mask caches from init_mask_cache_batched in sync and writes the masks from "
+          "them instead of recomputing every move.");
+    m.def("set_mask_cache_verify", &set_mask_cache_verify, py::arg("verify"),
+          "Check every cached update against a full recomputation (raises on a mismatch). Defaults to on in debug "
+          "builds only.");
+    m.def("get_mask_cache_verify", &get_mask_cache_verify, "Whether cached updates are checked.");
+    m.def("encode_observation_batched", &encode_observation_batched_wrap, py::arg("game_state_batch"),
+          py::arg("layout") = "chw", py::arg("dtype") = "float32",
+          "Encode batched game states as own/opponent/empty/hop planes seen from the player to move, as a new "
+          "float32 or bfloat16 tensor. layout 'chw' gives (n, N_OBS_CHANNELS, ROWS, COLS), 'hwc' (n, ROWS, COLS, "
+          "N_OBS_CHANNELS).");
+    m.def("encode_observation_batched_out", &encode_observation_batched_out_wrap, py::arg("game_state_batch"),
+          py::arg("obs_batch"), py::arg("layout") = "chw",
+          "Encode batched game states into a preallocated float32 or bfloat16 tensor of n x OBS_SIZE values.");
+    m.def("step_observe_batched", &step_observe_batched_wrap, py::arg("game_state_batch"), py::arg("moves_batch"),
+          py::arg("reward_batch"), py::arg("done_batch"), py::arg("mask_batch"), py::arg("obs_batch"),
+          py::arg("layout") = "chw", "step_batched that also encodes the next observations into obs_batch.");
+    m.def("evaluate_batched", &evaluate_batched_wrap, py::arg("game_state_batch"),
+          "Heuristic features of batched game states as int32 (n, N_EVAL_FEATURES): per player the summed hex "
+          "distance of the pieces outside the goal to its furthest free cell (EVAL_DISTANCE_*), and the pieces "
+          "already home (EVAL_HOME_*).");
+    m.def("step_shaped_batched", &step_shaped_batched_wrap, py::arg("game_state_batch"), py::arg("moves_batch"),
+          py::arg("reward_batch"), py::arg("done_batch"), py::arg("mask_batch"), py::arg("shaping"),
+          "step_batched whose rewards also get shaping * (the mover's goal distance before - after the move).");
+    m.def("init_episode_tracker_batched", &init_episode_tracker_batched_wrap, py::arg("game_state_batch"),
+          "Episode trackers for step_limited_batched as int32 (n, EPISODE_TRACKER_SIZE).");
+    m.def("step_limited_batched", &step_limited_batched_wrap, py::arg("game_state_batch"), py::arg("tracker_batch"),
+          py::arg("moves_batch"), py::arg("reward_batch"), py::arg("terminated_batch"), py::arg("truncated_batch"),
+          py::arg("mask_batch"), py::arg("max_turns_batch"), py::arg("stall_turns_batch"),
+          py::arg("final_state_batch") = py::none(),
+          "step_batched with per-env limits (1 or n values each, 0 disables): a game is cut once its turn count "
+          "reaches max_turns, or after stall_turns turns in which neither player got its goal distance below its "
+          "best. Cut games reset like won ones and are flagged in truncated, won ones in terminated. The rows of "
+          "final_state_batch (shaped like the states) get the last position of the games that ended, to bootstrap "
+          "the truncated ones from.");
+    m.def("sample_actions_batched", &sample_actions_batched_wrap, py::arg("game_state_batch"), py::arg("seed"),
+          py::arg("step"), py::arg("logits_batch") = py::none(), py::arg("env_ids") = py::none(),
+          "Draw one legal move per state as int32 (n,), -1 where there is none: uniformly, or from the softmax of "
+          "logits_batch (n, N_MOVES) over the legal moves. Draws are philox of (seed, env_ids[row], step), the row "
+          "standing in for env_ids when it's None, so they are the same for any thread count, and with env_ids "
+          "for any batch order.");
+    m.def("sample_actions_csr_batched", &sample_actions_csr_batched_wrap, py::arg("game_state_batch"),
+          py::arg("seed"), py::arg("step"), py::arg("logits_batch") = py::none(), py::arg("env_ids") = py::none(),
+          "sample_actions_batched that also returns the legal moves as CSR: (moves, crow_indices int64 (n + 1,), "
+          "col_indices int32 move ids).");
+    m.def("transform_state_batched", &transform_state_batched_wrap, py::arg("game_state_batch"),
+          py::arg("symmetry_batch"),
+          "Apply one board symmetry (SYM_*) per state, as new states in the same layout. SYM_SWAP and "
+          "SYM_MIRROR_SWAP also exchange the players.");
+    m.def("transform_actions_batched", &transform_actions_batched_wrap, py::arg("action_batch"),
+          py::arg("symmetry_batch"),
+          "Permute (n, N_MOVES) masks or policies of any dtype to match transform_state_batched.");
+    m.def("transform_moves_batched", &transform_moves_batched_wrap, py::arg("moves_batch"), py::arg("symmetry_batch"),
+          "Map batched move indices through the symmetries.");
+    m.def("multiplayer_state_size", &multiplayer_state_size_wrap, py::arg("n_players"),
+          "Bytes per multiplayer game state for 2, 3, 4 or 6 players.");
+    m.def("initialize_multiplayer_batched", &initialize_multiplayer_batched_wrap, py::arg("n_batch"),
+          py::arg("n_players"),
+          "Create n_batch new games on the full star for 2, 3, 4 or 6 players, uint8 (n_batch, "
+          "multiplayer_state_size(n_players)).");
+    m.def("get_action_mask_multiplayer_batched", &get_action_mask_multiplayer_batched_wrap,
+          py::arg("game_state_batch"), py::arg("n_players"), "Get action masks for batched multiplayer states.");
+    m.def("step_multiplayer_batched", &step_multiplayer_batched_wrap, py::arg("game_state_batch"),
+          py::arg("moves_batch"), py::arg("reward_batch"), py::arg("done_batch"), py::arg("mask_batch"),
+          py::arg("n_players"), "step_batched for multiplayer states, the reward is the mover's.");
+    m.def("to_bitboard_batched", &to_bitboard_batched_wrap,
+          "Convert batched flat game states to bitboard states (int64, BITBOARD_STATE words each).");
+    m.def("from_bitboard_batched", &from_bitboard_batched_wrap,
+          "Convert batched bitboard states back to flat game states.");
+    m.def("get_action_mask_bitboard_batched", &get_action_mask_bitboard_batched_wrap,
+          "Get action mask for batched bitboard states.");
+    m.def("update_state_bitboard_batched", &update_state_bitboard_batched_wrap,
+          "Update batched bitboard states in-place.");
+    m.def("get_turn_action_mask_batched", &get_turn_action_mask_batched_wrap,
+          "Get the turn-level (piece, destination) action mask, shape (n_batch, N_TURN_MOVES).");
+    m.def("update_state_turn_batched", &update_state_turn_batched_wrap,
+          "Play a whole turn per game state in-place.");
+    m.def("get_action_mask_simd_batched", &get_action_mask_simd_batched_wrap,
+          "Get action mask for batched game states with the SIMD batch kernel (same masks as get_action_mask_batched).");
+    m.def("set_simd_isa", &set_simd_isa_wrap, py::arg("isa"),
+          "Force the ISA of the SIMD mask kernel ('scalar', 'avx2' or 'avx512'). Returns the ISA in effect, "
+          "which is clamped to what the cpu supports.");
+    m.def("get_simd_isa", &get_simd_isa_wrap, "Return the ISA used by the SIMD mask kernel.");
+
+    m.def("write_game_log", &write_game_log_wrap, py::arg("path"), py::arg("actions"), py::arg("game_offsets"),
+          "Write a binary game log from uint8 actions and int64 game offsets (n_games + 1). Read it back with "
+          "load_game_log. Empty games are dropped.");
+    m.def("game_log_from_text", &game_log_from_text, py::arg("text_path"), py::arg("log_path"),
+          py::call_guard<py::gil_scoped_release>(), "Convert a text game log to the binary format.");
+    m.def("game_log_to_text", &game_log_to_text, py::arg("log_path"), py::arg("text_path"),
+          py::call_guard<py::gil_scoped_release>(), "Convert a binary game log to the text format.");
+
+    m.def("alphabeta_search_batched", &alphabeta_search_batched_wrap, py::arg("game_state_batch"),
+          py::arg("max_depth") = 6, py::arg("time_limit_ms") = 0, py::arg("n_threads") = 1, py::arg("tt_size_log2") = 20,
+          py::call_guard<py::gil_scoped_release>(),
+          "Iterative deepening PVS with a shared TT and Lazy SMP, one search per state. Returns (best_moves, scores, "
+          "depths, nodes, nodes_per_second).");
+
+    py::class_<MCTS_wrap>(m, "MCTS")
+        .def(py::init<int, int, double, double, int>(), py::arg("n_simulations") = 256, py::arg("leaves_per_tree") = 8,
+             py::arg("c_puct") = 1.5, py::arg("virtual_loss") = 1.0, py::arg("max_nodes") = 1 << 16)
+        .def("load_model", &MCTS_wrap::load_model, py::arg("path"),
+             "Load a TorchScript module used as the evaluator when search() gets none.")
+        .def("search", &MCTS_wrap::search, py::arg("root_states"), py::arg("evaluator") = py::none(),
+             "Run n_simulations per root state, evaluating leaves in batches with evaluator(states, masks) -> "
+             "(priors, values). Returns (visit_counts (n, N_MOVES), root_values (n,)).")
+        .def("tree_sizes", &MCTS_wrap::tree_sizes, "Nodes used by each tree in the last search.");
+
+    py::class_<VecEnv_wrap>(m, "VecEnv")
+        .def(py::init<int, int, std::string, std::string, int, int>(), py::arg("n_envs"), py::arg("n_workers") = 1,
+             py::arg("layout") = "chw", py::arg("dtype") = "float32", py::arg("max_turns") = 0,
+             py::arg("stall_turns") = 0,
+             "n_envs self-resetting games stepped by n_workers threads (0 steps them inside send). Games are also "
+             "cut after max_turns turns or stall_turns turns without progress (0 disables either), which sets "
+             "truncated instead of dones. The last position of every game that ended in a step is left in "
+             "final_states.")
+        .def("reset", &VecEnv_wrap::reset, "Restart every game. Returns (observations, masks).")
+        .def("send", &VecEnv_wrap::send, py::arg("actions") = py::none(),
+             "Start a step and return right away. actions=None uses the contents of the actions buffer.")
+        .def("recv", &VecEnv_wrap::recv, "Wait for the step started by send. Returns (observations, rewards, dones, "
+                                         "masks), the same tensors every time.")
+        .def("step", &VecEnv_wrap::step, py::arg("actions") = py::none(), "send followed by recv.")
+        .def("ready", &VecEnv_wrap::ready, "Whether recv would return without waiting.")
+        .def_property_readonly("n_envs", &VecEnv_wrap::n_envs)
+        .def_property_readonly("n_workers", &VecEnv_wrap::n_workers)
+        .def_readonly("states", &VecEnv_wrap::states)
+        .def_readonly("actions", &VecEnv_wrap::actions)
+        .def_readonly("rewards", &VecEnv_wrap::rewards)
+        .def_readonly("dones", &VecEnv_wrap::dones)
+        .def_readonly("truncated", &VecEnv_wrap::truncated)
+        .def_readonly("final_states", &VecEnv_wrap::final_states)
+        .def_readonly("masks", &VecEnv_wrap::masks)
+        .def_readonly("observations", &VecEnv_wrap::observations);
+
+    m.def("set_parallel_config", &set_parallel_config, py::arg("n_threads") = 0, py::arg("grain_size") = 0,
+          "Set the thread count and per-thread grain size (in envs) used by the batched ops; 0 keeps the "
+          "current value. The thread count caps the ops within torch's intra-op pool and does not change "
+          "torch.get_num_threads().");
+    m.def("get_parallel_config", &get_parallel_config_wrap, "Return (n_threads, grain_size) for the batched ops.");
+
+    m.attr("STATS_ENABLED") = stats_enabled;
+    m.def("get_stats", &get_stats_wrap,
+          "Engine counters summed over every thread: per kernel calls/states/ns, and for the games advanced by the "
+          "step ops and VecEnv a histogram of legal moves per mask, jumps and hop chains played and wins per "
+          "player. All zeros unless built with CHINESE_CHECKERS_STATS.");
+    m.def("reset_stats", &reset_stats, "Zero the engine counters.");
+    m.def("set_trace_enabled", &set_trace_enabled, py::arg("enabled"),
+          "Record a chrome trace event per batched kernel call (needs CHINESE_CHECKERS_STATS).");
+    m.def("write_trace", &write_trace, py::arg("path"), "Write the recorded events as chrome trace-event JSON.");
+    m.def("clear_trace", &clear_trace, "Drop the recorded trace events.");
 }
 
 // Register custom ops if needed
 TORCH_LIBRARY(chinese_checkers_ext, m) {
-    m.def("initialize_state_batched(int n_batch) -> Tensor");
+    m.def("initialize_state_batched(int n_batch, bool compact=False) -> Tensor");
+    m.def("to_compact_batched(Tensor game_state_batch) -> Tensor");
+    m.def("from_compact_batched(Tensor game_state_batch) -> Tensor");
+    m.def("get_state_hash_batched(Tensor game_state_batch) -> Tensor");
     m.def("get_action_mask_batched(Tensor game_state_batch) -> Tensor");
     m.def("update_state_batched(Tensor game_state_batch, Tensor moves_batch) -> int");
+    m.def("get_action_mask_batched_out(Tensor game_state_batch, Tensor(a!) mask_batch) -> int");
+    m.def("step_batched(Tensor(a!) game_state_batch, Tensor moves_batch, Tensor(b!) reward_batch, "
+          "Tensor(c!) done_batch, Tensor(d!) mask_batch) -> int");
+    m.def("init_mask_cache_batched(Tensor game_state_batch) -> Tensor");
+    m.def("step_cached_batched(Tensor(a!) game_state_batch, Tensor(b!) cache_batch, Tensor moves_batch, "
+          "Tensor(c!) reward_batch, Tensor(d!) done_batch, Tensor(e!) mask_batch) -> int");
+    m.def("encode_observation_batched(Tensor game_state_batch, str layout=\"chw\", str dtype=\"float32\") -> Tensor");
+    m.def("encode_observation_batched_out(Tensor game_state_batch, Tensor(a!) obs_batch, str layout=\"chw\") -> int");
+    m.def("step_observe_batched(Tensor(a!) game_state_batch, Tensor moves_batch, Tensor(b!) reward_batch, "
+          "Tensor(c!) done_batch, Tensor(d!) mask_batch, Tensor(e!) obs_batch, str layout=\"chw\") -> int");
+    m.def("evaluate_batched(Tensor game_state_batch) -> Tensor");
+    m.def("step_shaped_batched(Tensor(a!) game_state_batch, Tensor moves_batch, Tensor(b!) reward_batch, "
+          "Tensor(c!) done_batch, Tensor(d!) mask_batch, float shaping) -> int");
+    m.def("init_episode_tracker_batched(Tensor game_state_batch) -> Tensor");
+    m.def("step_limited_batched(Tensor(a!) game_state_batch, Tensor(b!) tracker_batch, Tensor moves_batch, "
+          "Tensor(c!) reward_batch, Tensor(d!) terminated_batch, Tensor(e!) truncated_batch, Tensor(f!) mask_batch, "
+          "Tensor max_turns_batch, Tensor stall_turns_batch, Tensor(g!)? final_state_batch=None) -> int");
+    m.def("sample_actions_batched(Tensor game_state_batch, int seed, int step, Tensor? logits_batch=None, "
+          "Tensor? env_ids=None) -> Tensor");
+    m.def("sample_actions_csr_batched(Tensor game_state_batch, int seed, int step, Tensor? logits_batch=None, "
+          "Tensor? env_ids=None) -> (Tensor, Tensor, Tensor)");
+    m.def("transform_state_batched(Tensor game_state_batch, Tensor symmetry_batch) -> Tensor");
+    m.def("transform_actions_batched(Tensor action_batch, Tensor symmetry_batch) -> Tensor");
+    m.def("transform_moves_batched(Tensor moves_batch, Tensor symmetry_batch) -> Tensor");
+    m.def("initialize_multiplayer_batched(int n_batch, int n_players) -> Tensor");
+    m.def("get_action_mask_multiplayer_batched(Tensor game_state_batch, int n_players) -> Tensor");
+    m.def("step_multiplayer_batched(Tensor(a!) game_state_batch, Tensor moves_batch, Tensor(b!) reward_batch, "
+          "Tensor(c!) done_batch, Tensor(d!) mask_batch, int n_players) -> int");
+    m.def("to_bitboard_batched(Tensor game_state_batch) -> Tensor");
+    m.def("from_bitboard_batched(Tensor bitboard_batch) -> Tensor");
+    m.def("get_action_mask_bitboard_batched(Tensor bitboard_batch) -> Tensor");
+    m.def("update_state_bitboard_batched(Tensor bitboard_batch, Tensor moves_batch) -> int");
+    m.def("get_turn_action_mask_batched(Tensor game_state_batch) -> Tensor");
+    m.def("update_state_turn_batched(Tensor game_state_batch, Tensor turn_moves_batch) -> int");
+    m.def("get_action_mask_simd_batched(Tensor game_state_batch) -> Tensor");
+    m.def("alphabeta_search_batched(Tensor game_state_batch, int max_depth=6, int time_limit_ms=0, int n_threads=1, "
+          "int tt_size_log2=20) -> (Tensor, Tensor, Tensor, Tensor, float)");
 }
 
 TORCH_LIBRARY_IMPL(chinese_checkers_ext, CPU, m) {
     m.impl("initialize_state_batched", &init_state_batched_wrap);
+    m.impl("to_compact_batched", &to_compact_batched_wrap);
+    m.impl("from_compact_batched", &from_compact_batched_wrap);
+    m.impl("get_state_hash_batched", &get_state_hash_batched_wrap);
     m.impl("get_action_mask_batched", &get_action_mask_batched_wrap);
     m.impl("update_state_batched", &update_state_batched_wrap);
+    m.impl("get_action_mask_batched_out", &get_action_mask_batched_out_wrap);
+    m.impl("step_batched", &step_batched_wrap);
+    m.impl("init_mask_cache_batched", &init_mask_cache_batched_wrap);
+    m.impl("step_cached_batched", &step_cached_batched_wrap);
+    m.impl("encode_observation_batched", &encode_observation_batched_wrap);
+    m.impl("encode_observation_batched_out", &encode_observation_batched_out_wrap);
+    m.impl("step_observe_batched", &step_observe_batched_wrap);
+    m.impl("evaluate_batched", &evaluate_batched_wrap);
+    m.impl("step_shaped_batched", &step_shaped_batched_wrap);
+    m.impl("init_episode_tracker_batched", &init_episode_tracker_batched_wrap);
+    m.impl("step_limited_batched", &step_limited_batched_wrap);
+    m.impl("sample_actions_batched", &sample_actions_batched_wrap);
+    m.impl("sample_actions_csr_batched", &sample_actions_csr_batched_wrap);
+    m.impl("transform_state_batched", &transform_state_batched_wrap);
+    m.impl("transform_actions_batched", &transform_actions_batched_wrap);
+    m.impl("transform_moves_batched", &transform_moves_batched_wrap);
+    m.impl("initialize_multiplayer_batched", &initialize_multiplayer_batched_wrap);
+    m.impl("get_action_mask_multiplayer_batched", &get_action_mask_multiplayer_batched_wrap);
+    m.impl("step_multiplayer_batched", &step_multiplayer_batched_wrap);
+    m.impl("to_bitboard_batched", &to_bitboard_batched_wrap);
+    m.impl("from_bitboard_batched", &from_bitboard_batched_wrap);
+    m.impl("get_action_mask_bitboard_batched", &get_action_mask_bitboard_batched_wrap);
+    m.impl("update_state_bitboard_batched", &update_state_bitboard_batched_wrap);
+    m.impl("get_turn_action_mask_batched", &get_turn_action_mask_batched_wrap);
+    m.impl("update_state_turn_batched", &update_state_turn_batched_wrap);
+    m.impl("get_action_mask_simd_batched", &get_action_mask_simd_batched_wrap);
+    m.impl("alphabeta_search_batched", &alphabeta_search_batched_wrap);
 }
@@ -0,0 +1,647 @@
+#include "chinese_checkers.h"
+#include "bitboard.h"
+#include "board.h"
+#include "constants.h"
+#include "engine.h"
+#include "episode.h"
+#include "evaluation.h"
+#include "mask_cache.h"
+#include "multiplayer.h"
+#include "observation.h"
+#include "sampling.h"
+#include "simd_mask.h"
+#include "stats.h"
+#include "symmetry.h"
+#include "turn_moves.h"
+#include <algorithm>
+#include <atomic>
+#include <type_traits>
+#include <torch/torch.h>
+
+auto static const tensor_options = torch::dtype(torch::kInt32).requires_grad(false);
+auto static const compact_tensor_options = torch::dtype(torch::kUInt8).requires_grad(false);
+auto static const hash_tensor_options = torch::dtype(torch::kInt64).requires_grad(false);
+auto static const bitboard_tensor_options = torch::dtype(torch::kInt64).requires_grad(false);
+
+// the extension's own thread count, 0 follows torch. it only caps how many chunks a batch is split into,
+// torch's global intra-op pool (at::set_num_threads) is left alone
+static std::atomic<int> batch_threads{0};
+
+static void torch_parallel_for(int64_t n, int64_t grain_size, const std::function<void(int64_t, int64_t)>& fn) {
+    int n_threads = batch_threads.load(std::memory_order_relaxed);
+    if (n_threads == 1) {
+        if (n > 0) {
+            fn(0, n);
+        }
+        return;
+    }
+    if (n_threads > 1) {
+        grain_size = std::max(grain_size, (n + n_threads - 1) / n_threads);
+    }
+    at::parallel_for(0, n, grain_size, fn);
+}
+
+// loading the extension (or linking this file into a binary) routes the engine's batch loops through torch
+[[maybe_unused]] static const bool torch_backend_installed = (set_parallel_backend(&torch_parallel_for), true);
+
+void set_parallel_config(int n_threads, int64_t grain_size) {
+    if (n_threads > 0) {
+        batch_threads.store(n_threads, std::memory_order_relaxed);
+    }
+    set_grain_size(grain_size);
+}
+
+int get_num_threads() {
+    int n_threads = batch_threads.load(std::memory_order_relaxed);
+    return n_threads > 0 ? n_threads : at::get_num_threads();
+}
+
+torch::Tensor initialize_state_batched(int n_batch, bool compact) {
+    auto tensor = compact ? torch::zeros({n_batch, (long long)COMPACT_STATE}, compact_tensor_options)
+                          : torch::zeros({n_batch, (long long)TOTAL_STATE}, tensor_options);
+    for_each_state(tensor, n_batch, [&](int64_t i, auto grid_state) { initialize_state(grid_state); });
+    return tensor;
+}
+
+torch::Tensor to_compact_batched(torch::Tensor& game_state_batch, int n_batch) {
+    auto tensor = torch::zeros({n_batch, (long long)COMPACT_STATE}, compact_tensor_options);
+    auto tensor_data = tensor.data_ptr<uint8_t>();
+    game_state_batch = game_state_batch.contiguous();
+    for_each_state(game_state_batch, n_batch, [&](int64_t i, auto grid_state) {
+        copy_state(grid_state, CompactGameState_t(tensor_data + i * COMPACT_STATE));
+    });
+    return tensor;
+}
+
+torch::Tensor from_compact_batched(torch::Tensor& game_state_batch, int n_batch) {
+    auto tensor = torch::zeros({n_batch, (long long)TOTAL_STATE}, tensor_options);
+    auto tensor_data = tensor.data_ptr<int>();
+    game_state_batch = game_state_batch.contiguous();
+    for_each_state(game_state_batch, n_batch, [&](int64_t i, auto grid_state) {
+        copy_state(grid_state, GameState_t(tensor_data + i * TOTAL_STATE));
+    });
+    return tensor;
+}
+
+torch::Tensor get_state_hash_batched(torch::Tensor& game_state_batch, int n_batch) {
+    auto tensor = torch::empty({n_batch}, hash_tensor_options);
+    auto tensor_data = tensor.data_ptr<int64_t>();
+    game_state_batch = game_state_batch.contiguous();
+    for_each_state(game_state_batch, n_batch,
+                   [&](int64_t i, auto grid_state) { tensor_data[i] = static_cast<int64_t>(*grid_state.hash); });
+    return tensor;
+}
+
+static void check_mask_buffer(const torch::Tensor& mask_batch, int n_batch) {
+    TORCH_CHECK(mask_batch.scalar_type() == torch::kInt32, "mask buffer must be an int32 tensor");
+    TORCH_CHECK(mask_batch.is_contiguous(), "mask buffer must be contiguous");
+    TORCH_CHECK(mask_batch.numel() == (int64_t)n_batch * (int64_t)N_MOVES, "mask buffer must hold n_batch x N_MOVES");
+}
+
+torch::Tensor get_action_mask_batched(torch::Tensor& game_state_batch, int n_batch) {
+    // get_action_mask_batched_out clears every row itself, no need to pay for torch::zeros
+    auto tensor = torch::empty({n_batch, (long long)N_MOVES}, tensor_options);
+    get_action_mask_batched_out(game_state_batch, tensor, n_batch);
+    return tensor;
+}
+
+void get_action_mask_batched_out(torch::Tensor& game_state_batch, torch::Tensor& mask_batch, int n_batch) {
+    StatsTimer_t timer(KERNEL_GET_ACTION_MASK_BATCHED, n_batch);
+    check_mask_buffer(mask_batch, n_batch);
+    auto tensor_data = mask_batch.data_ptr<int>();
+    game_state_batch = game_state_batch.contiguous();
+    for_each_state(game_state_batch, n_batch, [&](int64_t i, auto grid_state) {
+        auto dest = tensor_data + i * N_MOVES;
+        std::fill_n(dest, N_MOVES, 0);
+        set_action_mask(grid_state, dest);
+    });
+}
+
+void update_state_batched(torch::Tensor& game_state_batch, torch::Tensor& action_batch, int n_batch) {
+    StatsTimer_t timer(KERNEL_UPDATE_STATE_BATCHED, n_batch);
+    game_state_batch = game_state_batch.contiguous();
+    action_batch = action_batch.contiguous();
+    auto action_batch_ptr = action_batch.data_ptr<int>();
+    for_each_state(game_state_batch, n_batch, [&](int64_t i, auto grid_state) {
+        auto move = action_batch_ptr[i];
+        update_state(grid_state, move);
+    });
+}
+
+static void check_step_buffers(const torch::Tensor& reward_batch, const torch::Tensor& done_batch,
+                               const torch::Tensor& mask_batch, int n_batch) {
+    // the outputs are caller-owned buffers that get reused every step, so they're written in place
+    TORCH_CHECK(reward_batch.scalar_type() == torch::kFloat32, "reward buffer must be a float32 tensor");
+    TORCH_CHECK(reward_batch.is_contiguous() && reward_batch.numel() == n_batch, "reward buffer must hold n_batch");
+    TORCH_CHECK(done_batch.scalar_type() == torch::kBool, "done buffer must be a bool tensor");
+    TORCH_CHECK(done_batch.is_contiguous() && done_batch.numel() == n_batch, "done buffer must hold n_batch");
+    check_mask_buffer(mask_batch, n_batch);
+}
+
+void step_batched(torch::Tensor& game_state_batch, torch::Tensor& action_batch, torch::Tensor& reward_batch,
+                  torch::Tensor& done_batch, torch::Tensor& mask_batch, int n_batch) {
+    StatsTimer_t timer(KERNEL_STEP_BATCHED, n_batch);
+    check_step_buffers(reward_batch, done_batch, mask_batch, n_batch);
+
+    game_state_batch = game_state_batch.contiguous();
+    action_batch = action_batch.contiguous();
+    auto action_batch_ptr = action_batch.data_ptr<int>();
+    auto reward_batch_ptr = reward_batch.data_ptr<float>();
+    auto done_batch_ptr = done_batch.data_ptr<bool>();
+    auto mask_batch_ptr = mask_batch.data_ptr<int>();
+    for_each_state(game_state_batch, n_batch, [&](int64_t i, auto grid_state) {
+        step_state(grid_state, action_batch_ptr[i], reward_batch_ptr[i], done_batch_ptr[i], mask_batch_ptr + i * N_MOVES);
+    });
+}
+
+static inline mask_cache_t* mask_cache_ptr(torch::Tensor& cache_batch, int n_batch) {
+    TORCH_CHECK(cache_batch.scalar_type() == torch::kUInt8, "mask caches must be a uint8 tensor");
+    TORCH_CHECK(cache_batch.is_contiguous(), "mask caches must be contiguous");
+    TORCH_CHECK(cache_batch.dim() == 2 && cache_batch.size(0) == n_batch &&
+                    cache_batch.size(1) == (int64_t)MASK_CACHE_SIZE,
+                "mask caches must be (n_batch, MASK_CACHE_SIZE)");
+    return reinterpret_cast<mask_cache_t*>(cache_batch.data_ptr<uint8_t>());
+}
+
+torch::Tensor init_mask_cache_batched(torch::Tensor& game_state_batch, int n_batch) {
+    auto tensor = torch::empty({n_batch, (long long)MASK_CACHE_SIZE}, compact_tensor_options);
+    auto caches = mask_cache_ptr(tensor, n_batch);
+    game_state_batch = game_state_batch.contiguous();
+    for_each_state(game_state_batch, n_batch, [&](int64_t i, auto grid_state) { init_mask_cache(grid_state, caches[i]); });
+    return tensor;
+}
+
+void step_cached_batched(torch::Tensor& game_state_batch, torch::Tensor& cache_batch, torch::Tensor& action_batch,
+                         torch::Tensor& reward_batch, torch::Tensor& done_batch, torch::Tensor& mask_batch, int n_batch) {
+    StatsTimer_t timer(KERNEL_STEP_CACHED_BATCHED, n_batch);
+    check_step_buffers(reward_batch, done_batch, mask_batch, n_batch);
+    auto caches = mask_cache_ptr(cache_batch, n_batch);
+
+    game_state_batch = game_state_batch.contiguous();
+    action_batch = action_batch.contiguous();
+    auto action_batch_ptr = action_batch.data_ptr<int>();
+    auto reward_batch_ptr = reward_batch.data_ptr<float>();
+    auto done_batch_ptr = done_batch.data_ptr<bool>();
+    auto mask_batch_ptr = mask_batch.data_ptr<int>();
+    for_each_state(game_state_batch, n_batch, [&](int64_t i, auto grid_state) {
+        step_state_cached(grid_state, caches[i], action_batch_ptr[i], reward_batch_ptr[i], done_batch_ptr[i],
+                          mask_batch_ptr + i * N_MOVES);
+    });
+}
+
+static void check_obs_buffer(const torch::Tensor& obs_batch, int n_batch) {
+    TORCH_CHECK(obs_batch.scalar_type() == torch::kFloat32 || obs_batch.scalar_type() == torch::kBFloat16,
+                "observation buffer must be a float32 or bfloat16 tensor");
+    TORCH_CHECK(obs_batch.is_contiguous(), "observation buffer must be contiguous");
+    TORCH_CHECK(obs_batch.numel() == (int64_t)n_batch * (int64_t)OBS_SIZE,
+                "observation buffer must hold n_batch x OBS_SIZE");
+}
+
+// fn(ptr) with the buffer as float* or, for bfloat16, as the uint16_t* encode_observation takes
+template <typename F>
+static void with_obs_ptr(torch::Tensor& obs_batch, const F& fn) {
+    if (obs_batch.scalar_type() == torch::kBFloat16) {
+        fn(reinterpret_cast<uint16_t*>(obs_batch.data_ptr<at::BFloat16>()));
+    } else {
+        fn(obs_batch.data_ptr<float>());
+    }
+}
+
+torch::Tensor encode_observation_batched(torch::Tensor& game_state_batch, int n_batch, obs_layout_t layout,
+                                         const std::string& dtype) {
+    TORCH_CHECK(dtype == "float32" || dtype == "bfloat16", "observation dtype must be float32 or bfloat16");
+    auto options = torch::dtype(dtype == "bfloat16" ? torch::kBFloat16 : torch::kFloat32).requires_grad(false);
+    auto tensor = (layout == obs_layout_t::chw)
+                      ? torch::empty({n_batch, (long long)N_OBS_CHANNELS, (long long)ROWS, (long long)COLS}, options)
+                      : torch::empty({n_batch, (long long)ROWS, (long long)COLS, (long long)N_OBS_CHANNELS}, options);
+    encode_observation_batched_out(game_state_batch, tensor, n_batch, layout);
+    return tensor;
+}
+
+void encode_observation_batched_out(torch::Tensor& game_state_batch, torch::Tensor& obs_batch, int n_batch,
+                                    obs_layout_t layout) {
+    StatsTimer_t timer(KERNEL_ENCODE_OBSERVATION_BATCHED, n_batch);
+    check_obs_buffer(obs_batch, n_batch);
+    game_state_batch = game_state_batch.contiguous();
+    with_obs_ptr(obs_batch, [&](auto obs_ptr) {
+        for_each_state(game_state_batch, n_batch, [&](int64_t i, auto grid_state) {
+            encode_observation(grid_state, obs_ptr + i * OBS_SIZE, layout);
+        });
+    });
+}
+
+void step_observe_batched(torch::Tensor& game_state_batch, torch::Tensor& action_batch, torch::Tensor& reward_batch,
+                          torch::Tensor& done_batch, torch::Tensor& mask_batch, torch::Tensor& obs_batch,
+                          int n_batch, obs_layout_t layout) {
+    StatsTimer_t timer(KERNEL_STEP_OBSERVE_BATCHED, n_batch);
+    check_step_buffers(reward_batch, done_batch, mask_batch, n_batch);
+    check_obs_buffer(obs_batch, n_batch);
+
+    game_state_batch = game_state_batch.contiguous();
+    action_batch = action_batch.contiguous();
+    auto action_batch_ptr = action_batch.data_ptr<int>();
+    auto reward_batch_ptr = reward_batch.data_ptr<float>();
+    auto done_batch_ptr = done_batch.data_ptr<bool>();
+    auto mask_batch_ptr = mask_batch.data_ptr<int>();
+    // the state is still in cache when it gets encoded
+    with_obs_ptr(obs_batch, [&](auto obs_ptr) {
+        for_each_state(game_state_batch, n_batch, [&](int64_t i, auto grid_state) {
+            step_state(grid_state, action_batch_ptr[i], reward_batch_ptr[i], done_batch_ptr[i],
+                       mask_batch_ptr + i * N_MOVES);
+            encode_observation(grid_state, obs_ptr + i * OBS_SIZE, layout);
+        });
+    });
+}
+
+torch::Tensor evaluate_batched(torch::Tensor& game_state_batch, int n_batch) {
+    StatsTimer_t timer(KERNEL_EVALUATE_BATCHED, n_batch);
+    auto tensor = torch::empty({n_batch, (long long)N_EVAL_FEATURES}, tensor_options);
+    auto tensor_data = tensor.data_ptr<int>();
+    game_state_batch = game_state_batch.contiguous();
+    for_each_state(game_state_batch, n_batch, [&](int64_t i, auto grid_state) {
+        auto features = evaluate_state(grid_state);
+        auto dest = tensor_data + i * N_EVAL_FEATURES;
+        for (size_t p = 0; p < N_PLAYERS; p++) {
+            dest[EVAL_DISTANCE_1 + p] = features.distance[p];
+            dest[EVAL_HOME_1 + p] = features.home[p];
+        }
+    });
+    return tensor;
+}
+
+void step_shaped_batched(torch::Tensor& game_state_batch, torch::Tensor& action_batch, torch::Tensor& reward_batch,
+                         torch::Tensor& done_batch, torch::Tensor& mask_batch, int n_batch, double shaping) {
+    StatsTimer_t timer(KERNEL_STEP_SHAPED_BATCHED, n_batch);
+    check_step_buffers(reward_batch, done_batch, mask_batch, n_batch);
+
+    game_state_batch = game_state_batch.contiguous();
+    action_batch = action_batch.contiguous();
+    auto action_batch_ptr = action_batch.data_ptr<int>();
+    auto reward_batch_ptr = reward_batch.data_ptr<float>();
+    auto done_batch_ptr = done_batch.data_ptr<bool>();
+    auto mask_batch_ptr = mask_batch.data_ptr<int>();
+    for_each_state(game_state_batch, n_batch, [&](int64_t i, auto grid_state) {
+        step_state_shaped(grid_state, action_batch_ptr[i], (float)shaping, reward_batch_ptr[i], done_batch_ptr[i],
+                          mask_batch_ptr + i * N_MOVES);
+    });
+}
+
+static inline episode_tracker_t* episode_tracker_ptr(torch::Tensor& tracker_batch, int n_batch) {
+    TORCH_CHECK(tracker_batch.scalar_type() == torch::kInt32, "episode trackers must be an int32 tensor");
+    TORCH_CHECK(tracker_batch.is_contiguous(), "episode trackers must be contiguous");
+    TORCH_CHECK(tracker_batch.dim() == 2 && tracker_batch.size(0) == n_batch &&
+                    tracker_batch.size(1) == (int64_t)EPISODE_TRACKER_SIZE,
+                "episode trackers must be (n_batch, EPISODE_TRACKER_SIZE)");
+    return reinterpret_cast<episode_tracker_t*>(tracker_batch.data_ptr<int>());
+}
+
+// one limit per env or a single one for all of them, as a contiguous int32 tensor
+static torch::Tensor checked_limits(const torch::Tensor& limit_batch, int n_batch, const char* name) {
+    TORCH_CHECK(limit_batch.numel() == n_batch || limit_batch.numel() == 1, name, " must hold 1 or n_batch limits");
+    auto limits = limit_batch.to(torch::kInt32).contiguous();
+    auto limits_ptr = limits.data_ptr<int>();
+    for (int64_t i = 0; i < limits.numel(); i++) {
+        TORCH_CHECK(limits_ptr[i] >= 0, name, " must be >= 0");
+    }
+    return limits;
+}
+
+torch::Tensor init_episode_tracker_batched(torch::Tensor& game_state_batch, int n_batch) {
+    auto tensor = torch::empty({n_batch, (long long)EPISODE_TRACKER_SIZE}, tensor_options);
+    auto trackers = episode_tracker_ptr(tensor, n_batch);
+    game_state_batch = game_state_batch.contiguous();
+    for_each_state(game_state_batch, n_batch,
+                   [&](int64_t i, auto grid_state) { init_episode_tracker(grid_state, trackers[i]); });
+    return tensor;
+}
+
+void step_limited_batched(torch::Tensor& game_state_batch, torch::Tensor& tracker_batch, torch::Tensor& action_batch,
+                          torch::Tensor& reward_batch, torch::Tensor& terminated_batch, torch::Tensor& truncated_batch,
+                          torch::Tensor& mask_batch, torch::Tensor& max_turns_batch, torch::Tensor& stall_turns_batch,
+                          const std::optional<torch::Tensor>& final_state_batch, int n_batch) {
+    StatsTimer_t timer(KERNEL_STEP_LIMITED_BATCHED, n_batch);
+    check_step_buffers(reward_batch, terminated_batch, mask_batch, n_batch);
+    if (final_state_batch.has_value()) {
+        TORCH_CHECK(final_state_batch->scalar_type() == game_state_batch.scalar_type() &&
+                        final_state_batch->is_contiguous() && final_state_batch->sizes() == game_state_batch.sizes(),
+                    "final state buffer must be a contiguous tensor shaped like the game states");
+    }
+    TORCH_CHECK(truncated_batch.scalar_type() == torch::kBool, "truncated buffer must be a bool tensor");
+    TORCH_CHECK(truncated_batch.is_contiguous() && truncated_batch.numel() == n_batch,
+                "truncated buffer must hold n_batch");
+    auto trackers = episode_tracker_ptr(tracker_batch, n_batch);
+    auto max_turns = checked_limits(max_turns_batch, n_batch, "max_turns");
+    auto stall_turns = checked_limits(stall_turns_batch, n_batch, "stall_turns");
+    auto max_turns_ptr = max_turns.data_ptr<int>();
+    auto stall_turns_ptr = stall_turns.data_ptr<int>();
+    int64_t max_turns_stride = max_turns.numel() > 1;
+    int64_t stall_turns_stride = stall_turns.numel() > 1;
+
+    game_state_batch = game_state_batch.contiguous();
+    action_batch = action_batch.contiguous();
+    auto action_batch_ptr = action_batch.data_ptr<int>();
+    auto reward_batch_ptr = reward_batch.data_ptr<float>();
+    auto terminated_batch_ptr = terminated_batch.data_ptr<bool>();
+    auto truncated_batch_ptr = truncated_batch.data_ptr<bool>();
+    auto mask_batch_ptr = mask_batch.data_ptr<int>();
+    void* final_state_batch_ptr = final_state_batch.has_value() ? final_state_batch->data_ptr() : nullptr;
+    for_each_state(game_state_batch, n_batch, [&](int64_t i, auto grid_state) {
+        episode_limits_t limits{max_turns_ptr[i * max_turns_stride], stall_turns_ptr[i * stall_turns_stride]};
+        if constexpr (std::is_same_v<decltype(grid_state), CompactGameState_t>) {
+            auto final_state = final_state_batch_ptr ? (uint8_t*)final_state_batch_ptr + i * COMPACT_STATE : nullptr;
+            step_state_limited(grid_state, trackers[i], limits, action_batch_ptr[i], reward_batch_ptr[i],
+                               terminated_batch_ptr[i], truncated_batch_ptr[i], mask_batch_ptr + i * N_MOVES,
+                               final_state);
+        } else {
+            auto final_state = final_state_batch_ptr ? (int*)final_state_batch_ptr + i * TOTAL_STATE : nullptr;
+            step_state_limited(grid_state, trackers[i], limits, action_batch_ptr[i], reward_batch_ptr[i],
+                               terminated_batch_ptr[i], truncated_batch_ptr[i], mask_batch_ptr + i * N_MOVES,
+                               final_state);
+        }
+    });
+}
+
+std::tuple<torch::Tensor, torch::Tensor, torch::Tensor>
+sample_actions_batched(torch::Tensor& game_state_batch, int64_t seed, int64_t step,
+                       const std::optional<torch::Tensor>& logits_batch, const std::optional<torch::Tensor>& env_ids,
+                       bool legal_csr, int n_batch) {
+    StatsTimer_t timer(KERNEL_SAMPLE_ACTIONS_BATCHED, n_batch);
+    torch::Tensor logits;
+    const float* logits_ptr = nullptr;
+    if (logits_batch.has_value()) {
+        TORCH_CHECK(logits_batch->numel() == (int64_t)n_batch * (int64_t)N_MOVES, "logits must be (n_batch, N_MOVES)");
+        logits = logits_batch->to(torch::kFloat32).contiguous();
+        logits_ptr = logits.data_ptr<float>();
+    }
+    torch::Tensor streams;
+    const int64_t* streams_ptr = nullptr;
+    if (env_ids.has_value()) {
+        TORCH_CHECK(c10::isIntegralType(env_ids->scalar_type(), false), "env_ids must be an integer tensor");
+        TORCH_CHECK(env_ids->dim() == 1 && env_ids->size(0) == n_batch, "env_ids must be (n_batch,)");
+        streams = env_ids->to(torch::kInt64).contiguous();
+        streams_ptr = streams.data_ptr<int64_t>();
+    }
+    auto actions = torch::empty({n_batch}, tensor_options);
+    auto actions_ptr = actions.data_ptr<int>();
+    // the legal moves land in fixed N_MOVES rows first and are packed once every row is known
+    torch::Tensor legal, counts;
+    int* legal_ptr = nullptr;
+    int* counts_ptr = nullptr;
+    if (legal_csr) {
+        legal = torch::empty({n_batch, (long long)N_MOVES}, tensor_options);
+        counts = torch::empty({n_batch}, tensor_options);
+        legal_ptr = legal.data_ptr<int>();
+        counts_ptr = counts.data_ptr<int>();
+    }
+
+    game_state_batch = game_state_batch.contiguous();
+    for_each_state(game_state_batch, n_batch, [&](int64_t i, auto grid_state) {
+        int scratch[N_MOVES];
+        int n_legal;
+        uint64_t stream = streams_ptr ? (uint64_t)streams_ptr[i] : (uint64_t)i;
+        actions_ptr[i] = sample_action(grid_state, logits_ptr ? logits_ptr + i * N_MOVES : nullptr, (uint64_t)seed,
+                                       stream, (uint64_t)step, legal_csr ? legal_ptr + i * N_MOVES : scratch, n_legal);
+        if (legal_csr)
+            counts_ptr[i] = n_legal;
+    });
+    if (!legal_csr) {
+        return {actions, torch::Tensor(), torch::Tensor()};
+    }
+
+    auto crow_indices = torch::empty({n_batch + 1}, torch::dtype(torch::kInt64));
+    auto crow_ptr = crow_indices.data_ptr<int64_t>();
+    crow_ptr[0] = 0;
+    for (int i = 0; i < n_batch; i++) {
+        crow_ptr[i + 1] = crow_ptr[i] + counts_ptr[i];
+    }
+    auto col_indices = torch::empty({crow_ptr[n_batch]}, tensor_options);
+    auto col_ptr = col_indices.data_ptr<int>();
+    for (int i = 0; i < n_batch; i++) {
+        std::copy_n(legal_ptr + (size_t)i * N_MOVES, counts_ptr[i], col_ptr + crow_ptr[i]);
+    }
+    return {actions, crow_indices, col_indices};
+}
+
+// symmetry ids as a contiguous int64 cpu tensor
+static torch::Tensor checked_symmetries(const torch::Tensor& symmetry_batch, int64_t n_batch) {
+    TORCH_CHECK(symmetry_batch.dim() == 1 && symmetry_batch.size(0) == n_batch, "symmetries must be (n_batch,)");
+    auto symmetries = symmetry_batch.to(torch::kInt64).contiguous();
+    auto symmetries_ptr = symmetries.data_ptr<int64_t>();
+    for (int64_t i = 0; i < n_batch; i++) {
+        TORCH_CHECK(symmetries_ptr[i] >= 0 && symmetries_ptr[i] < (int64_t)N_SYMMETRIES,
+                    "symmetries must be in [0, N_SYMMETRIES)");
+    }
+    return symmetries;
+}
+
+torch::Tensor transform_state_batched(torch::Tensor& game_state_batch, torch::Tensor& symmetry_batch, int n_batch) {
+    auto symmetries = checked_symmetries(symmetry_batch, n_batch);
+    auto symmetries_ptr = symmetries.data_ptr<int64_t>();
+    game_state_batch = game_state_batch.contiguous();
+    auto tensor = torch::empty_like(game_state_batch);
+    for_each_state(game_state_batch, n_batch, [&](int64_t i, auto grid_state) {
+        auto symmetry = (symmetry_t)symmetries_ptr[i];
+        if constexpr (std::is_same_v<decltype(grid_state), CompactGameState_t>) {
+            transform_state(grid_state, CompactGameState_t(tensor.data_ptr<uint8_t>() + i * COMPACT_STATE), symmetry);
+        } else {
+            transform_state(grid_state, GameState_t(tensor.data_ptr<int>() + i * TOTAL_STATE), symmetry);
+        }
+    });
+    return tensor;
+}
+
+// row s of the (N_SYMMETRIES, N_MOVES) table is symmetry_tables.move[s]
+static torch::Tensor symmetry_move_table() {
+    auto table = torch::empty({(long long)N_SYMMETRIES, (long long)N_MOVES}, hash_tensor_options);
+    auto table_ptr = table.data_ptr<int64_t>();
+    for (size_t sym = 0; sym < N_SYMMETRIES; sym++) {
+        for (size_t m = 0; m < N_MOVES; m++) {
+            table_ptr[sym * N_MOVES + m] = symmetry_tables.move[sym][m];
+        }
+    }
+    return table;
+}
+
+torch::Tensor transform_actions_batched(torch::Tensor& action_batch, torch::Tensor& symmetry_batch) {
+    TORCH_CHECK(action_batch.dim() == 2 && action_batch.size(1) == (int64_t)N_MOVES, "actions must be (n, N_MOVES)");
+    auto symmetries = checked_symmetries(symmetry_batch, action_batch.size(0));
+    // out[move[m]] = in[m], and since every symmetry is an involution that's out[m] = in[move[m]]
+    auto index = symmetry_move_table().index_select(0, symmetries).to(action_batch.device());
+    return action_batch.gather(1, index);
+}
+
+torch::Tensor transform_moves_batched(torch::Tensor& moves_batch, torch::Tensor& symmetry_batch) {
+    TORCH_CHECK(moves_batch.dim() == 1, "moves must be (n,)");
+    auto n_batch = moves_batch.size(0);
+    auto symmetries = checked_symmetries(symmetry_batch, n_batch);
+    auto symmetries_ptr = symmetries.data_ptr<int64_t>();
+    auto moves = moves_batch.to(torch::kInt64).contiguous();
+    auto moves_ptr = moves.data_ptr<int64_t>();
+    auto tensor = torch::empty({n_batch}, hash_tensor_options);
+    auto tensor_data = tensor.data_ptr<int64_t>();
+    for (int64_t i = 0; i < n_batch; i++) {
+        TORCH_CHECK(moves_ptr[i] >= 0 && moves_ptr[i] < (int64_t)N_MOVES, "moves must be in [0, N_MOVES)");
+        tensor_data[i] = symmetry_tables.move[symmetries_ptr[i]][moves_ptr[i]];
+    }
+    return tensor.to(moves_batch.scalar_type());
+}
+
+// the multiplayer states of a (n_batch, multiplayer_state_size(n_players)) uint8 tensor
+template <int n_players>
+static MultiplayerState_t<n_players>* multiplayer_ptr(torch::Tensor& game_state_batch, int n_batch) {
+    TORCH_CHECK(game_state_batch.scalar_type() == torch::kUInt8, "multiplayer states must be a uint8 tensor");
+    TORCH_CHECK(game_state_batch.is_contiguous(), "multiplayer states must be contiguous");
+    TORCH_CHECK(game_state_batch.dim() == 2 && game_state_batch.size(0) == n_batch &&
+                    game_state_batch.size(1) == (int64_t)sizeof(MultiplayerState_t<n_players>),
+                "multiplayer states must be (n_batch, multiplayer_state_size(n_players))");
+    return reinterpret_cast<MultiplayerState_t<n_players>*>(game_state_batch.data_ptr<uint8_t>());
+}
+
+torch::Tensor initialize_multiplayer_batched(int n_batch, int n_players) {
+    auto tensor = torch::zeros({n_batch, (long long)multiplayer_state_size(n_players)}, compact_tensor_options);
+    with_player_count(n_players, [&](auto count) {
+        auto states = multiplayer_ptr<decltype(count)::value>(tensor, n_batch);
+        parallel_for_batch(n_batch, [&](int64_t i) { initialize_multiplayer(states[i]); });
+    });
+    return tensor;
+}
+
+torch::Tensor get_action_mask_multiplayer_batched(torch::Tensor& game_state_batch, int n_batch, int n_players) {
+    StatsTimer_t timer(KERNEL_GET_ACTION_MASK_MULTIPLAYER_BATCHED, n_batch);
+    auto tensor = torch::empty({n_batch, (long long)N_MOVES}, tensor_options);
+    auto tensor_data = tensor.data_ptr<int>();
+    with_player_count(n_players, [&](auto count) {
+        auto states = multiplayer_ptr<decltype(count)::value>(game_state_batch, n_batch);
+        parallel_for_batch(n_batch, [&](int64_t i) {
+            set_action_mask_multiplayer(states[i], tensor_data + i * N_MOVES);
+        });
+    });
+    return tensor;
+}
+
+void step_multiplayer_batched(torch::Tensor& game_state_batch, torch::Tensor& action_batch, torch::Tensor& reward_batch,
+                              torch::Tensor& done_batch, torch::Tensor& mask_batch, int n_batch, int n_players) {
+    StatsTimer_t timer(KERNEL_STEP_MULTIPLAYER_BATCHED, n_batch);
+    check_step_buffers(reward_batch, done_batch, mask_batch, n_batch);
+    action_batch = action_batch.contiguous();
+    auto action_batch_ptr = action_batch.data_ptr<int>();
+    auto reward_batch_ptr = reward_batch.data_ptr<float>();
+    auto done_batch_ptr = done_batch.data_ptr<bool>();
+    auto mask_batch_ptr = mask_batch.data_ptr<int>();
+    with_player_count(n_players, [&](auto count) {
+        auto states = multiplayer_ptr<decltype(count)::value>(game_state_batch, n_batch);
+        parallel_for_batch(n_batch, [&](int64_t i) {
+            step_state_multiplayer(states[i], action_batch_ptr[i], reward_batch_ptr[i], done_batch_ptr[i],
+                                   mask_batch_ptr + i * N_MOVES);
+        });
+    });
+}
+
+static inline BitboardState_t* bitboard_ptr(torch::Tensor& bitboard_batch) {
+    TORCH_CHECK(bitboard_batch.scalar_type() == torch::kInt64, "bitboard states must be an int64 tensor");
+    TORCH_CHECK(bitboard_batch.size(1) == (long long)BITBOARD_STATE, "bitboard states must have BITBOARD_STATE columns");
+    return reinterpret_cast<BitboardState_t*>(bitboard_batch.data_ptr<int64_t>());
+}
+
+torch::Tensor to_bitboard_batched(torch::Tensor& game_state_batch, int n_batch) {
+    auto tensor = torch::zeros({n_batch, (long long)BITBOARD_STATE}, bitboard_tensor_options);
+    auto bb_ptr = bitboard_ptr(tensor);
+    game_state_batch = game_state_batch.contiguous();
+    for_each_state(game_state_batch, n_batch, [&](int64_t i, auto grid_state) { to_bitboard(grid_state, bb_ptr[i]); });
+    return tensor;
+}
+
+torch::Tensor from_bitboard_batched(torch::Tensor& bitboard_batch, int n_batch) {
+    auto tensor = torch::zeros({n_batch, (long long)TOTAL_STATE}, tensor_options);
+    auto tensor_data = tensor.data_ptr<int>();
+    bitboard_batch = bitboard_batch.contiguous();
+    auto bb_ptr = bitboard_ptr(bitboard_batch);
+    parallel_for_batch(n_batch, [&](int64_t i) {
+        from_bitboard(bb_ptr[i], GameState_t(tensor_data + i * TOTAL_STATE));
+    });
+    return tensor;
+}
+
+torch::Tensor get_action_mask_bitboard_batched(torch::Tensor& bitboard_batch, int n_batch) {
+    auto tensor = torch::zeros({n_batch, (long long)N_MOVES}, tensor_options);
+    auto tensor_data = tensor.data_ptr<int>();
+    bitboard_batch = bitboard_batch.contiguous();
+    auto bb_ptr = bitboard_ptr(bitboard_batch);
+    parallel_for_batch(n_batch, [&](int64_t i) {
+        set_action_mask(bb_ptr[i], tensor_data + i * N_MOVES);
+    });
+    return tensor;
+}
+
+void update_state_bitboard_batched(torch::Tensor& bitboard_batch, torch::Tensor& action_batch, int n_batch) {
+    bitboard_batch = bitboard_batch.contiguous();
+    action_batch = action_batch.contiguous();
+    auto bb_ptr = bitboard_ptr(bitboard_batch);
+    auto action_batch_ptr = action_batch.data_ptr<int>();
+    parallel_for_batch(n_batch, [&](int64_t i) {
+        update_state(bb_ptr[i], action_batch_ptr[i]);
+    });
+}
+
+torch::Tensor get_turn_action_mask_batched(torch::Tensor& game_state_batch, int n_batch) {
+    auto tensor = torch::empty({n_batch, (long long)N_TURN_MOVES}, tensor_options);
+    auto tensor_data = tensor.data_ptr<int>();
+    game_state_batch = game_state_batch.contiguous();
+    for_each_state(game_state_batch, n_batch, [&](int64_t i, auto grid_state) {
+        BitboardState_t bb_state;
+        to_bitboard(grid_state, bb_state);
+        auto dest = tensor_data + i * N_TURN_MOVES;
+        std::fill_n(dest, N_TURN_MOVES, 0);
+        set_turn_action_mask(bb_state, dest);
+    });
+    return tensor;
+}
+
+void update_state_turn_batched(torch::Tensor& game_state_batch, torch::Tensor& turn_move_batch, int n_batch) {
+    game_state_batch = game_state_batch.contiguous();
+    turn_move_batch = turn_move_batch.contiguous();
+    auto turn_move_batch_ptr = turn_move_batch.data_ptr<int>();
+    for_each_state(game_state_batch, n_batch,
+                   [&](int64_t i, auto grid_state) { update_state_turn(grid_state, turn_move_batch_ptr[i]); });
+}
+
+torch::Tensor get_action_mask_simd_batched(torch::Tensor& game_state_batch, int n_batch) {
+    auto tensor = torch::empty({n_batch, (long long)N_MOVES}, tensor_options);
+    auto tensor_data = tensor.data_ptr<int>();
+    game_state_batch = game_state_batch.contiguous();
+    if (game_state_batch.scalar_type() == torch::kUInt8) {
+        TORCH_CHECK(game_state_batch.size(1) == (int64_t)COMPACT_STATE,
+                    "compact game states must have COMPACT_STATE columns");
+        set_action_mask_simd(game_state_batch.data_ptr<uint8_t>(), n_batch, tensor_data);
+    } else {
+        TORCH_CHECK(game_state_batch.scalar_type() == torch::kInt32, "game states must be an int32 or uint8 tensor");
+        TORCH_CHECK(game_state_batch.size(1) == (int64_t)TOTAL_STATE, "game states must have TOTAL_STATE columns");
+        set_action_mask_simd(game_state_batch.data_ptr<int>(), n_batch, tensor_data);
+    }
+    return tensor;
+}
+
+std::vector<torch::Tensor> alphabeta_search_batched(torch::Tensor& game_state_batch, int n_batch,
+                                                    const alphabeta_config_t& config) {
+    TORCH_CHECK(game_state_batch.scalar_type() == torch::kInt32 && game_state_batch.size(1) == (int64_t)TOTAL_STATE,
+                "alpha-beta search takes int32 (n_batch, TOTAL_STATE) game states");
+    game_state_batch = game_state_batch.contiguous();
+    auto best_moves = torch::empty({n_batch}, torch::dtype(torch::kInt32));
+    auto scores = torch::empty({n_batch}, torch::dtype(torch::kInt32));
+    auto depths = torch::empty({n_batch}, torch::dtype(torch::kInt32));
+    auto nodes = torch::empty({n_batch}, torch::dtype(torch::kInt64));
+    auto seconds = torch::empty({n_batch}, torch::dtype(torch::kFloat64));
+
+    // the states are searched one after the other, each with all the threads, sharing one TT
+    AlphaBeta_t engine(config);
+    auto game_state_batch_ptr = game_state_batch.data_ptr<int>();
+    for (int i = 0; i < n_batch; i++) {
+        auto result = engine.search(GameState_t(game_state_batch_ptr + (size_t)i * TOTAL_STATE));
+        best_moves.data_ptr<int>()[i] = result.best_move;
+        scores.data_ptr<int>()[i] = result.score;
+        depths.data_ptr<int>()[i] = result.depth;
+        nodes.data_ptr<int64_t>()[i] = result.nodes;
+        seconds.data_ptr<double>()[i] = result.seconds;
+    }
+    return {best_moves, scores, depths, nodes, seconds};
+}
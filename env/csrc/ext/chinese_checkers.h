@@ -0,0 +1,143 @@
+#pragma once
+#include "alphabeta.h"
+#include "bitboard.h"
+#include "board.h"
+#include "constants.h"
+#include "engine.h"
+#include "episode.h"
+#include "evaluation.h"
+#include "mask_cache.h"
+#include "multiplayer.h"
+#include "observation.h"
+#include "sampling.h"
+#include "symmetry.h"
+#include "turn_moves.h"
+#include <ATen/Parallel.h>
+#include <torch/torch.h>
+#include <optional>
+#include <tuple>
+
+// torch adapters over the engine (see engine.h): every op here validates the tensors and runs the
+// per-state engine function over the batch.
+
+// the batched ops split the batch across torch's intra-op thread pool, which this file installs as the
+// engine's parallel backend. n_threads caps the chunks per batch without resizing torch's pool, so it only
+// affects these ops and cannot go above at::get_num_threads(). n_threads <= 0 keeps the current count,
+// grain_size <= 0 the current grain; both settings are process-wide.
+void set_parallel_config(int n_threads, int64_t grain_size);
+int get_num_threads();
+
+// the batched ops take either layout: int32 (n_batch, TOTAL_STATE) or compact uint8 (n_batch, COMPACT_STATE).
+// fn(i, state) is called with a GameState_t or a CompactGameState_t, so it should be a generic lambda
+template <typename F>
+inline void for_each_state(torch::Tensor& game_state_batch, int n_batch, const F& fn) {
+    if (game_state_batch.scalar_type() == torch::kUInt8) {
+        TORCH_CHECK(game_state_batch.size(1) == (int64_t)COMPACT_STATE,
+                    "compact game states must have COMPACT_STATE columns");
+        auto game_state_batch_ptr = game_state_batch.data_ptr<uint8_t>();
+        parallel_for_batch(n_batch, [&](int64_t i) {
+            fn(i, CompactGameState_t(game_state_batch_ptr + i * COMPACT_STATE));
+        });
+    } else {
+        TORCH_CHECK(game_state_batch.scalar_type() == torch::kInt32, "game states must be an int32 or uint8 tensor");
+        TORCH_CHECK(game_state_batch.size(1) == (int64_t)TOTAL_STATE, "game states must have TOTAL_STATE columns");
+        auto game_state_batch_ptr = game_state_batch.data_ptr<int>();
+        parallel_for_batch(n_batch, [&](int64_t i) {
+            fn(i, GameState_t(game_state_batch_ptr + i * TOTAL_STATE));
+        });
+    }
+}
+
+torch::Tensor initialize_state_batched(int n_batch, bool compact = false);
+
+torch::Tensor to_compact_batched(torch::Tensor& game_state_batch, int n_batch);
+torch::Tensor from_compact_batched(torch::Tensor& game_state_batch, int n_batch);
+
+// the zobrist hash (see zobrist.h) of every state as int64, read straight from the metadata
+torch::Tensor get_state_hash_batched(torch::Tensor& game_state_batch, int n_batch);
+
+torch::Tensor get_action_mask_batched(torch::Tensor& game_state_batch, int n_batch);
+void get_action_mask_batched_out(torch::Tensor& game_state_batch, torch::Tensor& mask_batch, int n_batch);
+
+void update_state_batched(torch::Tensor& game_state_batch, torch::Tensor& moves_batch, int n_batch);
+
+// fused RL step (step_state over the batch) into caller-provided reward, done and mask buffers
+void step_batched(torch::Tensor& game_state_batch, torch::Tensor& moves_batch, torch::Tensor& reward_batch,
+                  torch::Tensor& done_batch, torch::Tensor& mask_batch, int n_batch);
+
+// incremental masks (see mask_cache.h): the caches are a uint8 (n_batch, MASK_CACHE_SIZE) tensor kept next to the
+// states. step_cached_batched has the same contract as step_batched and keeps the caches in sync
+torch::Tensor init_mask_cache_batched(torch::Tensor& game_state_batch, int n_batch);
+void step_cached_batched(torch::Tensor& game_state_batch, torch::Tensor& cache_batch, torch::Tensor& moves_batch,
+                         torch::Tensor& reward_batch, torch::Tensor& done_batch, torch::Tensor& mask_batch, int n_batch);
+
+// network input planes (see observation.h) as float32 or bfloat16 ("float32" / "bfloat16"), shaped
+// (n_batch, N_OBS_CHANNELS, ROWS, COLS) for chw and (n_batch, ROWS, COLS, N_OBS_CHANNELS) for hwc
+torch::Tensor encode_observation_batched(torch::Tensor& game_state_batch, int n_batch, obs_layout_t layout,
+                                         const std::string& dtype);
+// into a caller-provided contiguous float32 or bfloat16 buffer of n_batch x OBS_SIZE values
+void encode_observation_batched_out(torch::Tensor& game_state_batch, torch::Tensor& obs_batch, int n_batch,
+                                    obs_layout_t layout);
+// step_batched that also writes the observations of the next states, in the same pass over the batch
+void step_observe_batched(torch::Tensor& game_state_batch, torch::Tensor& moves_batch, torch::Tensor& reward_batch,
+                          torch::Tensor& done_batch, torch::Tensor& mask_batch, torch::Tensor& obs_batch,
+                          int n_batch, obs_layout_t layout);
+
+// heuristic features (see evaluation.h) as int32 (n_batch, N_EVAL_FEATURES), either layout
+torch::Tensor evaluate_batched(torch::Tensor& game_state_batch, int n_batch);
+// step_batched with the distance-based shaping term of step_state_shaped added to the rewards
+void step_shaped_batched(torch::Tensor& game_state_batch, torch::Tensor& action_batch, torch::Tensor& reward_batch,
+                         torch::Tensor& done_batch, torch::Tensor& mask_batch, int n_batch, double shaping);
+
+// episode limits (see episode.h): the trackers are an int32 (n_batch, EPISODE_TRACKER_SIZE) tensor kept next to the
+// states. max_turns_batch and stall_turns_batch hold one limit per env, or a single one for every env (int, 0
+// disables). terminated is step_batched's done, truncated marks the games cut by the limits. final_state_batch,
+// shaped like the states, gets the last position of every game that ended before it was reset
+torch::Tensor init_episode_tracker_batched(torch::Tensor& game_state_batch, int n_batch);
+void step_limited_batched(torch::Tensor& game_state_batch, torch::Tensor& tracker_batch, torch::Tensor& action_batch,
+                          torch::Tensor& reward_batch, torch::Tensor& terminated_batch, torch::Tensor& truncated_batch,
+                          torch::Tensor& mask_batch, torch::Tensor& max_turns_batch, torch::Tensor& stall_turns_batch,
+                          const std::optional<torch::Tensor>& final_state_batch, int n_batch);
+
+// legal move sampling (see sampling.h): one int32 move per state, drawn with philox keyed by (seed, stream, step)
+// so it doesn't depend on the thread count. the stream is env_ids[row] (int, n_batch), or the row when it's
+// not given; passing stable env ids keeps an env's draws the same whatever row it lands on in a batch. uniform,
+// or softmax over logits_batch (float, n_batch x N_MOVES) on the legal moves; -1 for a state without any. with
+// legal_csr the legal moves also come back in CSR form, int64 row offsets (n_batch + 1) and int32 move ids,
+// otherwise those two are undefined tensors
+std::tuple<torch::Tensor, torch::Tensor, torch::Tensor>
+sample_actions_batched(torch::Tensor& game_state_batch, int64_t seed, int64_t step,
+                       const std::optional<torch::Tensor>& logits_batch, const std::optional<torch::Tensor>& env_ids,
+                       bool legal_csr, int n_batch);
+
+// board symmetries (see symmetry.h), one symmetry_t per row of symmetry_batch (int, n_batch). the states
+// come back in the layout they came in; the actions can be anything indexed by move along dim 1 (masks,
+// policy targets, visit counts) and the moves are move ids. every symmetry is its own inverse
+torch::Tensor transform_state_batched(torch::Tensor& game_state_batch, torch::Tensor& symmetry_batch, int n_batch);
+torch::Tensor transform_actions_batched(torch::Tensor& action_batch, torch::Tensor& symmetry_batch);
+torch::Tensor transform_moves_batched(torch::Tensor& moves_batch, torch::Tensor& symmetry_batch);
+
+// 3, 4 and 6 players (and 2) on the full star, see multiplayer.h. states are uint8 (n_batch,
+// multiplayer_state_size(n_players)) and n_players picks the specialization once per batch. the masks and the
+// step buffers are the 2-player ones
+torch::Tensor initialize_multiplayer_batched(int n_batch, int n_players);
+torch::Tensor get_action_mask_multiplayer_batched(torch::Tensor& game_state_batch, int n_batch, int n_players);
+void step_multiplayer_batched(torch::Tensor& game_state_batch, torch::Tensor& action_batch, torch::Tensor& reward_batch,
+                              torch::Tensor& done_batch, torch::Tensor& mask_batch, int n_batch, int n_players);
+
+torch::Tensor to_bitboard_batched(torch::Tensor& game_state_batch, int n_batch);
+torch::Tensor from_bitboard_batched(torch::Tensor& bitboard_batch, int n_batch);
+torch::Tensor get_action_mask_bitboard_batched(torch::Tensor& bitboard_batch, int n_batch);
+void update_state_bitboard_batched(torch::Tensor& bitboard_batch, torch::Tensor& moves_batch, int n_batch);
+
+// turn-level action space, see turn_moves.h: masks are (n_batch, N_TURN_MOVES) and each action plays a whole turn
+torch::Tensor get_turn_action_mask_batched(torch::Tensor& game_state_batch, int n_batch);
+void update_state_turn_batched(torch::Tensor& game_state_batch, torch::Tensor& turn_move_batch, int n_batch);
+
+// same contract as get_action_mask_batched (either layout), using the kernel from simd_mask.h
+torch::Tensor get_action_mask_simd_batched(torch::Tensor& game_state_batch, int n_batch);
+
+// one alpha-beta search per int32 state (see alphabeta.h), returns best_moves, scores and depths (int32),
+// nodes (int64) and seconds (float64), one entry per state
+std::vector<torch::Tensor> alphabeta_search_batched(torch::Tensor& game_state_batch, int n_batch,
+                                                    const alphabeta_config_t& config);
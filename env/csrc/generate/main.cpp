@@ -1,83 +1,210 @@
+#include <atomic>
+#include <chrono>
 #include <cstdlib>
 #include <cstring>
 #include <ctime>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <string>
-#include <torch/torch.h>
+#include <thread>
+#include <vector>
 #include "../shared/board.h"
-#include "../shared/chinese_checkers.h"
+#include "../shared/engine.h"
+#include "../shared/episode.h"
 #include "../shared/constants.h"
-#include <chrono>
+#include "../shared/game_log.h"
+#include "../shared/mask_cache.h"
+#include "../shared/sampling.h"
+#include "../shared/stats.h"
 
 static void print_usage() {
-    std::cerr << "Usage: ./build/generate run -n <batch_size> -o <log_file>\n";
+    std::cerr << "Usage: ./build/generate run -n <n_games> -o <log_file> [-f binary|text] [-j <n_workers>]\n"
+              << "                            [-s <seed>] [-t <max_turns>] [-k <stall_turns>] [--trace <trace_file>]\n"
+              << "  every worker writes its games to <log_file> with the worker index before the extension,\n"
+              << "  e.g. logs/game.0.cclog. -j defaults to all cores, -t (the turn cap) to 1000\n"
+              << "  -k stops a game after that many turns without either player getting closer to its goal,\n"
+              << "  0 (the default) turns it off\n"
+              << "  --trace writes a chrome trace with one event per game, it needs a CHINESE_CHECKERS_STATS build\n";
     std::exit(1);
 }
 
-int32_t sample_allowed_action(const torch::Tensor& action_mask) {
-    auto ptr = action_mask.data_ptr<int>();
-    int32_t count = 0;
-    for (int i = 0; i < N_MOVES; i++) {
-        if (ptr[i] == 1) count++;
+static std::string shard_path(const std::string& log_file, int worker) {
+    auto slash = log_file.find_last_of('/');
+    auto dot = log_file.find_last_of('.');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) dot = log_file.size();
+    return log_file.substr(0, dot) + "." + std::to_string(worker) + log_file.substr(dot);
+}
+
+struct worker_totals_t {
+    std::atomic<int64_t> games{0};
+    std::atomic<int64_t> moves{0};
+    std::atomic<int64_t> wins{0};
+    std::atomic<int64_t> stalled{0};
+    // games left with no legal move, which the rules shouldn't allow. counted apart so they show up
+    std::atomic<int64_t> stuck{0};
+};
+
+// plays games worker, worker + n_workers, ... so every shard is the same for a given seed and worker count
+static void run_worker(int worker, int n_workers, int n_games, const episode_limits_t& limits, uint64_t seed,
+                       bool binary, const std::string& path, worker_totals_t& totals) {
+    std::unique_ptr<GameLogWriter_t> writer;
+    std::ofstream text_stream;
+    if (binary) {
+        writer = std::make_unique<GameLogWriter_t>(path);
+    } else {
+        text_stream.open(path);
+        if (!text_stream.is_open()) throw std::runtime_error("could not open log file: " + path);
     }
-    int32_t rand_idx = std::rand() % count;
-    count = 0;
-    for (int i = 0; i < N_MOVES; i++) {
-        if (ptr[i] == 1) {
-            if (count == rand_idx) return i;
-            count++;
+
+    std::vector<int> state(TOTAL_STATE);
+    GameState_t game_state(state.data());
+    mask_cache_t mask_cache;
+    episode_tracker_t tracker;
+    int action_mask[N_MOVES];
+    int legal[N_MOVES];
+    int n_legal;
+    int shard_games = 0;
+    for (int g = worker; g < n_games; g += n_workers) {
+        int64_t game_start = stats_enabled ? stats_now_ns() : 0;
+        initialize_state(game_state);
+        init_mask_cache(game_state, mask_cache);
+        init_episode_tracker(game_state, tracker);
+        if (writer)
+            writer->begin_game();
+        else if (shard_games > 0)
+            text_stream << "GAME " << shard_games << "\n";
+
+        int64_t moves = 0;
+        bool truncated = false;
+        bool stuck = false;
+        while (*game_state.winner == 0 && !truncated) {
+            write_action_mask(game_state, mask_cache, action_mask);
+            stats_count_mask(action_mask);
+            // keyed by the game index and the move number, so a game is the same for any worker count
+            int chosen_move = sample_action(action_mask, nullptr, seed, (uint64_t)g, (uint64_t)moves, legal, n_legal);
+            if (chosen_move < 0) {
+                stuck = true;
+                break;
+            }
+            if (writer)
+                writer->write_action(chosen_move);
+            else
+                text_stream << format_move_text(*game_state.current_player, chosen_move) << "\n";
+            int player = *game_state.current_player;
+            update_state_cached(game_state, mask_cache, chosen_move);
+            stats_count_move(chosen_move, *game_state.current_player == player, *game_state.winner);
+            moves++;
+            truncated = *game_state.winner == 0 && track_episode(game_state, tracker, limits, player);
         }
+
+        if (stats_enabled)
+            trace_event("game", game_start, stats_now_ns(), moves);
+        shard_games++;
+        totals.games.fetch_add(1, std::memory_order_relaxed);
+        totals.moves.fetch_add(moves, std::memory_order_relaxed);
+        if (*game_state.winner != 0) totals.wins.fetch_add(1, std::memory_order_relaxed);
+        else if (stuck) totals.stuck.fetch_add(1, std::memory_order_relaxed);
+        else if (*game_state.turn_count < limits.max_turns) totals.stalled.fetch_add(1, std::memory_order_relaxed);
     }
-    return -1;
+    if (writer) writer->close();
+    if (text_stream.is_open()) text_stream.close();
 }
 
 int main(int argc, char* argv[]) {
     // some stupid CLI parsing code
     if (argc < 3) print_usage();
     int n = -1;
+    int n_workers = (int)std::thread::hardware_concurrency();
+    int max_turns = 1000;
+    int stall_turns = 0;
+    uint64_t seed = (uint64_t)std::time(NULL);
     std::string log_file;
+    std::string format = "binary";
+    std::string trace_file;
     for (int i = 1; i < argc; i++) {
         if (std::strcmp(argv[i], "run") == 0) continue;
         else if (std::strcmp(argv[i], "-n") == 0 && i + 1 < argc) n = std::atoi(argv[++i]);
         else if (std::strcmp(argv[i], "-o") == 0 && i + 1 < argc) log_file = argv[++i];
+        else if (std::strcmp(argv[i], "-f") == 0 && i + 1 < argc) format = argv[++i];
+        else if (std::strcmp(argv[i], "-j") == 0 && i + 1 < argc) n_workers = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "-s") == 0 && i + 1 < argc) seed = std::strtoull(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "-t") == 0 && i + 1 < argc) max_turns = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "-k") == 0 && i + 1 < argc) stall_turns = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc) trace_file = argv[++i];
     }
-    if (n <= 0) print_usage();
+    if (n <= 0 || log_file.empty() || max_turns <= 0 || stall_turns < 0) print_usage();
+    if (format != "binary" && format != "text") print_usage();
+    if (!trace_file.empty() && !stats_enabled) {
+        std::cerr << "--trace needs a build with -DCHINESE_CHECKERS_STATS=ON\n";
+        return 1;
+    }
+    set_trace_enabled(!trace_file.empty());
+    n_workers = std::max(1, std::min(n_workers, n));
+    std::cerr << "playing " << n << " games on " << n_workers << " workers, seed " << seed << "\n";
 
-    std::srand((unsigned int)std::time(NULL));
-    std::ofstream file_stream;
-    std::ostream* out_stream = &std::cout;
-    if (!log_file.empty()) {
-        file_stream.open(log_file);
-        if (!file_stream.is_open()) {
-            std::cerr << "Could not open log file: " << log_file << "\n";
-            return 1;
-        }
-        out_stream = &file_stream;
+    worker_totals_t totals;
+    std::vector<std::string> errors(n_workers);
+    std::atomic<bool> failed{false};
+    std::vector<std::thread> workers;
+    auto start = std::chrono::steady_clock::now();
+    for (int w = 0; w < n_workers; w++) {
+        workers.emplace_back([&, w]() {
+            try {
+                run_worker(w, n_workers, n, episode_limits_t{max_turns, stall_turns}, seed, format == "binary",
+                           shard_path(log_file, w), totals);
+            } catch (const std::exception& e) {
+                errors[w] = e.what();
+                failed.store(true);
+            }
+        });
     }
 
-    auto states = initialize_state_batched(1);
-    GameState_t game_state(states[0].data_ptr<int>());
-    auto start = std::chrono::high_resolution_clock::now();
+    auto report = [&](const char* prefix) {
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        int64_t games = totals.games.load(std::memory_order_relaxed);
+        int64_t moves = totals.moves.load(std::memory_order_relaxed);
+        std::cerr << prefix << "games: " << games << "/" << n << ", " << (int64_t)(games / seconds) << " games/s, "
+                  << (int64_t)(moves / seconds) << " moves/s, " << seconds << "s\n";
+    };
+    // progress about once a second, polled so a short run doesn't wait for a full second
+    auto last_report = start;
+    while (totals.games.load(std::memory_order_relaxed) < n && !failed.load()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        if (std::chrono::steady_clock::now() - last_report >= std::chrono::seconds(1)) {
+            last_report = std::chrono::steady_clock::now();
+            report("");
+        }
+    }
+    for (auto& worker : workers) worker.join();
 
-    while (*game_state.turn_count < n) {
-        auto action_mask = get_action_mask_batched(states, 1);
-        int chosen_move = sample_allowed_action(action_mask[0]);
-        int current_player = *game_state.current_player;
-        if (chosen_move == N_MOVES - 1)
-            *out_stream << "PLAYER " << current_player << " MOVE: END TURN\n";
-        else {
-            int piece_num = chosen_move / N_DIRECTIONS;
-            int direction = chosen_move % N_DIRECTIONS;
-            *out_stream << "PLAYER " << current_player << " MOVE: " << piece_num << " " << direction << "\n";
+    for (const auto& error : errors) {
+        if (!error.empty()) {
+            std::cerr << error << "\n";
+            return 1;
         }
-        update_state(game_state, chosen_move);
-        if ((*game_state.turn_count + 1) % 100000 == 0) {
-            auto end = std::chrono::high_resolution_clock::now();
-            auto duration = std::chrono::duration_cast<std::chrono::seconds>(end - start);
-            std::cerr << "Turn: " << *game_state.turn_count + 1 << " = " << duration.count() << "s\n";
+    }
+    report("done, ");
+    int64_t wins = totals.wins.load(), stalled = totals.stalled.load(), stuck = totals.stuck.load();
+    std::cerr << wins << " won, " << n - wins - stalled - stuck << " stopped at the " << max_turns << " turn cap";
+    if (stall_turns > 0) std::cerr << ", " << stalled << " stalled for " << stall_turns << " turns";
+    if (stuck > 0) std::cerr << ", " << stuck << " left without a legal move";
+    std::cerr << "\n";
+    if (stats_enabled) {
+        auto stats = get_stats();
+        uint64_t masks = 0, legal = 0;
+        for (size_t k = 0; k <= N_MOVES; k++) {
+            masks += stats.legal_moves[k];
+            legal += k * stats.legal_moves[k];
         }
+        std::cerr << "stats: " << (double)legal / std::max<uint64_t>(masks, 1) << " legal moves per mask, "
+                  << stats.hop_jumps << " jumps in " << stats.hop_chains << " hop chains ("
+                  << (double)stats.hop_jumps / std::max<uint64_t>(stats.hop_chains, 1) << " per chain), wins "
+                  << stats.wins[0] << "/" << stats.wins[1] << "\n";
+    }
+    if (!trace_file.empty()) {
+        write_trace(trace_file);
+        std::cerr << "trace written to " << trace_file << "\n";
     }
-    if (file_stream.is_open()) file_stream.close();
     return 0;
 }
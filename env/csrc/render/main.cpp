@@ -1,13 +1,17 @@
 #include "../shared/board.h"
-#include "../shared/chinese_checkers.h"
+#include "../shared/engine.h"
 #include "../shared/constants.h"
+#include "../shared/game_log.h"
+#include "../shared/replay.h"
 #include "raylib.h"
+#include <algorithm>
 #include <cmath>
 #include <cstdlib>
 #include <cstring>
 #include <ctime>
+#include <fstream>
 #include <iostream>
-#include <sstream>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -15,53 +19,14 @@ static Color forest_green = {34, 139, 34, 255};
 static Color deep_sea_blue = {0, 105, 148, 255};
 static Color move_arrow_color = {255, 69, 0, 200}; // Orange-red with some transparency
 
+// the scrubber along the bottom of the window
+static const int scrubber_height = 40;
+static const int scrubber_margin = 20;
+
 static const int window_width =
     static_cast<int>(2 * MARGIN_X + (COLS - 1) * (sqrtf(3.0f) * HEX_RADIUS) + 0.5f * (sqrtf(3.0f) * HEX_RADIUS));
-static const int window_height = static_cast<int>(2 * MARGIN_Y + (ROWS - 1) * (1.5f * HEX_RADIUS));
-
-struct parsed_move_t {
-    int player;
-    bool end_turn;
-    int piece_index;
-    int direction;
-    point_t from_pos;
-    point_t to_pos;
-};
-
-static bool parse_move_line(const std::string& line, parsed_move_t& out_move) {
-    std::istringstream iss(line);
-    std::vector<std::string> tokens;
-    std::string t;
-    while (iss >> t) {
-        tokens.push_back(t);
-    }
-    if (tokens.size() < 4)
-        return false;
-    if (tokens[0] != "PLAYER" || tokens[2] != "MOVE:")
-        return false;
-    out_move.player = std::stoi(tokens[1]);
-
-    // Check for "END TURN" format (tokens[3] == "END" && tokens[4] == "TURN")
-    if (tokens[3] == "END" && tokens.size() >= 5 && tokens[4] == "TURN") {
-        out_move.end_turn = true;
-        out_move.piece_index = -1;
-        out_move.direction = -1;
-        // For END moves, we don't have from/to positions
-        out_move.from_pos = {-1, -1};
-        out_move.to_pos = {-1, -1};
-        return true;
-    }
-
-    if (tokens.size() < 5)
-        return false;
-    out_move.end_turn = false;
-    out_move.piece_index = std::stoi(tokens[3]);
-    out_move.direction = std::stoi(tokens[4]);
-    // We'll set the positions later when processing the moves
-    out_move.from_pos = {-1, -1};
-    out_move.to_pos = {-1, -1};
-    return true;
-}
+static const int board_height = static_cast<int>(2 * MARGIN_Y + (ROWS - 1) * (1.5f * HEX_RADIUS));
+static const int window_height = board_height + scrubber_height;
 
 static Vector2 get_center(int row, int col) {
     float offset_x = (row % 2 == 1) ? (sqrtf(3.0f) * HEX_RADIUS * 0.5f) : 0.0f;
@@ -70,8 +35,8 @@ static Vector2 get_center(int row, int col) {
     return {center_x, center_y};
 }
 
-static void render_grid(GameState_t& game_state, bool show_grid_indices = false,
-                        const parsed_move_t* last_move = nullptr) {
+static void render_grid(GameState_t game_state, bool show_grid_indices = false,
+                        const replay_move_t* last_move = nullptr) {
     int* grid = game_state.grid;
 
     for (int r = 0; r < ROWS; r++) {
@@ -94,9 +59,9 @@ static void render_grid(GameState_t& game_state, bool show_grid_indices = false,
         }
     }
 
-    if (last_move && last_move->from_pos.first != -1 && last_move->to_pos.first != -1) {
-        auto start = get_center(last_move->from_pos.first, last_move->from_pos.second);
-        auto end = get_center(last_move->to_pos.first, last_move->to_pos.second);
+    if (last_move && last_move->from != OFF_BOARD) {
+        auto start = get_center(last_move->from / COLS, last_move->from % COLS);
+        auto end = get_center(last_move->to / COLS, last_move->to % COLS);
         DrawLineEx(start, end, 3.0f, move_arrow_color);
     }
 
@@ -115,148 +80,178 @@ static void render_grid(GameState_t& game_state, bool show_grid_indices = false,
     }
 }
 
+// seconds until the move after `last`: a hop chain plays faster than the turns around it
+static float move_delay(const replay_move_t* last) {
+    static const float regular_move_time = 1.0f;
+    static const float skip_move_time = 0.5f;
+    if (!last || last->from == OFF_BOARD)
+        return regular_move_time;
+    int direction = last->action % N_DIRECTIONS;
+    bool jumped = step_targets[last->from][direction] != last->to;
+    return jumped ? skip_move_time : regular_move_time;
+}
+
+static Rectangle scrubber_rect() {
+    return {(float)scrubber_margin, (float)(board_height + scrubber_height / 4),
+            (float)(window_width - 2 * scrubber_margin), (float)(scrubber_height / 2)};
+}
+
+// the known part of the game is the whole bar until the end of the log has been read
+static void render_scrubber(uint64_t current, uint64_t n_known, bool finished) {
+    auto bar = scrubber_rect();
+    DrawRectangleRec(bar, LIGHTGRAY);
+    float fraction = n_known > 0 ? (float)current / (float)n_known : 0.0f;
+    DrawRectangleRec({bar.x, bar.y, bar.width * fraction, bar.height}, move_arrow_color);
+    DrawRectangleLinesEx(bar, 1.0f, DARKGRAY);
+    auto text = TextFormat("%llu / %llu%s", (unsigned long long)current, (unsigned long long)n_known,
+                           finished ? "" : "+");
+    DrawText(text, bar.x + 6, bar.y + 3, 14, BLACK);
+}
+
+static void print_controls() {
+    std::cerr << "controls: SPACE play/pause, LEFT/RIGHT step one move, PAGE UP/DOWN jump 100 moves, "
+                 "HOME/END first/last move, UP/DOWN playback speed, click or drag the bar to seek\n";
+}
+
 int main(int argc, char** argv) {
     bool show_grid_indices = false;
+    std::string input_file;
+    uint64_t game_index = 0;
+    float speed = 1.0f;
 
     // Parse command line arguments
     for (int i = 1; i < argc; i++) {
         if (std::string(argv[i]) == "--show-grid-indices" || std::string(argv[i]) == "-g") {
             show_grid_indices = true;
+        } else if ((std::string(argv[i]) == "--input" || std::string(argv[i]) == "-i") && i + 1 < argc) {
+            input_file = argv[++i];
+        } else if (std::string(argv[i]) == "--game" && i + 1 < argc) {
+            game_index = std::stoull(argv[++i]);
+        } else if (std::string(argv[i]) == "--speed" && i + 1 < argc) {
+            speed = std::stof(argv[++i]);
         }
     }
 
-    std::vector<parsed_move_t> raw_move_list;
-    std::string line;
-    while (std::getline(std::cin, line)) {
-        if (line.empty())
-            continue;
-        parsed_move_t parsed;
-        if (parse_move_line(line, parsed))
-            raw_move_list.push_back(parsed);
-        else
-            std::cerr << "ignoring invalid line: " << line << "\n";
-    }
-
-    // Process the raw moves to group submoves and set from/to positions
-    std::vector<parsed_move_t> move_list;
-
-    auto states_tensor = initialize_state_batched(1);
-    GameState_t game_state(states_tensor[0].data_ptr<int>());
-
-    for (size_t i = 0; i < raw_move_list.size(); i++) {
-        auto move = raw_move_list[i];
-
-        // Handle END_TURN moves properly
-        if (move.end_turn) {
-            // Add the END_TURN move explicitly to the move list
-            // so the update_state will properly handle the player change
-            move_list.push_back(move);
-
-            // Update the game state with the END_TURN move
-            update_state(game_state, N_MOVES - 1);
-            continue;
+    // a binary log (-i) is memory-mapped and replayed in place. a text log (-i or stdin) is parsed as the replay
+    // gets to it, so neither has to be read in full before the window opens
+    std::unique_ptr<GameLogReader_t> reader;
+    std::ifstream file_stream;
+    std::unique_ptr<replay_source_t> source;
+    if (!input_file.empty() && is_game_log(input_file)) {
+        try {
+            reader = std::make_unique<GameLogReader_t>(input_file);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << "\n";
+            return 1;
         }
-
-        // Get the current piece position before the move
-        auto player = move.player;
-        auto piece_num = move.piece_index;
-        auto piece = (player == 1) ? game_state.player_1_pieces[piece_num] : game_state.player_2_pieces[piece_num];
-
-        // Store original position
-        move.from_pos = piece;
-
-        // Calculate destination based on move direction
-        auto neighbors = get_neighbors(piece, true);
-        auto one_step = neighbors[move.direction];
-
-        // Determine if it's a one-step or a skip move
-        if (!game_state.occupied(one_step)) {
-            // One-step move
-            move.to_pos = one_step;
-        } else {
-            // Skip move
-            auto offset = double_step_neighbors[move.direction];
-            point_t two_step = {piece.first + offset[0], piece.second + offset[1]};
-            move.to_pos = two_step;
+        if (game_index >= reader->n_games()) {
+            std::cerr << "game " << game_index << " not in the log, it has " << reader->n_games() << " games\n";
+            return 1;
         }
-
-        // Add to processed move list
-        move_list.push_back(move);
-
-        // Update the game state to reflect this move
-        int move_idx = -1;
-        if (move.end_turn) {
-            move_idx = N_MOVES - 1;
-        } else {
-            move_idx = move.piece_index * N_DIRECTIONS + move.direction;
+        source = std::make_unique<ArrayReplaySource_t>(reader->actions() + reader->game_begin(game_index),
+                                                       reader->game_end(game_index) - reader->game_begin(game_index));
+    } else {
+        std::istream* in_stream = &std::cin;
+        if (!input_file.empty()) {
+            file_stream.open(input_file);
+            if (!file_stream.is_open()) {
+                std::cerr << "Could not open log file: " << input_file << "\n";
+                return 1;
+            }
+            in_stream = &file_stream;
+        }
+        auto text_source = std::make_unique<TextReplaySource_t>(*in_stream, game_index);
+        if (!text_source->found_game()) {
+            std::cerr << "game " << game_index << " not in the log\n";
+            return 1;
         }
-        update_state(game_state, move_idx);
+        source = std::move(text_source);
     }
-
-    // Reset the game state for the actual rendering
-    states_tensor = initialize_state_batched(1);
-    game_state = GameState_t(states_tensor[0].data_ptr<int>());
+    Replay_t replay(*source);
+    print_controls();
 
     SetConfigFlags(FLAG_VSYNC_HINT | FLAG_WINDOW_HIGHDPI | FLAG_MSAA_4X_HINT);
     InitWindow(window_width, window_height, "chinese checkers replay");
     SetTargetFPS(60);
 
+    // moves read past the shown one per frame, so the scrubber learns the game's length without stalling a frame
+    const uint64_t read_ahead_per_frame = 4096;
+    // past this many moves in one frame playback jumps instead of stepping through every one of them
+    const int max_steps_per_frame = 256;
     float elapsed_time = 0.0f;
-    int current_move = 0;
-    int n_moves = move_list.size();
-    bool done = false;
-    parsed_move_t* last_move = nullptr;
-
-    // Different timing for different types of moves
-    float regular_move_time = 1.0f; // Regular moves
-    float skip_move_time = 0.5f;    // Faster for multi-hop submoves
-    float end_turn_time = 0.3f;     // Even faster for END TURN moves
-    float time_between_updates = regular_move_time;
+    bool playing = true;
+    bool reported_error = false;
+
+    while (!WindowShouldClose()) {
+        if (!replay.finished())
+            replay.read_ahead(read_ahead_per_frame);
+        if (!replay.error().empty() && !reported_error) {
+            std::cerr << "stopping at " << replay.error() << "\n";
+            reported_error = true;
+        }
 
-    while (!WindowShouldClose() && !done) {
-        float delta_time = GetFrameTime();
-        elapsed_time += delta_time;
-        if (elapsed_time >= time_between_updates && current_move < n_moves) {
-            auto move = move_list[current_move];
-            int move_idx = -1;
-            if (move.end_turn) {
-                move_idx = N_MOVES - 1;
-                // Set timing for the next move (after END TURN)
-                time_between_updates = regular_move_time;
-            } else {
-                move_idx = move.piece_index * N_DIRECTIONS + move.direction;
+        uint64_t current = replay.current();
+        if (IsKeyPressed(KEY_SPACE))
+            playing = !playing;
+        if (IsKeyPressed(KEY_UP))
+            speed = std::min(speed * 2.0f, 1024.0f);
+        if (IsKeyPressed(KEY_DOWN))
+            speed = std::max(speed * 0.5f, 0.125f);
+        if (IsKeyPressed(KEY_RIGHT) || IsKeyPressedRepeat(KEY_RIGHT)) {
+            playing = false;
+            replay.step();
+        }
+        if ((IsKeyPressed(KEY_LEFT) || IsKeyPressedRepeat(KEY_LEFT)) && current > 0) {
+            playing = false;
+            replay.seek(current - 1);
+        }
+        if (IsKeyPressed(KEY_PAGE_DOWN))
+            replay.seek(current + 100);
+        if (IsKeyPressed(KEY_PAGE_UP))
+            replay.seek(current > 100 ? current - 100 : 0);
+        if (IsKeyPressed(KEY_HOME))
+            replay.seek(0);
+        if (IsKeyPressed(KEY_END))
+            replay.seek(replay.n_known());
+
+        auto bar = scrubber_rect();
+        auto mouse = GetMousePosition();
+        bool on_bar = mouse.y >= board_height && mouse.x >= bar.x && mouse.x <= bar.x + bar.width;
+        if (IsMouseButtonDown(MOUSE_BUTTON_LEFT) && on_bar) {
+            float fraction = (mouse.x - bar.x) / bar.width;
+            replay.seek((uint64_t)(fraction * replay.n_known() + 0.5f));
+            elapsed_time = 0.0f;
+        }
 
-                // Determine if this is part of a skip sequence
-                bool is_skip = false;
-                if (current_move < n_moves - 1) {
-                    // Look ahead to see if next move is by same player (skip sequence)
-                    if (move_list[current_move + 1].player == move.player && !move_list[current_move + 1].end_turn) {
-                        is_skip = true;
-                        // Set faster timing for the next move in this skip sequence
-                        time_between_updates = skip_move_time;
-                    } else if (move_list[current_move + 1].end_turn) {
-                        // Next is END TURN, set faster timing
-                        time_between_updates = end_turn_time;
-                    } else {
-                        // Regular move follows
-                        time_between_updates = regular_move_time;
-                    }
+        if (playing) {
+            // frame skipping: every move that came due this frame is applied, only the last one is drawn
+            elapsed_time += GetFrameTime() * speed;
+            int steps = 0;
+            while (elapsed_time >= move_delay(replay.last_move()) && steps < max_steps_per_frame) {
+                elapsed_time -= move_delay(replay.last_move());
+                if (!replay.step()) {
+                    elapsed_time = 0.0f;
+                    break;
                 }
+                steps++;
+            }
+            if (steps == max_steps_per_frame) {
+                // far behind at a high speed: skip ahead by the average delay rather than step through
+                replay.seek(replay.current() + (uint64_t)(elapsed_time / move_delay(nullptr)));
+                elapsed_time = 0.0f;
             }
-            update_state(game_state, move_idx);
-            last_move = &move_list[current_move];
-            current_move++;
-            elapsed_time = 0.0f;
         }
-        if (current_move >= n_moves)
-            done = true;
+        bool at_end = replay.finished() && replay.current() == replay.n_known();
 
         BeginDrawing();
         ClearBackground(RAYWHITE);
-        render_grid(game_state, show_grid_indices, last_move);
+        GameState_t game_state = replay.state();
+        render_grid(game_state, show_grid_indices, replay.last_move());
         DrawText(TextFormat("Move %d", *game_state.turn_count), 20, 20, 20, DARKGRAY);
-        if (done)
-            DrawText("DONE. Press ESC to close.", 20, 50, 20, DARKGRAY);
+        DrawText(TextFormat("%s  x%g", playing ? "playing" : "paused", speed), 20, 45, 16, DARKGRAY);
+        if (at_end)
+            DrawText("DONE. Press ESC to close.", 20, 70, 20, DARKGRAY);
+        render_scrubber(replay.current(), replay.n_known(), replay.finished());
         EndDrawing();
     }
     CloseWindow();
@@ -0,0 +1,272 @@
+#include "alphabeta.h"
+#include "board.h"
+#include "constants.h"
+#include "engine.h"
+#include "undo.h"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+static const int INF_SCORE = 1000000;
+static const int MAX_PLY = 64;
+
+enum tt_flag_t { TT_EXACT = 0, TT_LOWER = 1, TT_UPPER = 2 };
+
+static inline uint64_t tt_pack(int score, int depth, int flag, int move) {
+    return (uint64_t)(uint32_t)score | ((uint64_t)depth << 32) | ((uint64_t)flag << 40) | ((uint64_t)(move + 1) << 48);
+}
+
+static inline int tt_score(uint64_t data) {
+    return (int32_t)(uint32_t)data;
+}
+
+static inline int tt_depth(uint64_t data) {
+    return (data >> 32) & 0xff;
+}
+
+static inline int tt_flag(uint64_t data) {
+    return (data >> 40) & 0x3;
+}
+
+static inline int tt_move(uint64_t data) {
+    return (int)((data >> 48) & 0xff) - 1;
+}
+
+// win scores are stored relative to the node so they stay valid when the position is reached at another ply
+static inline int score_to_tt(int score, int ply) {
+    return (score > WIN_SCORE - MAX_PLY) ? score + ply : (score < -WIN_SCORE + MAX_PLY) ? score - ply : score;
+}
+
+static inline int score_from_tt(int score, int ply) {
+    return (score > WIN_SCORE - MAX_PLY) ? score - ply : (score < -WIN_SCORE + MAX_PLY) ? score + ply : score;
+}
+
+int evaluate_position(GameState_t game_state) {
+    // player 1 advances down the rows, player 2 up
+    int advance = 0;
+    for (size_t i = 0; i < N_PIECES_PER_PLAYER; i++) {
+        advance += game_state.player_1_pieces[i].first;
+        advance += game_state.player_2_pieces[i].first - (int)(ROWS - 1);
+    }
+    return (*game_state.current_player == 1) ? advance : -advance;
+}
+
+AlphaBeta_t::AlphaBeta_t(const alphabeta_config_t& config)
+    : config(config), tt((size_t)1 << config.tt_size_log2), tt_mask(((uint64_t)1 << config.tt_size_log2) - 1),
+      stop(false) {
+    clear();
+}
+
+void AlphaBeta_t::clear() {
+    for (auto& entry : tt) {
+        entry.key_xor_data.store(0, std::memory_order_relaxed);
+        entry.data.store(0, std::memory_order_relaxed);
+    }
+}
+
+bool AlphaBeta_t::tt_probe(uint64_t hash, uint64_t& data) const {
+    const auto& entry = tt[hash & tt_mask];
+    data = entry.data.load(std::memory_order_relaxed);
+    return (entry.key_xor_data.load(std::memory_order_relaxed) ^ data) == hash && data != 0;
+}
+
+void AlphaBeta_t::tt_store(uint64_t hash, uint64_t data) {
+    auto& entry = tt[hash & tt_mask];
+    entry.key_xor_data.store(hash ^ data, std::memory_order_relaxed);
+    entry.data.store(data, std::memory_order_relaxed);
+}
+
+// per-thread search state, the TT is the only thing the threads share
+struct alphabeta_thread_t {
+    AlphaBeta_t& engine;
+    std::chrono::steady_clock::time_point deadline;
+    bool has_deadline;
+    // the main thread ignores the stop flag until it has completed an iteration, helpers always honor it
+    bool can_stop;
+    int64_t nodes = 0;
+    int root_best_move = -1;
+    int killers[MAX_PLY][2];
+    int history[N_PLAYERS][N_MOVES];
+    // the search walks the tree in this one state with make/unmake, every node leaves it as it found it
+    std::vector<int> state;
+    UndoStack_t undo;
+
+    alphabeta_thread_t(AlphaBeta_t& engine) : engine(engine), state(TOTAL_STATE), undo(MAX_PLY) {
+        std::fill(&killers[0][0], &killers[0][0] + MAX_PLY * 2, -1);
+        std::fill(&history[0][0], &history[0][0] + N_PLAYERS * N_MOVES, 0);
+    }
+
+    bool out_of_time() {
+        if ((++nodes & 1023) == 0 && can_stop && has_deadline && std::chrono::steady_clock::now() > deadline) {
+            engine.stop.store(true, std::memory_order_relaxed);
+        }
+        return can_stop && engine.stop.load(std::memory_order_relaxed);
+    }
+
+    int order_moves(GameState_t game_state, int ply, int tt_best, int* moves) {
+        int mask[N_MOVES] = {0};
+        set_action_mask(game_state, mask);
+        int player = *game_state.current_player;
+        int scores[N_MOVES];
+        int n_moves = 0;
+        for (int m = 0; m < (int)N_MOVES; m++) {
+            if (!mask[m]) {
+                continue;
+            }
+            int score = history[player - 1][m];
+            if (m == tt_best) {
+                score = INF_SCORE;
+            } else if (m == killers[ply][0] || m == killers[ply][1]) {
+                score = INF_SCORE / 2;
+            }
+            moves[n_moves] = m;
+            scores[n_moves] = score;
+            n_moves++;
+        }
+        // insertion sort, there are at most N_MOVES and usually far fewer
+        for (int i = 1; i < n_moves; i++) {
+            int move = moves[i];
+            int score = scores[i];
+            int j = i - 1;
+            for (; j >= 0 && scores[j] < score; j--) {
+                moves[j + 1] = moves[j];
+                scores[j + 1] = scores[j];
+            }
+            moves[j + 1] = move;
+            scores[j + 1] = score;
+        }
+        return n_moves;
+    }
+
+    int pvs(int ply, int depth, int alpha, int beta) {
+        GameState_t game_state(state.data());
+        if (out_of_time()) {
+            return 0;
+        }
+        if (*game_state.winner != 0) {
+            return (*game_state.winner == *game_state.current_player) ? WIN_SCORE - ply : -(WIN_SCORE - ply);
+        }
+        if (depth <= 0 || ply >= MAX_PLY - 1) {
+            return evaluate_position(game_state);
+        }
+
+        uint64_t hash = *game_state.hash;
+        uint64_t data;
+        int tt_best = -1;
+        if (engine.tt_probe(hash, data)) {
+            tt_best = tt_move(data);
+            if (ply > 0 && tt_depth(data) >= depth) {
+                int score = score_from_tt(tt_score(data), ply);
+                int flag = tt_flag(data);
+                if (flag == TT_EXACT || (flag == TT_LOWER && score >= beta) || (flag == TT_UPPER && score <= alpha)) {
+                    return score;
+                }
+            }
+        }
+
+        int moves[N_MOVES];
+        int n_moves = order_moves(game_state, ply, tt_best, moves);
+        if (n_moves == 0) {
+            return evaluate_position(game_state);
+        }
+
+        int player = *game_state.current_player;
+        int original_alpha = alpha;
+        int best_score = -INF_SCORE;
+        int best_move = moves[0];
+        for (int k = 0; k < n_moves; k++) {
+            undo.make(game_state, moves[k]);
+            // a jump keeps the turn, so the child is scored from the same side and isn't negated
+            bool same_side = *game_state.current_player == player;
+            auto search_child = [&](int a, int b) {
+                return same_side ? pvs(ply + 1, depth - 1, a, b) : -pvs(ply + 1, depth - 1, -b, -a);
+            };
+
+            int score;
+            if (k == 0) {
+                score = search_child(alpha, beta);
+            } else {
+                score = search_child(alpha, alpha + 1);
+                if (score > alpha && score < beta) {
+                    score = search_child(alpha, beta);
+                }
+            }
+            undo.unmake(game_state);
+            if (can_stop && engine.stop.load(std::memory_order_relaxed)) {
+                return 0;
+            }
+
+            if (score > best_score) {
+                best_score = score;
+                best_move = moves[k];
+                if (ply == 0) {
+                    root_best_move = best_move;
+                }
+            }
+            alpha = std::max(alpha, score);
+            if (alpha >= beta) {
+                if (moves[k] != killers[ply][0]) {
+                    killers[ply][1] = killers[ply][0];
+                    killers[ply][0] = moves[k];
+                }
+                history[player - 1][moves[k]] += depth * depth;
+                break;
+            }
+        }
+
+        int flag = (best_score <= original_alpha) ? TT_UPPER : (best_score >= beta) ? TT_LOWER : TT_EXACT;
+        engine.tt_store(hash, tt_pack(score_to_tt(best_score, ply), depth, flag, best_move));
+        return best_score;
+    }
+};
+
+alphabeta_result_t AlphaBeta_t::search(GameState_t root) {
+    auto start = std::chrono::steady_clock::now();
+    stop.store(false);
+    int n_threads = std::max(config.n_threads, 1);
+    std::vector<alphabeta_thread_t> threads;
+    threads.reserve(n_threads);
+    for (int t = 0; t < n_threads; t++) {
+        threads.emplace_back(*this);
+        auto& thread = threads.back();
+        std::copy_n(root.grid, TOTAL_STATE, thread.state.data());
+        thread.can_stop = t > 0;
+        thread.has_deadline = config.time_limit_ms > 0;
+        thread.deadline = start + std::chrono::milliseconds(config.time_limit_ms);
+    }
+
+    alphabeta_result_t result = {-1, 0, 0, 0, 0.0};
+    // helpers search the same root, odd ones one ply deeper so they fill the TT ahead of the main thread
+    auto iterate = [&](int t) {
+        auto& thread = threads[t];
+        for (int depth = 1; depth <= config.max_depth; depth++) {
+            int helper_depth = std::min(depth + (t & 1), config.max_depth);
+            int score = thread.pvs(0, (t == 0) ? depth : helper_depth, -INF_SCORE, INF_SCORE);
+            if (thread.can_stop && stop.load()) {
+                break;
+            }
+            thread.can_stop = true;
+            if (t == 0) {
+                result.best_move = thread.root_best_move;
+                result.score = score;
+                result.depth = depth;
+            }
+        }
+    };
+
+    std::vector<std::thread> helpers;
+    for (int t = 1; t < n_threads; t++) {
+        helpers.emplace_back(iterate, t);
+    }
+    iterate(0);
+    stop.store(true);
+    for (auto& helper : helpers) {
+        helper.join();
+    }
+
+    for (auto& thread : threads) {
+        result.nodes += thread.nodes;
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include "board.h"
+#include "constants.h"
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// classical baseline opponent: iterative deepening PVS over the sub-move action space (N_MOVES), so a
+// multi-jump turn takes one ply per jump plus END TURN and the side to move only flips when the turn ends.
+// move ordering is TT move, then killers, then history. several threads search the same root with a
+// shared lock-free transposition table (Lazy SMP) and the main thread's result is used.
+struct alphabeta_config_t {
+    int max_depth = 6;
+    // 0 means no time limit. the first iteration always completes so there is always a move
+    int time_limit_ms = 0;
+    int n_threads = 1;
+    // 2^tt_size_log2 entries of 16 bytes
+    int tt_size_log2 = 20;
+};
+
+struct alphabeta_result_t {
+    int best_move;
+    // for the side to move, WIN_SCORE - plies for a forced win
+    int score;
+    // last fully searched depth
+    int depth;
+    // over all threads
+    int64_t nodes;
+    double seconds;
+};
+
+static const int WIN_SCORE = 100000;
+
+// static evaluation for the player to move: how far its pieces have advanced toward the goal triangle
+// minus how far the opponent's have
+int evaluate_position(GameState_t game_state);
+
+class AlphaBeta_t {
+public:
+    explicit AlphaBeta_t(const alphabeta_config_t& config);
+
+    alphabeta_result_t search(GameState_t root);
+    void clear();
+
+    const alphabeta_config_t config;
+
+private:
+    friend struct alphabeta_thread_t;
+
+    // lock-free entries: key_xor_data = hash ^ data, so a torn write just looks like a miss
+    struct tt_entry_t {
+        std::atomic<uint64_t> key_xor_data;
+        std::atomic<uint64_t> data;
+    };
+
+    bool tt_probe(uint64_t hash, uint64_t& data) const;
+    void tt_store(uint64_t hash, uint64_t data);
+
+    std::vector<tt_entry_t> tt;
+    uint64_t tt_mask;
+    std::atomic<bool> stop;
+};
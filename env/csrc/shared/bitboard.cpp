@@ -0,0 +1,159 @@
+#include "bitboard.h"
+#include "board.h"
+#include "constants.h"
+#include "engine.h"
+#include <cassert>
+
+template <typename State>
+static void to_bitboard_impl(State game_state, BitboardState_t& bb_state) {
+    for (size_t p = 0; p < N_PLAYERS; p++) {
+        bb_state.pieces[p] = 0;
+        for (size_t i = 0; i < N_PIECES_PER_PLAYER; i++) {
+            auto b = bitboard_tables.cell_to_bit[game_state.piece_cell(p + 1, i)];
+            assert(b != -1);
+            bb_state.piece_bits[p][i] = b;
+            bb_state.pieces[p] |= bit_at(b);
+        }
+    }
+    bb_state.current_player = *game_state.current_player;
+    bb_state.last_skipped_piece = *game_state.last_skipped_piece;
+    bb_state.last_direction = *game_state.last_direction;
+    bb_state.winner = *game_state.winner;
+    bb_state.turn_count = *game_state.turn_count;
+}
+
+void to_bitboard(GameState_t game_state, BitboardState_t& bb_state) {
+    to_bitboard_impl(game_state, bb_state);
+}
+
+void to_bitboard(CompactGameState_t game_state, BitboardState_t& bb_state) {
+    to_bitboard_impl(game_state, bb_state);
+}
+
+void from_bitboard(const BitboardState_t& bb_state, GameState_t game_state) {
+    for (size_t idx = 0; idx < NUM_CELLS; idx++) {
+        game_state.grid[idx] = (bitboard_tables.cell_to_bit[idx] == -1) ? INVALID : EMPTY;
+    }
+    point_t* pieces[N_PLAYERS] = {game_state.player_1_pieces, game_state.player_2_pieces};
+    for (size_t p = 0; p < N_PLAYERS; p++) {
+        for (size_t i = 0; i < N_PIECES_PER_PLAYER; i++) {
+            auto idx = bitboard_tables.bit_to_cell[bb_state.piece_bits[p][i]];
+            game_state.grid[idx] = p + 1;
+            pieces[p][i] = {idx / COLS, idx % COLS};
+        }
+    }
+    *game_state.current_player = bb_state.current_player;
+    *game_state.last_skipped_piece = bb_state.last_skipped_piece;
+    *game_state.last_direction = bb_state.last_direction;
+    *game_state.winner = bb_state.winner;
+    *game_state.turn_count = bb_state.turn_count;
+    *game_state.hash = compute_hash(game_state);
+}
+
+void initialize_state(BitboardState_t& bb_state) {
+    const std::array<std::array<int, 2>, 10>* starts[N_PLAYERS] = {&player_1_start, &player_2_start};
+    for (size_t p = 0; p < N_PLAYERS; p++) {
+        bb_state.pieces[p] = 0;
+        for (size_t i = 0; i < N_PIECES_PER_PLAYER; i++) {
+            auto start = (*starts[p])[i];
+            auto b = bitboard_tables.cell_to_bit[start[0] * COLS + start[1]];
+            bb_state.piece_bits[p][i] = b;
+            bb_state.pieces[p] |= bit_at(b);
+        }
+    }
+    bb_state.current_player = 1;
+    bb_state.last_skipped_piece = -1;
+    bb_state.last_direction = -1;
+    bb_state.winner = 0;
+    bb_state.turn_count = 0;
+}
+
+// legal moves for every movable piece in direction D, split into single steps and jumps
+template <int D>
+static inline void set_direction_mask(bitboard_t movable, bitboard_t occupied, bitboard_t empty,
+                                      const uint8_t* piece_bits, bool skip_move, int* dest) {
+    constexpr int back = (D + 3) % N_DIRECTIONS;
+    // cells whose neighbor in direction D is empty
+    auto next_empty = shift_bitboard<back>(empty);
+    auto can_step = skip_move ? bitboard_t(0) : (movable & next_empty);
+    // cells whose neighbor in direction D is occupied and the one after that is empty
+    auto can_jump = movable & shift_bitboard<back>(occupied & next_empty);
+    auto can_move = can_step | can_jump;
+    if (can_move == 0) {
+        return;
+    }
+    for (size_t i = 0; i < N_PIECES_PER_PLAYER; i++) {
+        dest[i * N_DIRECTIONS + D] |= bitboard_test(can_move, piece_bits[i]);
+    }
+}
+
+void set_action_mask(const BitboardState_t& bb_state, int* dest) {
+    auto player = bb_state.current_player;
+    auto last_skipped_piece = bb_state.last_skipped_piece;
+    auto skip_move = last_skipped_piece != -1;
+    auto last_direction = bb_state.last_direction;
+    const auto* piece_bits = bb_state.piece_bits[player - 1];
+
+    auto occupied = bb_state.pieces[0] | bb_state.pieces[1];
+    auto empty = bitboard_tables.valid & ~occupied;
+    // once a skip has happened only the skipping piece can move again
+    auto movable = skip_move ? bit_at(piece_bits[last_skipped_piece]) : bb_state.pieces[player - 1];
+
+    set_direction_mask<0>(movable, occupied, empty, piece_bits, skip_move, dest);
+    set_direction_mask<1>(movable, occupied, empty, piece_bits, skip_move, dest);
+    set_direction_mask<2>(movable, occupied, empty, piece_bits, skip_move, dest);
+    set_direction_mask<3>(movable, occupied, empty, piece_bits, skip_move, dest);
+    set_direction_mask<4>(movable, occupied, empty, piece_bits, skip_move, dest);
+    set_direction_mask<5>(movable, occupied, empty, piece_bits, skip_move, dest);
+
+    if (skip_move) {
+        // we mask out the reverse of the previous skip so we can't undo a move
+        dest[last_skipped_piece * N_DIRECTIONS + (last_direction + 3) % N_DIRECTIONS] = 0;
+        dest[N_MOVES - 1] = 1;
+    }
+}
+
+static inline void next_turn(BitboardState_t& bb_state) {
+    bb_state.last_skipped_piece = -1;
+    bb_state.last_direction = -1;
+    bb_state.current_player = (bb_state.current_player % 2) + 1;
+    bb_state.turn_count += 1;
+
+    // same rule as GameState_t::check_winner, player 1 is checked first
+    if ((bb_state.pieces[0] & bitboard_tables.goal[0]) == bb_state.pieces[0]) {
+        bb_state.winner = 1;
+    } else if ((bb_state.pieces[1] & bitboard_tables.goal[1]) == bb_state.pieces[1]) {
+        bb_state.winner = 2;
+    }
+}
+
+void update_state(BitboardState_t& bb_state, size_t move) {
+    if (move == N_MOVES - 1) {
+        next_turn(bb_state);
+        return;
+    }
+
+    auto p = bb_state.current_player - 1;
+    size_t piece_num = move / N_DIRECTIONS;
+    size_t direction = move % N_DIRECTIONS;
+
+    // we assume the move is valid, so the first step stays on the board and if it's
+    // occupied the second step is free
+    auto from = bit_at(bb_state.piece_bits[p][piece_num]);
+    auto to = shift_bitboard(from, direction);
+    bool jump = (to & (bb_state.pieces[0] | bb_state.pieces[1])) != 0;
+    if (jump) {
+        to = shift_bitboard(to, direction);
+    }
+    assert(to != 0);
+    bb_state.pieces[p] ^= from | to;
+    bb_state.piece_bits[p][piece_num] = bitboard_lowest_bit(to);
+
+    if (!jump) {
+        assert(bb_state.last_skipped_piece == -1);
+        next_turn(bb_state);
+    } else {
+        bb_state.last_skipped_piece = piece_num;
+        bb_state.last_direction = direction;
+    }
+}
@@ -0,0 +1,144 @@
+#pragma once
+#include "board.h"
+#include "constants.h"
+#include <array>
+#include <cstdint>
+
+// alternative state representation built on 128-bit bitboards. the 121 playable cells are numbered
+// row-major (skipping invalid cells), so bit b of a bitboard is the b-th playable cell of the board.
+//
+// because the rows of the star have different widths, moving one cell in a fixed direction is not a
+// single shift for the whole board: the shift amount depends on the row the cell sits in. there are at
+// most 8 distinct amounts per direction though, so a directional shift is an OR over (mask, shift) groups.
+typedef unsigned __int128 bitboard_t;
+
+static const size_t N_VALID_CELLS = 121;
+static const size_t MAX_SHIFT_GROUPS = 8;
+
+struct bitboard_tables_t {
+    // flat grid index (r * COLS + c) -> bit index, -1 for invalid cells
+    std::array<int, NUM_CELLS> cell_to_bit;
+    // bit index -> flat grid index
+    std::array<int, N_VALID_CELLS> bit_to_cell;
+    // neighbor_bit[b][d] is the bit one step from b in direction d, -1 if that's off the board
+    std::array<std::array<int, N_DIRECTIONS>, N_VALID_CELLS> neighbor_bit;
+    // shift groups: cells in group_mask[d][g] move by group_shift[d][g] bits in direction d
+    std::array<std::array<bitboard_t, MAX_SHIFT_GROUPS>, N_DIRECTIONS> group_mask;
+    std::array<std::array<int, MAX_SHIFT_GROUPS>, N_DIRECTIONS> group_shift;
+    std::array<int, N_DIRECTIONS> n_groups;
+    bitboard_t valid;
+    // goal[p] is the triangle player p + 1 has to fill to win
+    std::array<bitboard_t, N_PLAYERS> goal;
+};
+
+constexpr bitboard_t bit_at(int b) {
+    return static_cast<bitboard_t>(1) << b;
+}
+
+constexpr bitboard_tables_t make_bitboard_tables() {
+    bitboard_tables_t t{};
+    int n_bits = 0;
+    for (int r = 0; r < (int)ROWS; r++) {
+        for (int c = 0; c < (int)COLS; c++) {
+            bool valid = c >= min_max_cols[r][0] && c <= min_max_cols[r][1];
+            t.cell_to_bit[r * COLS + c] = valid ? n_bits : -1;
+            if (valid) {
+                t.bit_to_cell[n_bits] = r * COLS + c;
+                t.valid |= bit_at(n_bits);
+                if (r >= 13)
+                    t.goal[0] |= bit_at(n_bits);
+                if (r <= 3)
+                    t.goal[1] |= bit_at(n_bits);
+                n_bits++;
+            }
+        }
+    }
+
+    for (int b = 0; b < (int)N_VALID_CELLS; b++) {
+        for (int d = 0; d < (int)N_DIRECTIONS; d++) {
+            int target = step_targets[t.bit_to_cell[b]][d];
+            int nb = (target == OFF_BOARD) ? -1 : t.cell_to_bit[target];
+            t.neighbor_bit[b][d] = nb;
+            if (nb == -1)
+                continue;
+
+            int shift = nb - b;
+            int g = 0;
+            while (g < t.n_groups[d] && t.group_shift[d][g] != shift)
+                g++;
+            if (g == t.n_groups[d]) {
+                t.group_shift[d][g] = shift;
+                t.n_groups[d]++;
+            }
+            t.group_mask[d][g] |= bit_at(b);
+        }
+    }
+    return t;
+}
+
+static constexpr bitboard_tables_t bitboard_tables = make_bitboard_tables();
+
+// move every set bit one cell in direction D, bits that would leave the board are dropped. the direction
+// is a template parameter so the group loop unrolls into straight-line shifts with constant masks
+template <int D>
+inline bitboard_t shift_bitboard(bitboard_t bb) {
+    constexpr auto& masks = bitboard_tables.group_mask[D];
+    constexpr auto& shifts = bitboard_tables.group_shift[D];
+    bitboard_t result = 0;
+    for (int g = 0; g < bitboard_tables.n_groups[D]; g++) {
+        auto moved = bb & masks[g];
+        result |= (shifts[g] > 0) ? (moved << shifts[g]) : (moved >> -shifts[g]);
+    }
+    return result;
+}
+
+inline bitboard_t shift_bitboard(bitboard_t bb, int d) {
+    switch (d) {
+    case 0:
+        return shift_bitboard<0>(bb);
+    case 1:
+        return shift_bitboard<1>(bb);
+    case 2:
+        return shift_bitboard<2>(bb);
+    case 3:
+        return shift_bitboard<3>(bb);
+    case 4:
+        return shift_bitboard<4>(bb);
+    default:
+        return shift_bitboard<5>(bb);
+    }
+}
+
+inline int bitboard_lowest_bit(bitboard_t bb) {
+    auto lo = static_cast<uint64_t>(bb);
+    if (lo != 0)
+        return __builtin_ctzll(lo);
+    return 64 + __builtin_ctzll(static_cast<uint64_t>(bb >> 64));
+}
+
+inline bool bitboard_test(bitboard_t bb, int b) {
+    return (bb >> b) & 1;
+}
+
+// plain struct, no pointers into a tensor: a batch of these is stored as an int64 tensor of shape
+// (n_batch, BITBOARD_STATE) and reinterpreted in place
+struct BitboardState_t {
+    bitboard_t pieces[N_PLAYERS];
+    uint8_t piece_bits[N_PLAYERS][N_PIECES_PER_PLAYER];
+    int8_t current_player;
+    int8_t last_skipped_piece;
+    int8_t last_direction;
+    int8_t winner;
+    int32_t turn_count;
+};
+
+static const size_t BITBOARD_STATE = sizeof(BitboardState_t) / sizeof(int64_t);
+static_assert(sizeof(BitboardState_t) % sizeof(int64_t) == 0, "BitboardState_t must pack into int64 words");
+
+void to_bitboard(GameState_t game_state, BitboardState_t& bb_state);
+void to_bitboard(CompactGameState_t game_state, BitboardState_t& bb_state);
+void from_bitboard(const BitboardState_t& bb_state, GameState_t game_state);
+
+void initialize_state(BitboardState_t& bb_state);
+void set_action_mask(const BitboardState_t& bb_state, int* dest);
+void update_state(BitboardState_t& bb_state, size_t move);
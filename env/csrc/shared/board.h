@@ -1,7 +1,9 @@
 #pragma once
 #include "constants.h"
+#include "zobrist.h"
 #include <array>
 #include <cassert>
+#include <cstdint>
 #include <vector>
 
 // offsets for even/odd row neighbors
@@ -10,12 +12,12 @@
 // (0, -1), (0, 0), (0, 1)    
 //     ( 1, -1), ( 1, 0)
 // so the direction order is (NE, E, SE, SW, W, NW)
-static const std::array<std::array<int, 2>, 6> even_row_neighbors = {
+static constexpr std::array<std::array<int, 2>, 6> even_row_neighbors = {
     {{-1, 0}, {0, 1}, {1, 0}, {1, -1}, {0, -1}, {-1, -1}}};
 // the neighbors are different if you start on an odd row:
-static const std::array<std::array<int, 2>, 6> odd_row_neighbors = {
+static constexpr std::array<std::array<int, 2>, 6> odd_row_neighbors = {
     {{-1, 1}, {0, 1}, {1, 1}, {1, 0}, {0, -1}, {-1, 0}}};
-static const std::array<std::array<int, 2>, 6> double_step_neighbors = {
+static constexpr std::array<std::array<int, 2>, 6> double_step_neighbors = {
     {{-2, 1}, {0, 2}, {2, 1}, {2, -1}, {0, -2}, {-2, -1}}};
 
 inline bool in_bounds(int r, int c) {
@@ -29,27 +31,27 @@ inline bool in_bounds(point_t p) {
 }
 
 // min_max_cols[r] = {min_col, max_col} for row r
-static const std::array<std::array<int, 2>, 17> min_max_cols = {{{6, 6},
-                                                                 {5, 6},
-                                                                 {5, 7},
-                                                                 {4, 7},
-                                                                 {0, 12},
-                                                                 {0, 11},
-                                                                 {1, 11},
-                                                                 {1, 10},
-                                                                 {2, 10},
-                                                                 {1, 10},
-                                                                 {1, 11},
-                                                                 {0, 11},
-                                                                 {0, 12},
-                                                                 {4, 7},
-                                                                 {5, 7},
-                                                                 {5, 6},
-                                                                 {6, 6}}};
-
-static const std::array<std::array<int, 2>, 10> player_1_start = {
+static constexpr std::array<std::array<int, 2>, 17> min_max_cols = {{{6, 6},
+                                                                     {5, 6},
+                                                                     {5, 7},
+                                                                     {4, 7},
+                                                                     {0, 12},
+                                                                     {0, 11},
+                                                                     {1, 11},
+                                                                     {1, 10},
+                                                                     {2, 10},
+                                                                     {1, 10},
+                                                                     {1, 11},
+                                                                     {0, 11},
+                                                                     {0, 12},
+                                                                     {4, 7},
+                                                                     {5, 7},
+                                                                     {5, 6},
+                                                                     {6, 6}}};
+
+static constexpr std::array<std::array<int, 2>, 10> player_1_start = {
     {{0, 6}, {1, 5}, {1, 6}, {2, 5}, {2, 6}, {2, 7}, {3, 4}, {3, 5}, {3, 6}, {3, 7}}};
-static const std::array<std::array<int, 2>, 10> player_2_start = {
+static constexpr std::array<std::array<int, 2>, 10> player_2_start = {
     {{16, 6}, {15, 5}, {15, 6}, {14, 5}, {14, 6}, {14, 7}, {13, 4}, {13, 5}, {13, 6}, {13, 7}}};
 
 inline bool is_valid_cell(int r, int c) {
@@ -92,6 +94,60 @@ inline neighbors_t get_neighbors(point_t p, bool include_invalid = false) {
     return result; // Modern C++ will use return value optimization here
 }
 
+// precomputed move targets indexed by flat cell id (r * COLS + c). step_targets[cell][d] is the cell one
+// step away in direction d and jump_targets[cell][d] the cell two steps away (i.e. where a jump over the
+// step target lands), OFF_BOARD if that cell isn't playable. invalid cells have no targets at all.
+static constexpr int OFF_BOARD = -1;
+
+typedef std::array<std::array<int, N_DIRECTIONS>, NUM_CELLS> cell_table_t;
+
+constexpr bool is_valid_cell_constexpr(int r, int c) {
+    return r >= 0 && r < (int)ROWS && c >= 0 && c < (int)COLS && c >= min_max_cols[r][0] &&
+           c <= min_max_cols[r][1];
+}
+
+constexpr cell_table_t make_move_targets(int n_steps) {
+    cell_table_t table{};
+    for (int r = 0; r < (int)ROWS; r++) {
+        for (int c = 0; c < (int)COLS; c++) {
+            for (int d = 0; d < (int)N_DIRECTIONS; d++) {
+                int tr = r;
+                int tc = c;
+                bool valid = is_valid_cell_constexpr(r, c);
+                for (int step = 0; step < n_steps && valid; step++) {
+                    const auto& delta = (tr % 2 == 0) ? even_row_neighbors : odd_row_neighbors;
+                    tr += delta[d][0];
+                    tc += delta[d][1];
+                    valid = is_valid_cell_constexpr(tr, tc);
+                }
+                table[r * COLS + c][d] = valid ? tr * COLS + tc : OFF_BOARD;
+            }
+        }
+    }
+    return table;
+}
+
+static constexpr cell_table_t step_targets = make_move_targets(1);
+static constexpr cell_table_t jump_targets = make_move_targets(2);
+
+// steps between two cells on the odd-row-shifted grid, through axial coordinates
+constexpr int hex_distance(int cell_a, int cell_b) {
+    int ra = cell_a / (int)COLS, rb = cell_b / (int)COLS;
+    int qa = cell_a % (int)COLS - (ra - (ra & 1)) / 2;
+    int qb = cell_b % (int)COLS - (rb - (rb & 1)) / 2;
+    int dq = qa - qb, dr = ra - rb;
+    int ds = dq + dr;
+    return ((dq < 0 ? -dq : dq) + (dr < 0 ? -dr : dr) + (ds < 0 ? -ds : ds)) / 2;
+}
+
+inline int cell_index(point_t p) {
+    return p.first * COLS + p.second;
+}
+
+inline point_t cell_point(int cell) {
+    return {cell / (int)COLS, cell % (int)COLS};
+}
+
 class GameState_t {
 public:
     int* grid;
@@ -102,6 +158,8 @@ public:
     int* last_direction;
     int* winner;
     int* turn_count;
+    // kept up to date by update_state/start_hop/next_turn, see zobrist.h
+    uint64_t* hash;
 
     GameState_t(int* flat_cells) {
         // initialize from a pointer to a flat array (note: no copies)
@@ -116,24 +174,55 @@ public:
         last_skipped_piece = current_ptr++;
         last_direction = current_ptr++;
         winner = current_ptr++;
-        turn_count = current_ptr;
+        turn_count = current_ptr++;
+        hash = reinterpret_cast<uint64_t*>(current_ptr);
     }
 
     inline bool occupied(point_t p) {
         return grid[p.first * COLS + p.second] != EMPTY;
     }
 
-    inline void update_state(point_t from, point_t to, int player, int piece_num) {
-        grid[from.first * COLS + from.second] = EMPTY;
-        grid[to.first * COLS + to.second] = player;
+    inline bool occupied(int cell) {
+        return grid[cell] != EMPTY;
+    }
+
+    inline int piece_cell(int player, int piece_num) {
+        return cell_index((player == 1) ? player_1_pieces[piece_num] : player_2_pieces[piece_num]);
+    }
+
+    inline void set_piece(int player, int piece_num, int cell) {
         if (player == 1) {
-            player_1_pieces[piece_num] = to;
+            player_1_pieces[piece_num] = cell_point(cell);
         } else {
-            player_2_pieces[piece_num] = to;
+            player_2_pieces[piece_num] = cell_point(cell);
+        }
+    }
+
+    inline void update_state(int from, int to, int player, int piece_num) {
+        grid[from] = EMPTY;
+        grid[to] = player;
+        set_piece(player, piece_num, to);
+        *hash ^= zobrist_keys.piece[player - 1][from] ^ zobrist_keys.piece[player - 1][to];
+    }
+
+    inline void update_state(point_t from, point_t to, int player, int piece_num) {
+        update_state(cell_index(from), cell_index(to), player, piece_num);
+    }
+
+    inline void start_hop(int piece_num, int direction) {
+        if (*last_skipped_piece != -1) {
+            *hash ^= zobrist_keys.hop[*last_skipped_piece][*last_direction];
         }
+        *last_skipped_piece = piece_num;
+        *last_direction = direction;
+        *hash ^= zobrist_keys.hop[piece_num][direction];
     }
 
     inline void next_turn() {
+        if (*last_skipped_piece != -1) {
+            *hash ^= zobrist_keys.hop[*last_skipped_piece][*last_direction];
+        }
+        *hash ^= zobrist_keys.player_2_to_move;
         *last_skipped_piece = -1;
         *last_direction = -1;
         *current_player = (*current_player % 2) + 1;
@@ -170,3 +259,110 @@ public:
         }
     }
 };
+
+// same interface as GameState_t over the packed uint8 layout (see COMPACT_STATE): cells are int8,
+// pieces are stored as flat cell ids rather than (row, col) pairs, metadata is byte-sized
+class CompactGameState_t {
+public:
+    int8_t* grid;
+    uint8_t* player_1_pieces;
+    uint8_t* player_2_pieces;
+    uint8_t* current_player;
+    int8_t* last_skipped_piece;
+    int8_t* last_direction;
+    uint8_t* winner;
+    int32_t* turn_count;
+    uint64_t* hash;
+
+    CompactGameState_t(uint8_t* flat_cells) {
+        // initialize from a pointer to a flat array (note: no copies)
+        grid = reinterpret_cast<int8_t*>(flat_cells);
+        player_1_pieces = flat_cells + NUM_CELLS;
+        player_2_pieces = player_1_pieces + N_PIECES_PER_PLAYER;
+        uint8_t* metadata = flat_cells + COMPACT_METADATA_OFFSET;
+        current_player = metadata;
+        last_skipped_piece = reinterpret_cast<int8_t*>(metadata + 1);
+        last_direction = reinterpret_cast<int8_t*>(metadata + 2);
+        winner = metadata + 3;
+        turn_count = reinterpret_cast<int32_t*>(flat_cells + COMPACT_TURN_COUNT_OFFSET);
+        hash = reinterpret_cast<uint64_t*>(flat_cells + COMPACT_HASH_OFFSET);
+    }
+
+    inline bool occupied(int cell) {
+        return grid[cell] != EMPTY;
+    }
+
+    inline int piece_cell(int player, int piece_num) {
+        return (player == 1) ? player_1_pieces[piece_num] : player_2_pieces[piece_num];
+    }
+
+    inline void set_piece(int player, int piece_num, int cell) {
+        if (player == 1) {
+            player_1_pieces[piece_num] = cell;
+        } else {
+            player_2_pieces[piece_num] = cell;
+        }
+    }
+
+    inline void update_state(int from, int to, int player, int piece_num) {
+        grid[from] = EMPTY;
+        grid[to] = player;
+        set_piece(player, piece_num, to);
+        *hash ^= zobrist_keys.piece[player - 1][from] ^ zobrist_keys.piece[player - 1][to];
+    }
+
+    inline void start_hop(int piece_num, int direction) {
+        if (*last_skipped_piece != -1) {
+            *hash ^= zobrist_keys.hop[*last_skipped_piece][*last_direction];
+        }
+        *last_skipped_piece = piece_num;
+        *last_direction = direction;
+        *hash ^= zobrist_keys.hop[piece_num][direction];
+    }
+
+    inline void next_turn() {
+        if (*last_skipped_piece != -1) {
+            *hash ^= zobrist_keys.hop[*last_skipped_piece][*last_direction];
+        }
+        *hash ^= zobrist_keys.player_2_to_move;
+        *last_skipped_piece = -1;
+        *last_direction = -1;
+        *current_player = (*current_player % 2) + 1;
+        *turn_count += 1;
+        check_winner();
+    }
+
+    inline void check_winner() {
+        // rows are contiguous in the flat layout, so "r >= 13" is "cell >= 13 * COLS"
+        bool player1_won = true;
+        bool player2_won = true;
+        for (size_t i = 0; i < N_PIECES_PER_PLAYER; i++) {
+            player1_won &= player_1_pieces[i] >= 13 * COLS;
+            player2_won &= player_2_pieces[i] < 4 * COLS;
+        }
+        if (player1_won) {
+            *winner = 1;
+        } else if (player2_won) {
+            *winner = 2;
+        }
+    }
+};
+
+// the zobrist hash of a state from scratch, set_piece doesn't maintain *hash so anything that places
+// pieces directly (initialization, conversions) recomputes it with this
+template <typename State>
+inline uint64_t compute_hash(State game_state) {
+    uint64_t hash = 0;
+    for (int player = 1; player <= (int)N_PLAYERS; player++) {
+        for (size_t i = 0; i < N_PIECES_PER_PLAYER; i++) {
+            hash ^= zobrist_keys.piece[player - 1][game_state.piece_cell(player, i)];
+        }
+    }
+    if (*game_state.current_player == 2) {
+        hash ^= zobrist_keys.player_2_to_move;
+    }
+    if (*game_state.last_skipped_piece != -1) {
+        hash ^= zobrist_keys.hop[*game_state.last_skipped_piece][*game_state.last_direction];
+    }
+    return hash;
+}
@@ -3,6 +3,7 @@
 // #include "raylib.h"
 
 #include <array>
+#include <cstdint>
 #include <functional> // for std::hash<int>
 #include <unordered_set>
 #include <utility> // for std::pair
@@ -18,14 +19,23 @@ static const size_t ROWS = 17;
 static const size_t COLS = 13;
 static const size_t NUM_CELLS = ROWS * COLS;
 
-// current_player, winner, last_skipped_piece, last_direction, turn_count
-static const size_t GAME_METADATA = 5;
+// current_player, winner, last_skipped_piece, last_direction, turn_count and the 64-bit zobrist hash
+// stored as two ints (it lands on an 8-byte boundary)
+static const size_t GAME_METADATA = 7;
 
 // 1 int to store the what is happening in each grid point + 10
 static const size_t TOTAL_STATE =
     NUM_CELLS + (N_PLAYERS * N_PIECES_PER_PLAYER * sizeof(point_t) / sizeof(int)) + GAME_METADATA;
 
 
+// compact uint8 layout: 1 byte per cell, piece positions as flat cell ids, then current_player,
+// last_skipped_piece, last_direction and winner as bytes, turn_count as an aligned int32 and the
+// zobrist hash as an aligned uint64
+static const size_t COMPACT_METADATA_OFFSET = NUM_CELLS + N_PLAYERS * N_PIECES_PER_PLAYER;
+static const size_t COMPACT_TURN_COUNT_OFFSET = (COMPACT_METADATA_OFFSET + 4 + 3) / 4 * 4;
+static const size_t COMPACT_HASH_OFFSET = (COMPACT_TURN_COUNT_OFFSET + sizeof(int) + 7) / 8 * 8;
+static const size_t COMPACT_STATE = COMPACT_HASH_OFFSET + sizeof(uint64_t);
+
     static const size_t N_MOVES = N_DIRECTIONS * N_PIECES_PER_PLAYER + 1;
 
 static const int EMPTY = 0;
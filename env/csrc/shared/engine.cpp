@@ -0,0 +1,234 @@
+#include "engine.h"
+#include "board.h"
+#include "constants.h"
+#include "stats.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+
+static parallel_backend_t parallel_backend = nullptr;
+// a single env takes well under a microsecond, so chunks need a few hundred envs to be worth a thread
+static std::atomic<int64_t> batch_grain_size{256};
+
+void set_parallel_backend(parallel_backend_t backend) {
+    parallel_backend = backend;
+}
+
+parallel_backend_t get_parallel_backend() {
+    return parallel_backend;
+}
+
+void set_grain_size(int64_t grain_size) {
+    if (grain_size > 0) {
+        batch_grain_size.store(grain_size, std::memory_order_relaxed);
+    }
+}
+
+int64_t get_grain_size() {
+    return batch_grain_size.load(std::memory_order_relaxed);
+}
+
+// the rules are written once against the interface shared by GameState_t and CompactGameState_t
+// (piece_cell/set_piece/occupied/update_state/next_turn and the metadata pointers)
+template <typename State>
+static void initialize_state_impl(State game_state) {
+    for (int r = 0; r < ROWS; r++) {
+        for (int c = 0; c < COLS; c++) {
+            int idx = r * COLS + c;
+            if ((r <= 3) && is_valid_cell(r, c)) {
+                game_state.grid[idx] = 1;
+            } else if ((r >= 13) && is_valid_cell(r, c)) {
+                game_state.grid[idx] = 2;
+            } else if (!is_valid_cell(r, c)) {
+                game_state.grid[idx] = INVALID;
+            } else {
+                game_state.grid[idx] = EMPTY;
+            }
+        }
+    }
+    for (size_t i = 0; i < N_PIECES_PER_PLAYER; i++) {
+        game_state.set_piece(1, i, player_1_start[i][0] * COLS + player_1_start[i][1]);
+        game_state.set_piece(2, i, player_2_start[i][0] * COLS + player_2_start[i][1]);
+    }
+    *game_state.current_player = 1;
+    *game_state.last_skipped_piece = -1;
+    *game_state.last_direction = -1;
+    *game_state.winner = 0;
+    *game_state.turn_count = 0;
+    *game_state.hash = compute_hash(game_state);
+}
+
+void initialize_state(GameState_t game_state) {
+    initialize_state_impl(game_state);
+}
+
+void initialize_state(CompactGameState_t game_state) {
+    initialize_state_impl(game_state);
+}
+
+template <typename Src, typename Dst>
+static void copy_state_impl(Src src, Dst dst) {
+    for (size_t idx = 0; idx < NUM_CELLS; idx++) {
+        dst.grid[idx] = src.grid[idx];
+    }
+    for (int player = 1; player <= (int)N_PLAYERS; player++) {
+        for (size_t i = 0; i < N_PIECES_PER_PLAYER; i++) {
+            dst.set_piece(player, i, src.piece_cell(player, i));
+        }
+    }
+    *dst.current_player = *src.current_player;
+    *dst.last_skipped_piece = *src.last_skipped_piece;
+    *dst.last_direction = *src.last_direction;
+    *dst.winner = *src.winner;
+    *dst.turn_count = *src.turn_count;
+    *dst.hash = *src.hash;
+}
+
+void copy_state(GameState_t src, GameState_t dst) {
+    copy_state_impl(src, dst);
+}
+
+void copy_state(GameState_t src, CompactGameState_t dst) {
+    copy_state_impl(src, dst);
+}
+
+void copy_state(CompactGameState_t src, CompactGameState_t dst) {
+    copy_state_impl(src, dst);
+}
+
+void copy_state(CompactGameState_t src, GameState_t dst) {
+    copy_state_impl(src, dst);
+}
+
+template <typename State>
+static void set_action_mask_impl(State game_state, int* dest) {
+    int player = *game_state.current_player;
+    int last_skipped_piece = *game_state.last_skipped_piece;
+    auto skip_move = last_skipped_piece != -1;
+    int last_direction = *game_state.last_direction;
+
+    for (int i = 0; i < (int)N_PIECES_PER_PLAYER; i++) {
+        if (last_skipped_piece != -1 && last_skipped_piece != i) {
+            // we can only move the last skipped piece if a skip has already happened
+            continue;
+        }
+
+        auto cell = game_state.piece_cell(player, i);
+        const auto& steps = step_targets[cell];
+        const auto& jumps = jump_targets[cell];
+        for (int j = 0; j < N_DIRECTIONS; j++) {
+            auto dest_idx = i * N_DIRECTIONS + j;
+            auto one_step = steps[j];
+            if (one_step == OFF_BOARD) {
+                continue;
+            }
+            // if the next cell is unoccupied, the only move we can make is 1 step
+            // if we haven't already started skipping
+            if (!game_state.occupied(one_step)) {
+                if (!skip_move) {
+                    dest[dest_idx] = 1;
+                }
+            } else {
+                // now we know that the one step move in that direction is occupied
+                // so we are ONLY looking to see if it's possible to make a two step
+                // move (i.e. if it's not occupied)
+                auto two_step = jumps[j];
+                if (two_step == OFF_BOARD) {
+                    continue;
+                }
+                // we have already checked at this point that one_step is occupied
+                if (!game_state.occupied(two_step)) {
+                    // we mask out the previous step if we've already started skipping
+                    // so we can't undo a move
+                    if (skip_move && (last_skipped_piece == i) &&
+                        (((last_direction - j + N_DIRECTIONS) % N_DIRECTIONS) == 3)) {
+                        continue;
+                    }
+                    dest[dest_idx] = 1;
+                }
+            }
+        }
+    }
+
+    // finally, if skip_move is set, we set the last action mask to 1
+    if (skip_move) {
+        dest[N_MOVES - 1] = 1;
+    }
+}
+
+void set_action_mask(GameState_t game_state, int* dest) {
+    set_action_mask_impl(game_state, dest);
+    stats_count_call(KERNEL_SET_ACTION_MASK);
+}
+
+void set_action_mask(CompactGameState_t game_state, int* dest) {
+    set_action_mask_impl(game_state, dest);
+    stats_count_call(KERNEL_SET_ACTION_MASK);
+}
+
+template <typename State>
+static void update_state_impl(State game_state, size_t move) {
+    stats_count_call(KERNEL_UPDATE_STATE);
+    int current_player = *game_state.current_player;
+    if (move == N_MOVES - 1) {
+        // end skipping, so we reset and switch players
+        game_state.next_turn();
+        return;
+    }
+
+    size_t piece_num = move / 6;
+    size_t direction = move % 6;
+
+    // now we need to figure out if we're moving 1 or 2 steps (we assume the move
+    // is valid)
+    auto cell = game_state.piece_cell(current_player, piece_num);
+    auto one_step = step_targets[cell][direction];
+    auto two_step = jump_targets[cell][direction];
+    if (!game_state.occupied(one_step)) {
+        game_state.update_state(cell, one_step, current_player, piece_num);
+        // make sure last_skipped_piece is -1 (should be masked off)
+        assert(*game_state.last_skipped_piece == -1);
+        game_state.next_turn();
+    } else {
+        // we know that two_step is empty
+        assert(!game_state.occupied(two_step));
+        game_state.update_state(cell, two_step, current_player, piece_num);
+        // now we set the "last_skipped_piece" flag and DONT switch players
+        game_state.start_hop(piece_num, direction);
+    }
+}
+
+void update_state(GameState_t game_state, size_t move) {
+    update_state_impl(game_state, move);
+}
+
+void update_state(CompactGameState_t game_state, size_t move) {
+    update_state_impl(game_state, move);
+}
+
+template <typename State>
+static void step_state_impl(State game_state, size_t move, float& reward, bool& done, int* mask) {
+    int player = *game_state.current_player;
+    update_state(game_state, move);
+    stats_count_move(move, *game_state.current_player == player, *game_state.winner);
+
+    // the reward is from the point of view of the player that just moved
+    int winner = *game_state.winner;
+    done = winner != 0;
+    reward = (winner == 0) ? 0.0f : (winner == player ? 1.0f : -1.0f);
+    if (winner != 0) {
+        initialize_state(game_state);
+    }
+
+    std::fill_n(mask, N_MOVES, 0);
+    set_action_mask(game_state, mask);
+    stats_count_mask(mask);
+}
+
+void step_state(GameState_t game_state, size_t move, float& reward, bool& done, int* mask) {
+    step_state_impl(game_state, move, reward, done, mask);
+}
+
+void step_state(CompactGameState_t game_state, size_t move, float& reward, bool& done, int* mask) {
+    step_state_impl(game_state, move, reward, done, mask);
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include "bitboard.h"
+#include "board.h"
+#include "constants.h"
+#include "turn_moves.h"
+#include <cstdint>
+#include <functional>
+
+// the game engine proper: plain C++ over raw state buffers, no torch. the python extension (csrc/ext) and
+// the binaries are adapters over these functions, the torch batched ops live in ext/chinese_checkers.h.
+
+// batch loops go through parallel_for_batch. without a backend they run on the calling thread; the torch
+// extension installs one that uses torch's intra-op pool. every env is stepped by exactly one thread, so
+// the results are the same for any backend or thread count.
+using parallel_backend_t = void (*)(int64_t n, int64_t grain_size, const std::function<void(int64_t, int64_t)>& fn);
+void set_parallel_backend(parallel_backend_t backend);
+parallel_backend_t get_parallel_backend();
+// grain_size <= 0 keeps the current value
+void set_grain_size(int64_t grain_size);
+int64_t get_grain_size();
+
+// fn(begin, end) for chunks of [0, n_batch)
+template <typename F>
+inline void parallel_for_chunks(int n_batch, const F& fn) {
+    auto backend = get_parallel_backend();
+    if (!backend) {
+        if (n_batch > 0) {
+            fn((int64_t)0, (int64_t)n_batch);
+        }
+        return;
+    }
+    backend(n_batch, get_grain_size(), fn);
+}
+
+// fn(i) for every i in [0, n_batch)
+template <typename F>
+inline void parallel_for_batch(int n_batch, const F& fn) {
+    parallel_for_chunks(n_batch, [&](int64_t begin, int64_t end) {
+        for (int64_t i = begin; i < end; i++) {
+            fn(i);
+        }
+    });
+}
+
+void initialize_state(GameState_t game_state);
+void initialize_state(CompactGameState_t game_state);
+
+// between any two layouts, the hash included
+void copy_state(GameState_t src, GameState_t dst);
+void copy_state(GameState_t src, CompactGameState_t dst);
+void copy_state(CompactGameState_t src, CompactGameState_t dst);
+void copy_state(CompactGameState_t src, GameState_t dst);
+
+// dest has N_MOVES entries and is expected to be zeroed
+void set_action_mask(GameState_t game_state, int* dest);
+void set_action_mask(CompactGameState_t game_state, int* dest);
+
+void update_state(GameState_t game_state, size_t move);
+void update_state(CompactGameState_t game_state, size_t move);
+
+// one RL step: apply the move, set the mover's reward (+1 win, -1 loss, 0 otherwise) and done flag,
+// re-initialize a finished game and write the next action mask (N_MOVES entries, cleared here)
+void step_state(GameState_t game_state, size_t move, float& reward, bool& done, int* mask);
+void step_state(CompactGameState_t game_state, size_t move, float& reward, bool& done, int* mask);
@@ -0,0 +1,113 @@
+#include "episode.h"
+#include "board.h"
+#include "constants.h"
+#include "engine.h"
+#include "evaluation.h"
+#include "mask_cache.h"
+#include "stats.h"
+#include <algorithm>
+
+template <typename State>
+static void init_episode_tracker_impl(State game_state, episode_tracker_t& tracker) {
+    for (int player = 1; player <= (int)N_PLAYERS; player++) {
+        tracker.best_distance[player - 1] = goal_distance(game_state, player);
+    }
+    tracker.last_progress_turn = *game_state.turn_count;
+}
+
+void init_episode_tracker(GameState_t game_state, episode_tracker_t& tracker) {
+    init_episode_tracker_impl(game_state, tracker);
+}
+
+void init_episode_tracker(CompactGameState_t game_state, episode_tracker_t& tracker) {
+    init_episode_tracker_impl(game_state, tracker);
+}
+
+template <typename State>
+static bool track_episode_impl(State game_state, episode_tracker_t& tracker, const episode_limits_t& limits,
+                               int player) {
+    int turn = *game_state.turn_count;
+    // mid hop chain the pieces go back and forth, only whole turns count. the distance is only needed for the
+    // stall window, so a plain turn cap never evaluates anything
+    if (limits.stall_turns > 0 && *game_state.current_player != player) {
+        int distance = goal_distance(game_state, player);
+        if (distance < tracker.best_distance[player - 1]) {
+            tracker.best_distance[player - 1] = distance;
+            tracker.last_progress_turn = turn;
+        }
+    }
+    return (limits.max_turns > 0 && turn >= limits.max_turns) ||
+           (limits.stall_turns > 0 && turn - tracker.last_progress_turn >= limits.stall_turns);
+}
+
+bool track_episode(GameState_t game_state, episode_tracker_t& tracker, const episode_limits_t& limits, int player) {
+    return track_episode_impl(game_state, tracker, limits, player);
+}
+
+bool track_episode(CompactGameState_t game_state, episode_tracker_t& tracker, const episode_limits_t& limits,
+                   int player) {
+    return track_episode_impl(game_state, tracker, limits, player);
+}
+
+// cache is null for the uncached step, final_state when the caller doesn't want the ended games
+template <typename State, typename Buffer>
+static void step_state_limited_impl(State game_state, mask_cache_t* cache, episode_tracker_t& tracker,
+                                    const episode_limits_t& limits, size_t move, float& reward, bool& terminated,
+                                    bool& truncated, int* mask, Buffer* final_state) {
+    int player = *game_state.current_player;
+    if (cache)
+        update_state_cached(game_state, *cache, move);
+    else
+        update_state(game_state, move);
+    stats_count_move(move, *game_state.current_player == player, *game_state.winner);
+
+    // the terminal part is step_state's
+    int winner = *game_state.winner;
+    terminated = winner != 0;
+    truncated = !terminated && track_episode_impl(game_state, tracker, limits, player);
+    reward = (winner == 0) ? 0.0f : (winner == player ? 1.0f : -1.0f);
+    if (terminated || truncated) {
+        if (final_state)
+            copy_state(game_state, State(final_state));
+        initialize_state(game_state);
+        if (cache)
+            init_mask_cache(game_state, *cache);
+        init_episode_tracker_impl(game_state, tracker);
+    }
+
+    if (cache) {
+        write_action_mask(game_state, *cache, mask);
+    } else {
+        std::fill_n(mask, N_MOVES, 0);
+        set_action_mask(game_state, mask);
+    }
+    stats_count_mask(mask);
+}
+
+void step_state_limited(GameState_t game_state, episode_tracker_t& tracker, const episode_limits_t& limits,
+                        size_t move, float& reward, bool& terminated, bool& truncated, int* mask,
+                        int* final_state) {
+    step_state_limited_impl(game_state, nullptr, tracker, limits, move, reward, terminated, truncated, mask,
+                            final_state);
+}
+
+void step_state_limited(CompactGameState_t game_state, episode_tracker_t& tracker, const episode_limits_t& limits,
+                        size_t move, float& reward, bool& terminated, bool& truncated, int* mask,
+                        uint8_t* final_state) {
+    step_state_limited_impl(game_state, nullptr, tracker, limits, move, reward, terminated, truncated, mask,
+                            final_state);
+}
+
+void step_state_cached_limited(GameState_t game_state, mask_cache_t& cache, episode_tracker_t& tracker,
+                               const episode_limits_t& limits, size_t move, float& reward, bool& terminated,
+                               bool& truncated, int* mask, int* final_state) {
+    step_state_limited_impl(game_state, &cache, tracker, limits, move, reward, terminated, truncated, mask,
+                            final_state);
+}
+
+void step_state_cached_limited(CompactGameState_t game_state, mask_cache_t& cache, episode_tracker_t& tracker,
+                               const episode_limits_t& limits, size_t move, float& reward, bool& terminated,
+                               bool& truncated, int* mask, uint8_t* final_state) {
+    step_state_limited_impl(game_state, &cache, tracker, limits, move, reward, terminated, truncated, mask,
+                            final_state);
+}
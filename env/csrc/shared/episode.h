@@ -0,0 +1,55 @@
+#pragma once
+#include "board.h"
+#include "constants.h"
+#include "mask_cache.h"
+#include <cstdint>
+
+// episode limits for rollouts: a turn cap and a stall window. nothing in the rules forces a game to end (a player
+// can park pieces in its own start triangle and keep the other out of its goal forever), so weak policies can
+// play on without end. the limited steps below cut those games and report them as truncated rather than
+// terminated, so a training loop can tell "the game was decided" from "we gave up on it".
+//
+// progress is measured at the end of every turn with the mover's goal distance (see evaluation.h): a turn
+// that takes it below the lowest it has been this episode is progress. a stall is stall_turns turns in a row
+// without progress by either player.
+struct episode_limits_t {
+    int32_t max_turns = 0;    // truncate once turn_count reaches it, 0 for no cap
+    int32_t stall_turns = 0;  // truncate after this many turns without progress, 0 for no stall detection
+};
+
+// per-env bookkeeping kept next to the state, reset together with it
+struct episode_tracker_t {
+    int32_t best_distance[N_PLAYERS];
+    int32_t last_progress_turn;
+};
+
+// a batch of trackers is stored as an int32 tensor of shape (n_batch, EPISODE_TRACKER_SIZE)
+static const size_t EPISODE_TRACKER_SIZE = sizeof(episode_tracker_t) / sizeof(int32_t);
+
+void init_episode_tracker(GameState_t game_state, episode_tracker_t& tracker);
+void init_episode_tracker(CompactGameState_t game_state, episode_tracker_t& tracker);
+
+// call after update_state played a move of `player` (the current player before it) in a game that hasn't been
+// won: records progress if the move ended the turn and returns whether the limits cut the episode now
+bool track_episode(GameState_t game_state, episode_tracker_t& tracker, const episode_limits_t& limits, int player);
+bool track_episode(CompactGameState_t game_state, episode_tracker_t& tracker, const episode_limits_t& limits,
+                   int player);
+
+// step_state with the limits: terminated is step_state's done (someone won, reward +-1 for the mover), truncated
+// is a cut by the limits (reward 0). either way the game is re-initialized together with its tracker, so at
+// most one of the two is set. mask doesn't need to be cleared. when final_state isn't null, a game that ended is
+// copied there (in the same layout) before the reset, so a truncated game's last position can be bootstrapped
+// from; it's left alone otherwise
+void step_state_limited(GameState_t game_state, episode_tracker_t& tracker, const episode_limits_t& limits,
+                        size_t move, float& reward, bool& terminated, bool& truncated, int* mask,
+                        int* final_state = nullptr);
+void step_state_limited(CompactGameState_t game_state, episode_tracker_t& tracker, const episode_limits_t& limits,
+                        size_t move, float& reward, bool& terminated, bool& truncated, int* mask,
+                        uint8_t* final_state = nullptr);
+// the same with a mask cache, which is re-initialized with the game
+void step_state_cached_limited(GameState_t game_state, mask_cache_t& cache, episode_tracker_t& tracker,
+                               const episode_limits_t& limits, size_t move, float& reward, bool& terminated,
+                               bool& truncated, int* mask, int* final_state = nullptr);
+void step_state_cached_limited(CompactGameState_t game_state, mask_cache_t& cache, episode_tracker_t& tracker,
+                               const episode_limits_t& limits, size_t move, float& reward, bool& terminated,
+                               bool& truncated, int* mask, uint8_t* final_state = nullptr);
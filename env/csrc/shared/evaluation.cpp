@@ -0,0 +1,90 @@
+#include "evaluation.h"
+#include "board.h"
+#include "constants.h"
+#include "engine.h"
+#include "stats.h"
+#include <algorithm>
+
+template <typename State>
+static int goal_distance_impl(State game_state, int player) {
+    const auto& tables = evaluation_tables;
+    const auto& in_goal = tables.in_goal[player - 1];
+    // goal_cells runs from the tip, so the furthest free cell is the first one not taken by the player's own pieces
+    size_t target = 0;
+    while (target < N_PIECES_PER_PLAYER && game_state.grid[tables.goal_cells[player - 1][target]] == player) {
+        target++;
+    }
+    if (target == N_PIECES_PER_PLAYER) {
+        return 0;
+    }
+    const auto& distance = tables.goal_distance[player - 1][target];
+    int total = 0;
+    for (size_t i = 0; i < N_PIECES_PER_PLAYER; i++) {
+        int cell = game_state.piece_cell(player, i);
+        total += in_goal[cell] ? 0 : distance[cell];
+    }
+    return total;
+}
+
+template <typename State>
+static position_eval_t evaluate_state_impl(State game_state) {
+    position_eval_t result;
+    for (int player = 1; player <= (int)N_PLAYERS; player++) {
+        const auto& in_goal = evaluation_tables.in_goal[player - 1];
+        int home = 0;
+        for (size_t i = 0; i < N_PIECES_PER_PLAYER; i++) {
+            home += in_goal[game_state.piece_cell(player, i)];
+        }
+        result.distance[player - 1] = goal_distance_impl(game_state, player);
+        result.home[player - 1] = home;
+    }
+    return result;
+}
+
+position_eval_t evaluate_state(GameState_t game_state) {
+    return evaluate_state_impl(game_state);
+}
+
+position_eval_t evaluate_state(CompactGameState_t game_state) {
+    return evaluate_state_impl(game_state);
+}
+
+int goal_distance(GameState_t game_state, int player) {
+    return goal_distance_impl(game_state, player);
+}
+
+int goal_distance(CompactGameState_t game_state, int player) {
+    return goal_distance_impl(game_state, player);
+}
+
+template <typename State>
+static void step_state_shaped_impl(State game_state, size_t move, float shaping, float& reward, bool& done,
+                                   int* mask) {
+    int player = *game_state.current_player;
+    int before = goal_distance_impl(game_state, player);
+    update_state(game_state, move);
+    stats_count_move(move, *game_state.current_player == player, *game_state.winner);
+    int after = goal_distance_impl(game_state, player);
+
+    // the terminal part is step_state's
+    int winner = *game_state.winner;
+    done = winner != 0;
+    reward = (winner == 0) ? 0.0f : (winner == player ? 1.0f : -1.0f);
+    reward += shaping * (float)(before - after);
+    if (winner != 0) {
+        initialize_state(game_state);
+    }
+
+    std::fill_n(mask, N_MOVES, 0);
+    set_action_mask(game_state, mask);
+    stats_count_mask(mask);
+}
+
+void step_state_shaped(GameState_t game_state, size_t move, float shaping, float& reward, bool& done, int* mask) {
+    step_state_shaped_impl(game_state, move, shaping, reward, done, mask);
+}
+
+void step_state_shaped(CompactGameState_t game_state, size_t move, float shaping, float& reward, bool& done,
+                       int* mask) {
+    step_state_shaped_impl(game_state, move, shaping, reward, done, mask);
+}
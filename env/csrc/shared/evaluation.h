@@ -0,0 +1,64 @@
+#pragma once
+#include "board.h"
+#include "constants.h"
+#include <array>
+#include <cstdint>
+
+// heuristic position features for reward shaping, search baselines and curriculum filters. per player:
+//   distance: the sum over the pieces outside the goal triangle of their hex distance to the furthest goal cell
+//             that isn't filled by the player's own pieces yet, 0 once every piece is home
+//   home:     the number of pieces inside the goal triangle
+// the goal triangle of player 1 is player 2's start and the other way around, the same cells check_winner uses.
+
+static const size_t N_EVAL_FEATURES = 2 * N_PLAYERS;
+// columns of evaluate_batched: distance of player 1 and 2, then home of player 1 and 2
+enum eval_feature_t { EVAL_DISTANCE_1 = 0, EVAL_DISTANCE_2, EVAL_HOME_1, EVAL_HOME_2 };
+
+struct evaluation_tables_t {
+    // goal_cells[p][k]: player p + 1's goal cells, the tip first and then by distance from it, which is the
+    // order they fill up in
+    std::array<std::array<int, N_PIECES_PER_PLAYER>, N_PLAYERS> goal_cells;
+    // goal_distance[p][k][cell]: hex distance from cell to goal_cells[p][k]
+    std::array<std::array<std::array<uint8_t, NUM_CELLS>, N_PIECES_PER_PLAYER>, N_PLAYERS> goal_distance;
+    // in_goal[p][cell]: cell is in player p + 1's goal triangle
+    std::array<std::array<uint8_t, NUM_CELLS>, N_PLAYERS> in_goal;
+};
+
+constexpr evaluation_tables_t make_evaluation_tables() {
+    evaluation_tables_t t{};
+    for (size_t k = 0; k < N_PIECES_PER_PLAYER; k++) {
+        // player_1_start and player_2_start are listed from their tips
+        t.goal_cells[0][k] = player_2_start[k][0] * COLS + player_2_start[k][1];
+        t.goal_cells[1][k] = player_1_start[k][0] * COLS + player_1_start[k][1];
+    }
+    for (size_t p = 0; p < N_PLAYERS; p++) {
+        for (size_t k = 0; k < N_PIECES_PER_PLAYER; k++) {
+            int goal = t.goal_cells[p][k];
+            t.in_goal[p][goal] = 1;
+            for (int cell = 0; cell < (int)NUM_CELLS; cell++) {
+                t.goal_distance[p][k][cell] = (uint8_t)hex_distance(cell, goal);
+            }
+        }
+    }
+    return t;
+}
+
+static constexpr evaluation_tables_t evaluation_tables = make_evaluation_tables();
+
+struct position_eval_t {
+    int distance[N_PLAYERS];
+    int home[N_PLAYERS];
+};
+
+position_eval_t evaluate_state(GameState_t game_state);
+position_eval_t evaluate_state(CompactGameState_t game_state);
+// the distance feature of one player (1 or 2)
+int goal_distance(GameState_t game_state, int player);
+int goal_distance(CompactGameState_t game_state, int player);
+
+// step_state with a potential-based shaping term: the mover's reward gets shaping * (its distance before the
+// move - its distance after it) on top of the +-1 for a win. the terms telescope over a game, so with undiscounted
+// returns the shaping doesn't change which policies are best. mask doesn't need to be cleared
+void step_state_shaped(GameState_t game_state, size_t move, float shaping, float& reward, bool& done, int* mask);
+void step_state_shaped(CompactGameState_t game_state, size_t move, float shaping, float& reward, bool& done,
+                       int* mask);
@@ -0,0 +1,272 @@
+#include "game_log.h"
+#include "board.h"
+#include "constants.h"
+#include "engine.h"
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const size_t WRITE_BUFFER_SIZE = 1 << 20;
+
+static game_log_header_t make_header() {
+    game_log_header_t header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, GAME_LOG_MAGIC, sizeof(header.magic));
+    header.version = GAME_LOG_VERSION;
+    header.header_size = sizeof(game_log_header_t);
+    return header;
+}
+
+GameLogWriter_t::GameLogWriter_t(const std::string& path) : file(std::fopen(path.c_str(), "wb")) {
+    if (!file) {
+        throw std::runtime_error("could not open game log for writing: " + path);
+    }
+    buffer.reserve(WRITE_BUFFER_SIZE);
+    game_offsets.push_back(0);
+    // the unfinalized header, see game_log.h
+    auto header = make_header();
+    if (std::fwrite(&header, sizeof(header), 1, file) != 1) {
+        throw std::runtime_error("could not write game log header: " + path);
+    }
+}
+
+GameLogWriter_t::~GameLogWriter_t() {
+    try {
+        close();
+    } catch (const std::exception&) {
+        // nothing sensible to do from a destructor, the log stays readable as a single game
+    }
+}
+
+bool GameLogWriter_t::flush() {
+    bool ok = buffer.empty() || std::fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+    buffer.clear();
+    return ok;
+}
+
+void GameLogWriter_t::begin_game() {
+    // an empty game in progress is reused rather than recorded
+    if (game_offsets.back() != action_count) {
+        game_offsets.push_back(action_count);
+    }
+}
+
+void GameLogWriter_t::write_action(int action) {
+    buffer.push_back((uint8_t)action);
+    action_count++;
+    if (buffer.size() >= WRITE_BUFFER_SIZE && !flush()) {
+        throw std::runtime_error("could not write game log actions");
+    }
+}
+
+void GameLogWriter_t::close() {
+    if (!file) {
+        return;
+    }
+    bool ok = flush();
+    if (game_offsets.back() != action_count) {
+        game_offsets.push_back(action_count);
+    }
+    auto header = make_header();
+    header.n_actions = action_count;
+    header.n_games = game_offsets.size() - 1;
+    header.index_offset = (sizeof(header) + action_count + 7) & ~(uint64_t)7;
+    header.flags = GAME_LOG_FINALIZED;
+    static const uint8_t padding[8] = {0};
+    size_t n_padding = header.index_offset - sizeof(header) - action_count;
+    ok = ok && std::fwrite(padding, 1, n_padding, file) == n_padding;
+    ok = ok && std::fwrite(game_offsets.data(), sizeof(uint64_t), game_offsets.size(), file) == game_offsets.size();
+    ok = ok && std::fseek(file, 0, SEEK_SET) == 0;
+    ok = ok && std::fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = (std::fclose(file) == 0) && ok;
+    file = nullptr;
+    if (!ok) {
+        throw std::runtime_error("could not finalize game log");
+    }
+}
+
+GameLogReader_t::GameLogReader_t(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("could not open game log: " + path);
+    }
+    struct stat info;
+    if (::fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(game_log_header_t)) {
+        ::close(fd);
+        throw std::runtime_error("not a game log: " + path);
+    }
+    mapping_size = info.st_size;
+    mapping = ::mmap(nullptr, mapping_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        mapping = nullptr;
+        throw std::runtime_error("could not map game log: " + path);
+    }
+
+    game_log_header_t header;
+    std::memcpy(&header, mapping, sizeof(header));
+    auto fail = [&](const std::string& reason) {
+        ::munmap(mapping, mapping_size);
+        mapping = nullptr;
+        throw std::runtime_error(reason + ": " + path);
+    };
+    if (std::memcmp(header.magic, GAME_LOG_MAGIC, sizeof(header.magic)) != 0) {
+        fail("not a game log");
+    }
+    if (header.version != GAME_LOG_VERSION) {
+        fail("unsupported game log version " + std::to_string(header.version));
+    }
+    if (header.header_size < sizeof(header) || header.header_size > mapping_size) {
+        fail("corrupt game log header");
+    }
+
+    auto base = (const uint8_t*)mapping;
+    action_data = base + header.header_size;
+    if (!(header.flags & GAME_LOG_FINALIZED)) {
+        // the writer never finished, everything after the header is one game
+        action_count = mapping_size - header.header_size;
+        game_offsets = {0, action_count};
+        return;
+    }
+    uint64_t index_size = (header.n_games + 1) * sizeof(uint64_t);
+    if (header.n_actions > mapping_size - header.header_size || header.index_offset > mapping_size ||
+        index_size > mapping_size - header.index_offset) {
+        fail("truncated game log");
+    }
+    action_count = header.n_actions;
+    game_offsets.resize(header.n_games + 1);
+    std::memcpy(game_offsets.data(), base + header.index_offset, index_size);
+    for (uint64_t g = 0; g < header.n_games; g++) {
+        if (game_offsets[g] > game_offsets[g + 1]) {
+            fail("corrupt game log index");
+        }
+    }
+    if (game_offsets.front() != 0 || game_offsets.back() != action_count) {
+        fail("corrupt game log index");
+    }
+}
+
+GameLogReader_t::~GameLogReader_t() {
+    if (mapping) {
+        ::munmap(mapping, mapping_size);
+    }
+}
+
+bool is_game_log(const std::string& path) {
+    char magic[sizeof(GAME_LOG_MAGIC)];
+    std::ifstream in(path, std::ios::binary);
+    return in.read(magic, sizeof(magic)) && std::memcmp(magic, GAME_LOG_MAGIC, sizeof(magic)) == 0;
+}
+
+std::string format_move_text(int player, int action) {
+    if (action == (int)N_MOVES - 1) {
+        return "PLAYER " + std::to_string(player) + " MOVE: END TURN";
+    }
+    return "PLAYER " + std::to_string(player) + " MOVE: " + std::to_string(action / N_DIRECTIONS) + " " +
+           std::to_string(action % N_DIRECTIONS);
+}
+
+int parse_move_text(const std::string& line) {
+    std::istringstream iss(line);
+    std::string player_token, player, move_token, first, second;
+    if (!(iss >> player_token >> player >> move_token >> first >> second)) {
+        return -1;
+    }
+    if (player_token != "PLAYER" || move_token != "MOVE:") {
+        return -1;
+    }
+    if (first == "END" && second == "TURN") {
+        return N_MOVES - 1;
+    }
+    try {
+        int piece = std::stoi(first);
+        int direction = std::stoi(second);
+        if (piece < 0 || piece >= (int)N_PIECES_PER_PLAYER || direction < 0 || direction >= (int)N_DIRECTIONS) {
+            return -1;
+        }
+        return piece * N_DIRECTIONS + direction;
+    } catch (const std::exception&) {
+        return -1;
+    }
+}
+
+bool is_game_separator_text(const std::string& line) {
+    return line.rfind("GAME ", 0) == 0;
+}
+
+// replays one game and checks every action against the mask, calls fn(player, action) before applying it
+template <typename F>
+static void replay_game(const uint8_t* actions, uint64_t n_actions, const F& fn) {
+    std::vector<int> state(TOTAL_STATE);
+    GameState_t game_state(state.data());
+    initialize_state(game_state);
+    int mask[N_MOVES];
+    for (uint64_t k = 0; k < n_actions; k++) {
+        std::fill_n(mask, N_MOVES, 0);
+        set_action_mask(game_state, mask);
+        if (actions[k] >= N_MOVES || !mask[actions[k]]) {
+            throw std::runtime_error("illegal move " + std::to_string(actions[k]) + " at action " + std::to_string(k));
+        }
+        fn(*game_state.current_player, (int)actions[k]);
+        update_state(game_state, actions[k]);
+    }
+}
+
+void game_log_from_text(const std::string& text_path, const std::string& log_path) {
+    std::ifstream in(text_path);
+    if (!in.is_open()) {
+        throw std::runtime_error("could not open text log: " + text_path);
+    }
+    std::vector<uint8_t> game;
+    GameLogWriter_t writer(log_path);
+    auto write_game = [&]() {
+        replay_game(game.data(), game.size(), [](int, int) {});
+        writer.begin_game();
+        for (auto action : game) {
+            writer.write_action(action);
+        }
+        game.clear();
+    };
+    std::string line;
+    size_t line_number = 0;
+    while (std::getline(in, line)) {
+        line_number++;
+        if (line.empty()) {
+            continue;
+        }
+        if (is_game_separator_text(line)) {
+            write_game();
+            continue;
+        }
+        int action = parse_move_text(line);
+        if (action < 0) {
+            throw std::runtime_error("invalid move at line " + std::to_string(line_number) + ": " + line);
+        }
+        game.push_back(action);
+    }
+    write_game();
+    writer.close();
+}
+
+void game_log_to_text(const std::string& log_path, const std::string& text_path) {
+    GameLogReader_t reader(log_path);
+    std::ofstream out(text_path);
+    if (!out.is_open()) {
+        throw std::runtime_error("could not open text log for writing: " + text_path);
+    }
+    for (uint64_t g = 0; g < reader.n_games(); g++) {
+        if (g > 0) {
+            out << "GAME " << g << "\n";
+        }
+        replay_game(reader.actions() + reader.game_begin(g), reader.game_end(g) - reader.game_begin(g),
+                    [&](int player, int action) { out << format_move_text(player, action) << "\n"; });
+    }
+    if (!out.good()) {
+        throw std::runtime_error("could not write text log: " + text_path);
+    }
+}
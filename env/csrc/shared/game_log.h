@@ -0,0 +1,104 @@
+#pragma once
+#include "constants.h"
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// binary game log: a fixed header, one byte per sub-move action (the N_MOVES index, END TURN included),
+// then the game index, n_games + 1 uint64 action offsets where game g is [offsets[g], offsets[g + 1]).
+// the player of each action isn't stored, it comes from replaying the game from the start position.
+//
+// the writer streams actions and patches the header when it's closed, setting GAME_LOG_FINALIZED in the
+// flags. a log whose writer never got there still reads as a single game holding every action after the
+// header, a finalized log can hold zero games.
+static const char GAME_LOG_MAGIC[8] = {'C', 'C', 'G', 'L', 'O', 'G', '\0', '\0'};
+static const uint32_t GAME_LOG_VERSION = 2;
+static const uint64_t GAME_LOG_FINALIZED = 1;
+
+struct game_log_header_t {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t n_actions;
+    uint64_t n_games;
+    // byte offset of the game index, 8-byte aligned
+    uint64_t index_offset;
+    uint64_t flags;
+};
+static_assert(sizeof(game_log_header_t) == 48, "game log header must stay 48 bytes");
+
+class GameLogWriter_t {
+public:
+    // throws std::runtime_error if the file can't be opened
+    explicit GameLogWriter_t(const std::string& path);
+    ~GameLogWriter_t();
+    // owns the file, a copy would close it twice
+    GameLogWriter_t(const GameLogWriter_t&) = delete;
+    GameLogWriter_t& operator=(const GameLogWriter_t&) = delete;
+
+    // every action after this belongs to a new game. the first game starts implicitly
+    void begin_game();
+    void write_action(int action);
+    // writes the game index and the final header, called by the destructor if needed
+    void close();
+
+    uint64_t n_actions() const {
+        return action_count;
+    }
+
+private:
+    bool flush();
+
+    FILE* file;
+    std::vector<uint8_t> buffer;
+    std::vector<uint64_t> game_offsets;
+    uint64_t action_count = 0;
+};
+
+// read-only memory map of a log, the actions are used in place
+class GameLogReader_t {
+public:
+    // throws std::runtime_error if the file can't be mapped or isn't a valid log
+    explicit GameLogReader_t(const std::string& path);
+    ~GameLogReader_t();
+    GameLogReader_t(const GameLogReader_t&) = delete;
+    GameLogReader_t& operator=(const GameLogReader_t&) = delete;
+
+    uint64_t n_games() const {
+        return game_offsets.size() - 1;
+    }
+    uint64_t n_actions() const {
+        return action_count;
+    }
+    const uint8_t* actions() const {
+        return action_data;
+    }
+    uint64_t game_begin(uint64_t game) const {
+        return game_offsets[game];
+    }
+    uint64_t game_end(uint64_t game) const {
+        return game_offsets[game + 1];
+    }
+
+private:
+    void* mapping = nullptr;
+    size_t mapping_size = 0;
+    const uint8_t* action_data = nullptr;
+    uint64_t action_count = 0;
+    std::vector<uint64_t> game_offsets;
+};
+
+// true if the file starts with GAME_LOG_MAGIC
+bool is_game_log(const std::string& path);
+
+// the text format is one sub-move per line, "PLAYER <p> MOVE: <piece> <direction>" or
+// "PLAYER <p> MOVE: END TURN", with a "GAME <g>" line in front of every game after the first
+std::string format_move_text(int player, int action);
+// returns the action of a move line, -1 for anything else
+int parse_move_text(const std::string& line);
+bool is_game_separator_text(const std::string& line);
+
+// conversions between the two formats, both throw std::runtime_error on I/O errors or illegal moves
+void game_log_from_text(const std::string& text_path, const std::string& log_path);
+void game_log_to_text(const std::string& log_path, const std::string& text_path);
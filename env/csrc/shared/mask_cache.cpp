@@ -0,0 +1,213 @@
+#include "mask_cache.h"
+#include "board.h"
+#include "constants.h"
+#include "engine.h"
+#include "stats.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#ifdef NDEBUG
+static std::atomic<bool> mask_cache_verify{false};
+#else
+static std::atomic<bool> mask_cache_verify{true};
+#endif
+
+void set_mask_cache_verify(bool verify) {
+    mask_cache_verify.store(verify);
+}
+
+bool get_mask_cache_verify() {
+    return mask_cache_verify.load(std::memory_order_relaxed);
+}
+
+// branch-free: which cells are occupied is close to random, so branches here mispredict a lot. an off-board
+// target is read as the piece's own cell, which is always occupied
+template <typename State>
+static inline int8_t compute_move_kind(State game_state, int cell, int direction) {
+    int one_step = step_targets[cell][direction];
+    int two_step = jump_targets[cell][direction];
+    int one_occupied = game_state.occupied(one_step != OFF_BOARD ? one_step : cell);
+    int two_free = !game_state.occupied(two_step != OFF_BOARD ? two_step : cell);
+    return (int8_t)((one_step != OFF_BOARD) * (MOVE_STEP + one_occupied * (MOVE_JUMP * two_free - MOVE_STEP)));
+}
+
+template <typename State>
+static void init_mask_cache_impl(State game_state, mask_cache_t& cache) {
+    std::memset(&cache, 0, sizeof(cache));
+    std::fill_n(cache.kinds_at, NUM_CELLS, (uint8_t)MASK_CACHE_SCRATCH);
+    for (int player = 1; player <= (int)N_PLAYERS; player++) {
+        for (int i = 0; i < (int)N_PIECES_PER_PLAYER; i++) {
+            int cell = game_state.piece_cell(player, i);
+            int offset = (player - 1) * MASK_CACHE_PLAYER_KINDS + i * N_DIRECTIONS;
+            cache.kinds_at[cell] = (uint8_t)offset;
+            for (int d = 0; d < (int)N_DIRECTIONS; d++) {
+                cache.move_kind[offset + d] = compute_move_kind(game_state, cell, d);
+            }
+        }
+    }
+}
+
+void init_mask_cache(GameState_t game_state, mask_cache_t& cache) {
+    init_mask_cache_impl(game_state, cache);
+}
+
+void init_mask_cache(CompactGameState_t game_state, mask_cache_t& cache) {
+    init_mask_cache_impl(game_state, cache);
+}
+
+// the occupancy of `cell` changed: only the moves that step or jump onto it can change. the piece stepping onto
+// cell in direction d sits one step away in the reverse direction (the "near" piece), the one jumping onto it two
+// steps away (the "far" piece), and the near cell is the far piece's middle cell. that's enough to write the new
+// kinds with at most one more grid read. branch-free like compute_move_kind: an empty cell's kinds_at points at
+// the scratch entries, and an off-board origin reads cell 0, which is never playable and so never holds a piece
+static inline int8_t* cached_kind(mask_cache_t& cache, int origin, int direction) {
+    return &cache.move_kind[cache.kinds_at[origin] + direction];
+}
+
+// cell was emptied: the near piece can step onto it, the far one jumps if there's a piece in between and
+// otherwise steps to the middle cell as before
+template <typename State>
+static inline void refresh_vacated(State game_state, mask_cache_t& cache, int cell) {
+    for (int d = 0; d < (int)N_DIRECTIONS; d++) {
+        int reverse = (d + 3) % N_DIRECTIONS;
+        int near = step_targets[cell][reverse];
+        int far = jump_targets[cell][reverse];
+        near = (near != OFF_BOARD) ? near : 0;
+        far = (far != OFF_BOARD) ? far : 0;
+        *cached_kind(cache, near, d) = MOVE_STEP;
+        *cached_kind(cache, far, d) = game_state.occupied(near) ? MOVE_JUMP : MOVE_STEP;
+    }
+}
+
+// cell was filled: the near piece can now only jump over it, the far one loses its jump and still steps to an
+// empty middle cell
+template <typename State>
+static inline void refresh_filled(State game_state, mask_cache_t& cache, int cell) {
+    for (int d = 0; d < (int)N_DIRECTIONS; d++) {
+        int reverse = (d + 3) % N_DIRECTIONS;
+        int near = step_targets[cell][reverse];
+        int far = jump_targets[cell][reverse];
+        int landing = step_targets[cell][d];
+        near = (near != OFF_BOARD) ? near : 0;
+        far = (far != OFF_BOARD) ? far : 0;
+        int landing_free = landing != OFF_BOARD && !game_state.occupied(landing != OFF_BOARD ? landing : cell);
+        *cached_kind(cache, near, d) = landing_free ? MOVE_JUMP : MOVE_NONE;
+        *cached_kind(cache, far, d) = game_state.occupied(near) ? MOVE_NONE : MOVE_STEP;
+    }
+}
+
+template <typename State>
+static void write_action_mask_impl(State game_state, const mask_cache_t& cache, int* dest) {
+    int player = *game_state.current_player;
+    int last_skipped_piece = *game_state.last_skipped_piece;
+    const int8_t* kinds = cache.move_kind + (player - 1) * MASK_CACHE_PLAYER_KINDS;
+    if (last_skipped_piece == -1) {
+        for (int m = 0; m < (int)(N_MOVES - 1); m++) {
+            dest[m] = kinds[m] != MOVE_NONE;
+        }
+        dest[N_MOVES - 1] = 0;
+        return;
+    }
+
+    // mid-hop: only further jumps of the hopping piece, never straight back, or END TURN
+    std::fill_n(dest, N_MOVES, 0);
+    int last_direction = *game_state.last_direction;
+    for (int d = 0; d < (int)N_DIRECTIONS; d++) {
+        int m = last_skipped_piece * N_DIRECTIONS + d;
+        if (kinds[m] == MOVE_JUMP && ((last_direction - d + N_DIRECTIONS) % N_DIRECTIONS) != 3) {
+            dest[m] = 1;
+        }
+    }
+    dest[N_MOVES - 1] = 1;
+}
+
+void write_action_mask(GameState_t game_state, const mask_cache_t& cache, int* dest) {
+    write_action_mask_impl(game_state, cache, dest);
+    stats_count_call(KERNEL_WRITE_ACTION_MASK);
+}
+
+void write_action_mask(CompactGameState_t game_state, const mask_cache_t& cache, int* dest) {
+    write_action_mask_impl(game_state, cache, dest);
+    stats_count_call(KERNEL_WRITE_ACTION_MASK);
+}
+
+template <typename State>
+static void verify_mask_cache(State game_state, const mask_cache_t& cache, size_t move) {
+    mask_cache_t expected;
+    init_mask_cache(game_state, expected);
+    std::copy_n(cache.move_kind + MASK_CACHE_SCRATCH, N_DIRECTIONS, expected.move_kind + MASK_CACHE_SCRATCH);
+    int cached_mask[N_MOVES];
+    int full_mask[N_MOVES] = {0};
+    write_action_mask_impl(game_state, cache, cached_mask);
+    set_action_mask(game_state, full_mask);
+    if (std::memcmp(&expected, &cache, sizeof(cache)) != 0 || std::memcmp(cached_mask, full_mask, sizeof(full_mask))) {
+        throw std::logic_error("incremental action mask diverged from set_action_mask after move " +
+                               std::to_string(move));
+    }
+}
+
+template <typename State>
+static void update_state_cached_impl(State game_state, mask_cache_t& cache, size_t move) {
+    if (move != N_MOVES - 1) {
+        int player = *game_state.current_player;
+        int piece_num = move / N_DIRECTIONS;
+        int from = game_state.piece_cell(player, piece_num);
+        update_state(game_state, move);
+        int to = game_state.piece_cell(player, piece_num);
+
+        int offset = cache.kinds_at[from];
+        cache.kinds_at[from] = (uint8_t)MASK_CACHE_SCRATCH;
+        cache.kinds_at[to] = (uint8_t)offset;
+        refresh_vacated(game_state, cache, from);
+        refresh_filled(game_state, cache, to);
+        for (int d = 0; d < (int)N_DIRECTIONS; d++) {
+            cache.move_kind[offset + d] = compute_move_kind(game_state, to, d);
+        }
+    } else {
+        // END TURN doesn't move anything
+        update_state(game_state, move);
+    }
+    if (get_mask_cache_verify()) {
+        verify_mask_cache(game_state, cache, move);
+    }
+}
+
+void update_state_cached(GameState_t game_state, mask_cache_t& cache, size_t move) {
+    update_state_cached_impl(game_state, cache, move);
+}
+
+void update_state_cached(CompactGameState_t game_state, mask_cache_t& cache, size_t move) {
+    update_state_cached_impl(game_state, cache, move);
+}
+
+template <typename State>
+static void step_state_cached_impl(State game_state, mask_cache_t& cache, size_t move, float& reward, bool& done,
+                                   int* mask) {
+    int player = *game_state.current_player;
+    update_state_cached(game_state, cache, move);
+    stats_count_move(move, *game_state.current_player == player, *game_state.winner);
+
+    // the reward is from the point of view of the player that just moved, like step_state
+    int winner = *game_state.winner;
+    done = winner != 0;
+    reward = (winner == 0) ? 0.0f : (winner == player ? 1.0f : -1.0f);
+    if (winner != 0) {
+        initialize_state(game_state);
+        init_mask_cache(game_state, cache);
+    }
+    write_action_mask(game_state, cache, mask);
+    stats_count_mask(mask);
+}
+
+void step_state_cached(GameState_t game_state, mask_cache_t& cache, size_t move, float& reward, bool& done,
+                       int* mask) {
+    step_state_cached_impl(game_state, cache, move, reward, done, mask);
+}
+
+void step_state_cached(CompactGameState_t game_state, mask_cache_t& cache, size_t move, float& reward, bool& done,
+                       int* mask) {
+    step_state_cached_impl(game_state, cache, move, reward, done, mask);
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include "board.h"
+#include "constants.h"
+#include <cstdint>
+
+// incremental action masks: the legality of every (piece, direction) of both players is kept next to the
+// state and a move only recomputes the entries whose step or jump line goes through the two cells it
+// changed, plus the 6 directions of the piece that moved. the skip-chain restrictions (only the hopping
+// piece, only jumps, never straight back, END TURN) are applied when the mask is written out.
+enum move_kind_t : int8_t { MOVE_NONE = 0, MOVE_STEP = 1, MOVE_JUMP = 2 };
+
+// move_kind entries per player, the scratch entries start after the last player's
+static const size_t MASK_CACHE_PLAYER_KINDS = N_PIECES_PER_PLAYER * N_DIRECTIONS;
+static const size_t MASK_CACHE_SCRATCH = N_PLAYERS * MASK_CACHE_PLAYER_KINDS;
+
+struct mask_cache_t {
+    // move_kind_t of move piece * N_DIRECTIONS + direction of player p + 1 at p * MASK_CACHE_PLAYER_KINDS + move,
+    // then N_DIRECTIONS scratch entries the branch-free updates write to when a cell is empty
+    int8_t move_kind[MASK_CACHE_SCRATCH + N_DIRECTIONS];
+    // offset in move_kind of the directions of the piece on a cell, MASK_CACHE_SCRATCH if there is none
+    uint8_t kinds_at[NUM_CELLS];
+    int8_t padding[(8 - (MASK_CACHE_SCRATCH + N_DIRECTIONS + NUM_CELLS) % 8) % 8];
+};
+
+// a batch of caches is stored as a uint8 tensor of shape (n_batch, MASK_CACHE_SIZE)
+static const size_t MASK_CACHE_SIZE = sizeof(mask_cache_t);
+static_assert(MASK_CACHE_SIZE % 8 == 0, "mask_cache_t must pack into 8-byte rows");
+
+void init_mask_cache(GameState_t game_state, mask_cache_t& cache);
+void init_mask_cache(CompactGameState_t game_state, mask_cache_t& cache);
+
+// update_state plus the cache maintenance, the move must be legal
+void update_state_cached(GameState_t game_state, mask_cache_t& cache, size_t move);
+void update_state_cached(CompactGameState_t game_state, mask_cache_t& cache, size_t move);
+
+// the N_MOVES entries of set_action_mask, every entry is written so dest doesn't need to be cleared
+void write_action_mask(GameState_t game_state, const mask_cache_t& cache, int* dest);
+void write_action_mask(CompactGameState_t game_state, const mask_cache_t& cache, int* dest);
+
+// step_state with the cache: a finished game is re-initialized together with its cache
+void step_state_cached(GameState_t game_state, mask_cache_t& cache, size_t move, float& reward, bool& done, int* mask);
+void step_state_cached(CompactGameState_t game_state, mask_cache_t& cache, size_t move, float& reward, bool& done,
+                       int* mask);
+
+// debug check: when enabled (the default in builds without NDEBUG) every cached update rebuilds the cache and
+// the mask from scratch and throws std::logic_error if they differ from the incremental ones
+void set_mask_cache_verify(bool verify);
+bool get_mask_cache_verify();
@@ -0,0 +1,226 @@
+#include "mcts.h"
+#include "board.h"
+#include "constants.h"
+#include "engine.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+MCTS_t::MCTS_t(const mcts_config_t& config) : config(config) {}
+
+static inline void reset_node(mcts_node_t& node, int move, float prior) {
+    node.first_child = -1;
+    node.n_children = 0;
+    node.move = move;
+    node.pending = 0;
+    node.terminal = 0;
+    node.visit_count = 0;
+    node.virtual_visits = 0;
+    node.value_sum = 0.0f;
+    node.prior = prior;
+}
+
+// walks down from the root with PUCT, replaying the moves on descent.state. returns false if the
+// leaf is already waiting for the evaluator, in which case nothing was changed
+bool MCTS_t::descend(tree_t& tree, const int* root_state, descent_t& descent) {
+    descent.path.clear();
+    descent.movers.clear();
+    std::copy(root_state, root_state + TOTAL_STATE, descent.state.begin());
+    GameState_t game_state(descent.state.data());
+
+    int node = 0;
+    descent.path.push_back(0);
+    descent.movers.push_back(0);
+    while (tree.nodes[node].first_child != -1 && !tree.nodes[node].terminal && *game_state.winner == 0) {
+        const auto& parent = tree.nodes[node];
+        float sqrt_visits = std::sqrt((float)(parent.visit_count + parent.virtual_visits));
+        int best = -1;
+        float best_score = -std::numeric_limits<float>::infinity();
+        for (int c = parent.first_child; c < parent.first_child + parent.n_children; c++) {
+            const auto& child = tree.nodes[c];
+            int visits = child.visit_count + child.virtual_visits;
+            float q = 0.0f;
+            if (visits > 0) {
+                q = (child.value_sum - config.virtual_loss * child.virtual_visits) / visits;
+            }
+            float score = q + config.c_puct * child.prior * sqrt_visits / (1 + visits);
+            if (score > best_score) {
+                best_score = score;
+                best = c;
+            }
+        }
+        descent.movers.push_back(*game_state.current_player);
+        update_state(game_state, tree.nodes[best].move);
+        descent.path.push_back(best);
+        node = best;
+    }
+
+    if (tree.nodes[node].pending) {
+        return false;
+    }
+    descent.leaf_player = *game_state.current_player;
+    for (auto k : descent.path) {
+        tree.nodes[k].virtual_visits++;
+    }
+    return true;
+}
+
+void MCTS_t::expand(tree_t& tree, int node, const int* mask, const float* priors) {
+    int n_children = 0;
+    float total = 0.0f;
+    for (size_t m = 0; m < N_MOVES; m++) {
+        if (mask[m]) {
+            n_children++;
+            total += std::max(priors[m], 0.0f);
+        }
+    }
+    // a node without children stays a leaf: descend never enters it
+    if (n_children == 0 || tree.n_nodes + n_children > config.max_nodes) {
+        return;
+    }
+    // priors that are all zero (or garbage) fall back to uniform
+    bool uniform = !(total > 0.0f) || !std::isfinite(total);
+
+    auto& parent = tree.nodes[node];
+    parent.first_child = tree.n_nodes;
+    parent.n_children = n_children;
+    for (size_t m = 0; m < N_MOVES; m++) {
+        if (mask[m]) {
+            float prior = uniform ? 1.0f / n_children : std::max(priors[m], 0.0f) / total;
+            reset_node(tree.nodes[tree.n_nodes++], m, prior);
+        }
+    }
+}
+
+// value is for the player to move at the leaf, so it counts positively for the nodes that player moved into
+void MCTS_t::backup(tree_t& tree, const descent_t& descent, float value) {
+    for (size_t k = 0; k < descent.path.size(); k++) {
+        auto& node = tree.nodes[descent.path[k]];
+        node.virtual_visits--;
+        node.visit_count++;
+        if (k > 0) {
+            node.value_sum += (descent.movers[k] == descent.leaf_player) ? value : -value;
+        }
+    }
+    tree.nodes[descent.path.back()].pending = 0;
+    tree.n_done++;
+}
+
+void MCTS_t::search(const int* root_states, int n_roots, const leaf_evaluator_t& evaluate, float* visit_counts,
+                    float* root_values) {
+    trees.resize(n_roots);
+    for (auto& tree : trees) {
+        if ((int)tree.nodes.size() < config.max_nodes) {
+            tree.nodes.resize(config.max_nodes);
+        }
+        reset_node(tree.nodes[0], -1, 1.0f);
+        tree.n_nodes = 1;
+        tree.n_done = 0;
+        tree.descents.resize(config.leaves_per_tree);
+        for (auto& descent : tree.descents) {
+            descent.state.resize(TOTAL_STATE);
+        }
+    }
+
+    std::vector<int> leaf_offsets(n_roots + 1);
+    std::vector<int> batch_states;
+    std::vector<int> batch_masks;
+    std::vector<float> batch_priors;
+    std::vector<float> batch_values;
+    while (true) {
+        // descents only touch their own tree, so the trees are walked in parallel
+        parallel_for_batch(n_roots, [&](int64_t i) {
+            auto& tree = trees[i];
+            tree.n_descents = 0;
+            int budget = std::min(config.leaves_per_tree, config.n_simulations - tree.n_done);
+            for (int k = 0; k < budget; k++) {
+                auto& descent = tree.descents[tree.n_descents];
+                if (!descend(tree, root_states + i * TOTAL_STATE, descent)) {
+                    // the best leaf is already queued, the next round will see its value
+                    break;
+                }
+                GameState_t game_state(descent.state.data());
+                if (*game_state.winner != 0) {
+                    backup(tree, descent, (*game_state.winner == *game_state.current_player) ? 1.0f : -1.0f);
+                    continue;
+                }
+                auto& leaf = tree.nodes[descent.path.back()];
+                if (!leaf.terminal) {
+                    std::fill_n(descent.mask, N_MOVES, 0);
+                    set_action_mask(game_state, descent.mask);
+                    leaf.terminal = std::none_of(descent.mask, descent.mask + N_MOVES, [](int m) { return m != 0; });
+                }
+                if (leaf.terminal) {
+                    // nobody has won and the player to move is stuck, so it's scored as a draw
+                    backup(tree, descent, 0.0f);
+                    continue;
+                }
+                leaf.pending = 1;
+                tree.n_descents++;
+            }
+        });
+
+        bool finished = true;
+        for (int i = 0; i < n_roots; i++) {
+            leaf_offsets[i + 1] = leaf_offsets[i] + trees[i].n_descents;
+            finished &= trees[i].n_done >= config.n_simulations;
+        }
+        int n_leaves = leaf_offsets[n_roots];
+        if (n_leaves == 0) {
+            if (finished) {
+                break;
+            }
+            // only terminal leaves this round
+            continue;
+        }
+
+        batch_states.resize((size_t)n_leaves * TOTAL_STATE);
+        batch_masks.resize((size_t)n_leaves * N_MOVES);
+        batch_priors.resize((size_t)n_leaves * N_MOVES);
+        batch_values.resize(n_leaves);
+        for (int i = 0; i < n_roots; i++) {
+            for (int k = 0; k < trees[i].n_descents; k++) {
+                const auto& descent = trees[i].descents[k];
+                size_t leaf = leaf_offsets[i] + k;
+                std::copy(descent.state.begin(), descent.state.end(), batch_states.begin() + leaf * TOTAL_STATE);
+                std::copy(descent.mask, descent.mask + N_MOVES, batch_masks.begin() + leaf * N_MOVES);
+            }
+        }
+
+        evaluate(batch_states.data(), batch_masks.data(), n_leaves, batch_priors.data(), batch_values.data());
+
+        parallel_for_batch(n_roots, [&](int64_t i) {
+            auto& tree = trees[i];
+            for (int k = 0; k < tree.n_descents; k++) {
+                const auto& descent = tree.descents[k];
+                size_t leaf = leaf_offsets[i] + k;
+                expand(tree, descent.path.back(), descent.mask, batch_priors.data() + leaf * N_MOVES);
+                backup(tree, descent, std::clamp(batch_values[leaf], -1.0f, 1.0f));
+            }
+        });
+    }
+
+    for (int i = 0; i < n_roots; i++) {
+        const auto& tree = trees[i];
+        const auto& root = tree.nodes[0];
+        auto counts = visit_counts + (size_t)i * N_MOVES;
+        std::fill_n(counts, N_MOVES, 0.0f);
+        float value_sum = 0.0f;
+        int visits = 0;
+        for (int c = root.first_child; c < root.first_child + root.n_children; c++) {
+            counts[tree.nodes[c].move] = tree.nodes[c].visit_count;
+            value_sum += tree.nodes[c].value_sum;
+            visits += tree.nodes[c].visit_count;
+        }
+        // children values are for the player who moved from the root, i.e. the root's player to move
+        root_values[i] = (visits > 0) ? value_sum / visits : 0.0f;
+    }
+}
+
+std::vector<int> MCTS_t::tree_sizes() const {
+    std::vector<int> sizes;
+    for (const auto& tree : trees) {
+        sizes.push_back(tree.n_nodes);
+    }
+    return sizes;
+}
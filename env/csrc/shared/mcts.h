@@ -0,0 +1,88 @@
+#pragma once
+#include "board.h"
+#include "constants.h"
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// batched PUCT search over the sub-move action space (N_MOVES), one tree per root state. every round
+// each tree descends up to leaves_per_tree times, with virtual loss spreading the descents over different
+// leaves, then the leaves of all the trees go to the evaluator in a single batch.
+//
+// the evaluator gets n_leaves int32 states (TOTAL_STATE each) and their action masks (N_MOVES each) and
+// writes priors (N_MOVES per leaf, any non-negative weights, illegal moves are ignored and the rest is
+// renormalized) and values (one per leaf, in [-1, 1] for the player to move in that leaf). won positions
+// and positions without a legal move are scored by the search and never reach the evaluator.
+typedef std::function<void(const int* states, const int* masks, int n_leaves, float* priors, float* values)>
+    leaf_evaluator_t;
+
+struct mcts_config_t {
+    int n_simulations = 256;
+    int leaves_per_tree = 8;
+    float c_puct = 1.5f;
+    // every in-flight descent counts as a visit with value -virtual_loss until its leaf is backed up
+    float virtual_loss = 1.0f;
+    // arena size per tree; once it's full leaves are still evaluated and backed up but not expanded
+    int max_nodes = 1 << 16;
+};
+
+// nodes live in a per-tree arena and the children of a node are contiguous, so a node only needs the
+// index of its first child. states are not stored: descents replay the moves from the root
+struct mcts_node_t {
+    int first_child;
+    // at most N_MOVES
+    int8_t n_children;
+    int8_t move;
+    // set while a descent that ends in this (unexpanded) node waits for the evaluator
+    int8_t pending;
+    // set on a position without a winner where the player to move has no legal move. it is never expanded
+    // and scores 0 for both sides
+    int8_t terminal;
+    int visit_count;
+    int virtual_visits;
+    // from the point of view of the player who made `move`
+    float value_sum;
+    float prior;
+};
+
+class MCTS_t {
+public:
+    explicit MCTS_t(const mcts_config_t& config);
+
+    // runs config.n_simulations simulations from each of the n_roots states and writes the root visit
+    // counts (n_roots x N_MOVES) and the root values for the player to move (n_roots). the trees are
+    // rebuilt on every call. the evaluator is called from the calling thread only
+    void search(const int* root_states, int n_roots, const leaf_evaluator_t& evaluate, float* visit_counts,
+                float* root_values);
+
+    // nodes used by each tree in the last search
+    std::vector<int> tree_sizes() const;
+
+    const mcts_config_t config;
+
+private:
+    struct descent_t {
+        // arena indices from the root to the leaf
+        std::vector<int> path;
+        // movers[k] made the move into path[k], movers[0] is unused
+        std::vector<int8_t> movers;
+        // the leaf position and its player to move
+        std::vector<int> state;
+        int leaf_player;
+        int mask[N_MOVES];
+    };
+
+    struct tree_t {
+        std::vector<mcts_node_t> nodes;
+        int n_nodes = 0;
+        int n_done = 0;
+        std::vector<descent_t> descents;
+        int n_descents = 0;
+    };
+
+    bool descend(tree_t& tree, const int* root_state, descent_t& descent);
+    void expand(tree_t& tree, int node, const int* mask, const float* priors);
+    void backup(tree_t& tree, const descent_t& descent, float value);
+
+    std::vector<tree_t> trees;
+};
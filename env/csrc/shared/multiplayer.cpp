@@ -0,0 +1,179 @@
+#include "multiplayer.h"
+#include "board.h"
+#include "constants.h"
+#include "stats.h"
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+static_assert(N_STAR_POINTS <= (int)STATS_MAX_PLAYERS, "the stats need a win counter per player");
+
+size_t multiplayer_state_size(int n_players) {
+    return with_player_count(n_players, [](auto count) { return sizeof(MultiplayerState_t<decltype(count)::value>); });
+}
+
+template <int n_players>
+void initialize_multiplayer(MultiplayerState_t<n_players>& game_state) {
+    constexpr auto starts = start_points<n_players>();
+    for (int r = 0; r < (int)ROWS; r++) {
+        for (int c = 0; c < (int)COLS; c++) {
+            game_state.grid[r * COLS + c] = is_valid_cell(r, c) ? EMPTY : INVALID;
+        }
+    }
+    for (int p = 0; p < n_players; p++) {
+        for (size_t i = 0; i < N_PIECES_PER_PLAYER; i++) {
+            int cell = star_tables.point_cells[starts[p]][i];
+            game_state.grid[cell] = (int8_t)(p + 1);
+            game_state.pieces[p][i] = (uint8_t)cell;
+        }
+    }
+    game_state.current_player = 1;
+    game_state.last_skipped_piece = -1;
+    game_state.last_direction = -1;
+    game_state.winner = 0;
+    game_state.turn_count = 0;
+}
+
+// the same rules as set_action_mask in engine.cpp, only the pieces of the player to move are looked up by index
+template <int n_players>
+void set_action_mask_multiplayer(const MultiplayerState_t<n_players>& game_state, int* dest) {
+    std::fill_n(dest, N_MOVES, 0);
+    const uint8_t* pieces = game_state.pieces[game_state.current_player - 1];
+    int last_skipped_piece = game_state.last_skipped_piece;
+    bool skip_move = last_skipped_piece != -1;
+    int last_direction = game_state.last_direction;
+
+    for (int i = 0; i < (int)N_PIECES_PER_PLAYER; i++) {
+        if (skip_move && last_skipped_piece != i) {
+            continue;
+        }
+        const auto& steps = step_targets[pieces[i]];
+        const auto& jumps = jump_targets[pieces[i]];
+        for (int j = 0; j < (int)N_DIRECTIONS; j++) {
+            int one_step = steps[j];
+            if (one_step == OFF_BOARD) {
+                continue;
+            }
+            if (game_state.grid[one_step] == EMPTY) {
+                dest[i * N_DIRECTIONS + j] = !skip_move;
+                continue;
+            }
+            int two_step = jumps[j];
+            if (two_step == OFF_BOARD || game_state.grid[two_step] != EMPTY) {
+                continue;
+            }
+            // no hopping straight back mid-turn
+            if (skip_move && ((last_direction - j + N_DIRECTIONS) % N_DIRECTIONS) == 3) {
+                continue;
+            }
+            dest[i * N_DIRECTIONS + j] = 1;
+        }
+    }
+    if (skip_move) {
+        dest[N_MOVES - 1] = 1;
+    }
+}
+
+// a turn only moves the mover's pieces, so only the mover can have won when it ends
+template <int n_players>
+static void next_turn(MultiplayerState_t<n_players>& game_state) {
+    int player = game_state.current_player;
+    const auto& in_goal = multiplayer_tables<n_players>.in_goal[player - 1];
+    bool won = true;
+    for (size_t i = 0; i < N_PIECES_PER_PLAYER; i++) {
+        won &= in_goal[game_state.pieces[player - 1][i]] != 0;
+    }
+    if (won) {
+        game_state.winner = (uint8_t)player;
+    }
+    game_state.last_skipped_piece = -1;
+    game_state.last_direction = -1;
+    game_state.current_player = (uint8_t)(player % n_players + 1);
+    game_state.turn_count += 1;
+}
+
+template <int n_players>
+void update_state_multiplayer(MultiplayerState_t<n_players>& game_state, size_t move) {
+    if (move == N_MOVES - 1) {
+        next_turn(game_state);
+        return;
+    }
+    int player = game_state.current_player;
+    size_t piece_num = move / N_DIRECTIONS;
+    size_t direction = move % N_DIRECTIONS;
+    int cell = game_state.pieces[player - 1][piece_num];
+    int one_step = step_targets[cell][direction];
+    bool jump = game_state.grid[one_step] != EMPTY;
+    int to = jump ? jump_targets[cell][direction] : one_step;
+    assert(game_state.grid[to] == EMPTY);
+    game_state.grid[cell] = EMPTY;
+    game_state.grid[to] = (int8_t)player;
+    game_state.pieces[player - 1][piece_num] = (uint8_t)to;
+    if (jump) {
+        game_state.last_skipped_piece = (int8_t)piece_num;
+        game_state.last_direction = (int8_t)direction;
+    } else {
+        assert(game_state.last_skipped_piece == -1);
+        next_turn(game_state);
+    }
+}
+
+template <int n_players>
+void step_state_multiplayer(MultiplayerState_t<n_players>& game_state, size_t move, float& reward, bool& done,
+                            int* mask) {
+    int player = game_state.current_player;
+    update_state_multiplayer(game_state, move);
+    stats_count_move(move, game_state.current_player == player, game_state.winner);
+
+    // like step_state: from the point of view of the player that just moved
+    int winner = game_state.winner;
+    done = winner != 0;
+    reward = (winner == 0) ? 0.0f : (winner == player ? 1.0f : -1.0f);
+    if (winner != 0) {
+        initialize_multiplayer(game_state);
+    }
+    set_action_mask_multiplayer(game_state, mask);
+    stats_count_mask(mask);
+}
+
+template <int n_players>
+static uint64_t perft_multiplayer_node(MultiplayerState_t<n_players>* node, int depth) {
+    if (depth == 0 || node->winner != 0) {
+        return 1;
+    }
+    int mask[N_MOVES];
+    set_action_mask_multiplayer(*node, mask);
+    uint64_t nodes = 0;
+    for (int move = 0; move < (int)N_MOVES; move++) {
+        if (!mask[move]) {
+            continue;
+        }
+        if (depth == 1) {
+            nodes++;
+            continue;
+        }
+        node[1] = node[0];
+        update_state_multiplayer(node[1], move);
+        nodes += perft_multiplayer_node(node + 1, depth - 1);
+    }
+    return nodes;
+}
+
+template <int n_players>
+uint64_t perft_multiplayer(MultiplayerState_t<n_players> game_state, int depth) {
+    std::vector<MultiplayerState_t<n_players>> stack(depth + 1);
+    stack[0] = game_state;
+    return perft_multiplayer_node(stack.data(), depth);
+}
+
+#define INSTANTIATE_MULTIPLAYER(N)                                                                                    \
+    template void initialize_multiplayer<N>(MultiplayerState_t<N>&);                                                  \
+    template void set_action_mask_multiplayer<N>(const MultiplayerState_t<N>&, int*);                                 \
+    template void update_state_multiplayer<N>(MultiplayerState_t<N>&, size_t);                                        \
+    template void step_state_multiplayer<N>(MultiplayerState_t<N>&, size_t, float&, bool&, int*);                     \
+    template uint64_t perft_multiplayer<N>(MultiplayerState_t<N>, int);
+
+INSTANTIATE_MULTIPLAYER(2)
+INSTANTIATE_MULTIPLAYER(3)
+INSTANTIATE_MULTIPLAYER(4)
+INSTANTIATE_MULTIPLAYER(6)
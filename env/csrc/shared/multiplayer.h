@@ -0,0 +1,190 @@
+#pragma once
+#include "board.h"
+#include "constants.h"
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+
+// the full star with 2, 3, 4 or 6 players. the rules and the sub-move action space (N_MOVES: piece *
+// N_DIRECTIONS + direction of the player to move, then END TURN) are the 2-player engine's, and every player
+// races to the point of the star opposite their own. the player count is a template parameter, so the
+// start and goal tables are constexpr per count and nothing on the hot path loops over players.
+//
+// GameState_t and the rest of the engine stay 2-player: they are the fast path for the 2-player workload,
+// and MultiplayerState_t<2> plays exactly the same games (the perft counts match).
+
+// the six points of the star, clockwise from the top one (player 1's start in the 2-player game)
+static const int N_STAR_POINTS = 6;
+enum star_point_t {
+    POINT_TOP = 0,
+    POINT_UPPER_RIGHT,
+    POINT_LOWER_RIGHT,
+    POINT_BOTTOM,
+    POINT_LOWER_LEFT,
+    POINT_UPPER_LEFT,
+};
+
+constexpr bool supported_player_count(int n_players) {
+    return n_players == 2 || n_players == 3 || n_players == 4 || n_players == 6;
+}
+
+// the points players start on, in turn order. 3 players leave the goals empty, 4 players leave out the top and
+// bottom pair
+template <int n_players>
+constexpr std::array<int, n_players> start_points() {
+    static_assert(supported_player_count(n_players), "the star is for 2, 3, 4 or 6 players");
+    if constexpr (n_players == 2)
+        return {POINT_TOP, POINT_BOTTOM};
+    else if constexpr (n_players == 3)
+        return {POINT_TOP, POINT_LOWER_RIGHT, POINT_LOWER_LEFT};
+    else if constexpr (n_players == 4)
+        return {POINT_UPPER_RIGHT, POINT_LOWER_RIGHT, POINT_LOWER_LEFT, POINT_UPPER_LEFT};
+    else
+        return {POINT_TOP, POINT_UPPER_RIGHT, POINT_LOWER_RIGHT, POINT_BOTTOM, POINT_LOWER_LEFT, POINT_UPPER_LEFT};
+}
+
+constexpr int opposite_point(int point) {
+    return (point + N_STAR_POINTS / 2) % N_STAR_POINTS;
+}
+
+struct star_tables_t {
+    // the cells of each point, tip first, then by distance from the tip and by cell
+    std::array<std::array<int, N_PIECES_PER_PLAYER>, N_STAR_POINTS> point_cells;
+    // the point a cell belongs to, -1 for the middle hexagon and off-board cells
+    std::array<int8_t, NUM_CELLS> point_of;
+};
+
+// rows 0-3 and 13-16 are the top and bottom points. rows 4-7 and 9-12 are the middle hexagon's rows with the
+// side points' cells on either end: 8 - r cells on each side above the middle row, r - 8 below it
+constexpr star_tables_t make_star_tables() {
+    star_tables_t t{};
+    const int center = 8 * COLS + 6;
+    std::array<int, N_STAR_POINTS> counts{};
+    for (int cell = 0; cell < (int)NUM_CELLS; cell++)
+        t.point_of[cell] = -1;
+    for (int r = 0; r < (int)ROWS; r++) {
+        for (int c = min_max_cols[r][0]; c <= min_max_cols[r][1]; c++) {
+            int side = (r < 8) ? 8 - r : r - 8;
+            int point = -1;
+            if (r <= 3)
+                point = POINT_TOP;
+            else if (r >= 13)
+                point = POINT_BOTTOM;
+            else if (c < min_max_cols[r][0] + side)
+                point = (r < 8) ? POINT_UPPER_LEFT : POINT_LOWER_LEFT;
+            else if (c > min_max_cols[r][1] - side)
+                point = (r < 8) ? POINT_UPPER_RIGHT : POINT_LOWER_RIGHT;
+            if (point == -1)
+                continue;
+            if (counts[point] == (int)N_PIECES_PER_PLAYER)
+                throw "a point of the star has more cells than a player has pieces";
+            t.point_of[r * COLS + c] = (int8_t)point;
+            t.point_cells[point][counts[point]++] = r * COLS + c;
+        }
+    }
+    for (int point = 0; point < N_STAR_POINTS; point++) {
+        if (counts[point] != (int)N_PIECES_PER_PLAYER)
+            throw "a point of the star has fewer cells than a player has pieces";
+        auto& cells = t.point_cells[point];
+        // the tip is the cell furthest from the center
+        int tip = cells[0];
+        for (int cell : cells)
+            tip = hex_distance(cell, center) > hex_distance(tip, center) ? cell : tip;
+        // insertion sort by (distance from the tip, cell)
+        for (int i = 1; i < (int)N_PIECES_PER_PLAYER; i++) {
+            for (int j = i; j > 0; j--) {
+                int a = cells[j - 1], b = cells[j];
+                int da = hex_distance(a, tip), db = hex_distance(b, tip);
+                if (da < db || (da == db && a < b))
+                    break;
+                cells[j - 1] = b;
+                cells[j] = a;
+            }
+        }
+    }
+    return t;
+}
+
+static constexpr star_tables_t star_tables = make_star_tables();
+
+constexpr bool matches_start(int point, const std::array<std::array<int, 2>, N_PIECES_PER_PLAYER>& start) {
+    for (int i = 0; i < (int)N_PIECES_PER_PLAYER; i++) {
+        if (star_tables.point_cells[point][i] != start[i][0] * (int)COLS + start[i][1])
+            return false;
+    }
+    return true;
+}
+static_assert(matches_start(POINT_TOP, player_1_start) && matches_start(POINT_BOTTOM, player_2_start),
+              "the 2-player star has to start like the 2-player engine");
+
+// per player count: in_goal[p][cell] is 1 when cell is in player p + 1's goal
+template <int n_players>
+struct multiplayer_tables_t {
+    std::array<std::array<uint8_t, NUM_CELLS>, n_players> in_goal;
+};
+
+template <int n_players>
+constexpr multiplayer_tables_t<n_players> make_multiplayer_tables() {
+    multiplayer_tables_t<n_players> t{};
+    constexpr auto starts = start_points<n_players>();
+    for (int p = 0; p < n_players; p++) {
+        for (int cell : star_tables.point_cells[opposite_point(starts[p])])
+            t.in_goal[p][cell] = 1;
+    }
+    return t;
+}
+
+template <int n_players>
+inline constexpr multiplayer_tables_t<n_players> multiplayer_tables = make_multiplayer_tables<n_players>();
+
+// one game as plain bytes: cells hold INVALID, EMPTY or the player id, pieces are flat cell ids. a batch is a
+// uint8 tensor of shape (n_batch, sizeof(MultiplayerState_t<n_players>)). there's no zobrist hash here
+template <int n_players>
+struct MultiplayerState_t {
+    int8_t grid[NUM_CELLS];
+    uint8_t pieces[n_players][N_PIECES_PER_PLAYER];
+    uint8_t current_player;
+    int8_t last_skipped_piece;
+    int8_t last_direction;
+    uint8_t winner;
+    int32_t turn_count;
+};
+static_assert(std::is_trivially_copyable_v<MultiplayerState_t<6>>, "multiplayer states are copied as bytes");
+
+// sizeof(MultiplayerState_t<n_players>), throws std::invalid_argument for an unsupported count
+size_t multiplayer_state_size(int n_players);
+
+template <int n_players>
+void initialize_multiplayer(MultiplayerState_t<n_players>& game_state);
+// every one of the N_MOVES entries is written
+template <int n_players>
+void set_action_mask_multiplayer(const MultiplayerState_t<n_players>& game_state, int* dest);
+// the move must be legal
+template <int n_players>
+void update_state_multiplayer(MultiplayerState_t<n_players>& game_state, size_t move);
+// update, reward for the player that moved (1 if that won the game), restart a finished game, write the next mask
+template <int n_players>
+void step_state_multiplayer(MultiplayerState_t<n_players>& game_state, size_t move, float& reward, bool& done,
+                            int* mask);
+// see perft.h
+template <int n_players>
+uint64_t perft_multiplayer(MultiplayerState_t<n_players> game_state, int depth);
+
+// fn(std::integral_constant<int, n_players>) for a runtime count, throws std::invalid_argument for an
+// unsupported one. dispatch once per batch, not per state
+template <typename F>
+decltype(auto) with_player_count(int n_players, const F& fn) {
+    switch (n_players) {
+    case 2:
+        return fn(std::integral_constant<int, 2>{});
+    case 3:
+        return fn(std::integral_constant<int, 3>{});
+    case 4:
+        return fn(std::integral_constant<int, 4>{});
+    case 6:
+        return fn(std::integral_constant<int, 6>{});
+    default:
+        throw std::invalid_argument("the star is for 2, 3, 4 or 6 players");
+    }
+}
@@ -0,0 +1,100 @@
+#include "observation.h"
+#include "bitboard.h"
+#include "board.h"
+#include "constants.h"
+#include "symmetry.h"
+#include <algorithm>
+#include <stdexcept>
+
+const char* obs_layout_name(obs_layout_t layout) {
+    return (layout == obs_layout_t::hwc) ? "hwc" : "chw";
+}
+
+obs_layout_t obs_layout_from_name(const std::string& name) {
+    if (name == "hwc")
+        return obs_layout_t::hwc;
+    if (name != "chw")
+        throw std::invalid_argument("unknown observation layout: " + name);
+    return obs_layout_t::chw;
+}
+
+template <typename T>
+struct obs_one;
+
+template <>
+struct obs_one<float> {
+    static constexpr float value = 1.0f;
+};
+
+// bfloat16 1.0: sign 0, exponent 127, no mantissa bits
+template <>
+struct obs_one<uint16_t> {
+    static constexpr uint16_t value = 0x3f80;
+};
+
+// the board cell every playable observation cell shows, per point of view. only the 121 playable cells are
+// visited, everything else stays at the 0 from the clearing pass
+struct obs_source_t {
+    std::array<int, N_VALID_CELLS> cells;
+    std::array<int, N_VALID_CELLS> source[N_PLAYERS];
+};
+
+static constexpr obs_source_t make_obs_source() {
+    obs_source_t table{};
+    for (int b = 0; b < (int)N_VALID_CELLS; b++) {
+        int cell = bitboard_tables.bit_to_cell[b];
+        table.cells[b] = cell;
+        table.source[0][b] = cell;
+        table.source[1][b] = symmetry_tables.cell[SYM_SWAP][cell];
+    }
+    return table;
+}
+
+static constexpr obs_source_t obs_source = make_obs_source();
+
+template <typename State, typename T>
+static void encode_observation_impl(State game_state, T* dest, obs_layout_t layout) {
+    constexpr T one = obs_one<T>::value;
+    int player = *game_state.current_player;
+    const auto& source = obs_source.source[player - 1];
+    std::fill_n(dest, OBS_SIZE, T(0));
+
+    // a grid value to its plane: EMPTY, then player 1, then player 2
+    int plane_of[N_PLAYERS + 1] = {OBS_EMPTY, player == 1 ? OBS_OWN : OBS_OPPONENT,
+                                   player == 2 ? OBS_OWN : OBS_OPPONENT};
+    int hop_cell = OFF_BOARD;
+    if (*game_state.last_skipped_piece != -1) {
+        int cell = game_state.piece_cell(player, *game_state.last_skipped_piece);
+        hop_cell = (player == 1) ? cell : symmetry_tables.cell[SYM_SWAP][cell];
+    }
+
+    if (layout == obs_layout_t::chw) {
+        for (int b = 0; b < (int)N_VALID_CELLS; b++) {
+            dest[plane_of[game_state.grid[source[b]]] * NUM_CELLS + obs_source.cells[b]] = one;
+        }
+        if (hop_cell != OFF_BOARD)
+            dest[OBS_HOP * NUM_CELLS + hop_cell] = one;
+    } else {
+        for (int b = 0; b < (int)N_VALID_CELLS; b++) {
+            dest[obs_source.cells[b] * N_OBS_CHANNELS + plane_of[game_state.grid[source[b]]]] = one;
+        }
+        if (hop_cell != OFF_BOARD)
+            dest[hop_cell * N_OBS_CHANNELS + OBS_HOP] = one;
+    }
+}
+
+void encode_observation(GameState_t game_state, float* dest, obs_layout_t layout) {
+    encode_observation_impl(game_state, dest, layout);
+}
+
+void encode_observation(GameState_t game_state, uint16_t* dest, obs_layout_t layout) {
+    encode_observation_impl(game_state, dest, layout);
+}
+
+void encode_observation(CompactGameState_t game_state, float* dest, obs_layout_t layout) {
+    encode_observation_impl(game_state, dest, layout);
+}
+
+void encode_observation(CompactGameState_t game_state, uint16_t* dest, obs_layout_t layout) {
+    encode_observation_impl(game_state, dest, layout);
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "bitboard.h"
+#include "board.h"
+#include "constants.h"
+#include "symmetry.h"
+#include <cstdint>
+#include <string>
+
+// network input planes, written straight from the state. every plane is ROWS x COLS over the flat grid
+// (off-board cells are 0 in every plane):
+//   OBS_OWN      pieces of the player to move
+//   OBS_OPPONENT pieces of the other player
+//   OBS_EMPTY    empty playable cells
+//   OBS_HOP      the piece in the middle of a jump chain, if there is one
+// the board is always seen from the side of the player to move: player 2's states are rotated by 180
+// degrees (the cells of SYM_SWAP, see symmetry.h), so both players start at the top (rows 0-3) and play
+// toward the bottom. the rotation turns direction d into (d + 3) % N_DIRECTIONS, so a policy over a rotated
+// observation has to map its moves back with observation_move before they go to update_state.
+enum obs_channel_t { OBS_OWN = 0, OBS_OPPONENT = 1, OBS_EMPTY = 2, OBS_HOP = 3 };
+static const size_t N_OBS_CHANNELS = 4;
+static const size_t OBS_SIZE = N_OBS_CHANNELS * NUM_CELLS;
+
+// chw: (N_OBS_CHANNELS, ROWS, COLS), hwc: (ROWS, COLS, N_OBS_CHANNELS)
+enum class obs_layout_t { chw, hwc };
+const char* obs_layout_name(obs_layout_t layout);
+// throws std::invalid_argument for anything but "chw" and "hwc"
+obs_layout_t obs_layout_from_name(const std::string& name);
+
+// a move of the player to move, between the observation's frame and the board's. the rotation is its own
+// inverse, so this maps both ways. player 1's moves and END TURN are unchanged
+inline int observation_move(int player, int move) {
+    return (player == 1) ? move : symmetry_tables.move[SYM_SWAP][move];
+}
+
+// dest holds OBS_SIZE values and is fully overwritten. uint16_t is bfloat16 (the top half of the float32)
+void encode_observation(GameState_t game_state, float* dest, obs_layout_t layout);
+void encode_observation(GameState_t game_state, uint16_t* dest, obs_layout_t layout);
+void encode_observation(CompactGameState_t game_state, float* dest, obs_layout_t layout);
+void encode_observation(CompactGameState_t game_state, uint16_t* dest, obs_layout_t layout);
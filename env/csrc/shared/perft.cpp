@@ -0,0 +1,173 @@
+#include "perft.h"
+#include "bitboard.h"
+#include "board.h"
+#include "constants.h"
+#include "engine.h"
+#include "mask_cache.h"
+#include "undo.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+// make/unmake in one state buffer, so nothing is allocated or copied per node. depth 1 only counts the mask
+// (bulk counting)
+static uint64_t perft_node(GameState_t game_state, UndoStack_t& undo, int depth) {
+    if (depth == 0 || *game_state.winner != 0) {
+        return 1;
+    }
+    int mask[N_MOVES] = {0};
+    set_action_mask(game_state, mask);
+    uint64_t nodes = 0;
+    for (int move = 0; move < (int)N_MOVES; move++) {
+        if (!mask[move]) {
+            continue;
+        }
+        if (depth == 1) {
+            nodes++;
+            continue;
+        }
+        undo.make(game_state, move);
+        nodes += perft_node(game_state, undo, depth - 1);
+        undo.unmake(game_state);
+    }
+    return nodes;
+}
+
+uint64_t perft(GameState_t game_state, int depth) {
+    std::vector<int> state(TOTAL_STATE);
+    GameState_t node(state.data());
+    copy_state(game_state, node);
+    UndoStack_t undo(std::max(depth, 0));
+    return perft_node(node, undo, depth);
+}
+
+// perft_node, with the node saved to saved[0] before each make and compared after the unmake. saved holds a state
+// per remaining ply
+static uint64_t perft_checked_node(GameState_t game_state, UndoStack_t& undo, int* saved, int depth) {
+    if (depth == 0 || *game_state.winner != 0) {
+        return 1;
+    }
+    int mask[N_MOVES] = {0};
+    set_action_mask(game_state, mask);
+    uint64_t nodes = 0;
+    for (int move = 0; move < (int)N_MOVES; move++) {
+        if (!mask[move]) {
+            continue;
+        }
+        if (depth == 1) {
+            nodes++;
+            continue;
+        }
+        std::memcpy(saved, game_state.grid, TOTAL_STATE * sizeof(int));
+        undo.make(game_state, move);
+        nodes += perft_checked_node(game_state, undo, saved + TOTAL_STATE, depth - 1);
+        undo.unmake(game_state);
+        if (std::memcmp(saved, game_state.grid, TOTAL_STATE * sizeof(int)) != 0) {
+            throw std::logic_error("unmake_move of move " + std::to_string(move) + " didn't restore the state, " +
+                                   std::to_string(depth) + " plies from the perft horizon");
+        }
+    }
+    return nodes;
+}
+
+uint64_t perft_checked(GameState_t game_state, int depth) {
+    std::vector<int> state(TOTAL_STATE);
+    GameState_t node(state.data());
+    copy_state(game_state, node);
+    std::vector<int> saved((size_t)std::max(depth, 0) * TOTAL_STATE);
+    UndoStack_t undo(std::max(depth, 0));
+    uint64_t nodes = perft_checked_node(node, undo, saved.data(), depth);
+    if (!undo.empty() || !std::equal(state.begin(), state.end(), game_state.grid)) {
+        throw std::logic_error("perft didn't return to the root position");
+    }
+    return nodes;
+}
+
+uint64_t perft_bitboard(const BitboardState_t& bb_state, int depth) {
+    if (depth == 0 || bb_state.winner != 0) {
+        return 1;
+    }
+    int mask[N_MOVES] = {0};
+    set_action_mask(bb_state, mask);
+    uint64_t nodes = 0;
+    for (int move = 0; move < (int)N_MOVES; move++) {
+        if (!mask[move]) {
+            continue;
+        }
+        if (depth == 1) {
+            nodes++;
+            continue;
+        }
+        BitboardState_t child = bb_state;
+        update_state(child, move);
+        nodes += perft_bitboard(child, depth - 1);
+    }
+    return nodes;
+}
+
+static uint64_t perft_mask_cache_node(int* node, mask_cache_t* caches, int depth) {
+    GameState_t game_state(node);
+    if (depth == 0 || *game_state.winner != 0) {
+        return 1;
+    }
+    int mask[N_MOVES];
+    write_action_mask(game_state, caches[0], mask);
+    uint64_t nodes = 0;
+    for (int move = 0; move < (int)N_MOVES; move++) {
+        if (!mask[move]) {
+            continue;
+        }
+        if (depth == 1) {
+            nodes++;
+            continue;
+        }
+        GameState_t child(node + TOTAL_STATE);
+        copy_state(game_state, child);
+        caches[1] = caches[0];
+        update_state_cached(child, caches[1], move);
+        nodes += perft_mask_cache_node(node + TOTAL_STATE, caches + 1, depth - 1);
+    }
+    return nodes;
+}
+
+uint64_t perft_mask_cache(GameState_t game_state, int depth) {
+    std::vector<int> stack((depth + 1) * TOTAL_STATE);
+    std::vector<mask_cache_t> caches(depth + 1);
+    copy_state(game_state, GameState_t(stack.data()));
+    init_mask_cache(game_state, caches[0]);
+    return perft_mask_cache_node(stack.data(), caches.data(), depth);
+}
+
+const std::vector<perft_position_t>& perft_positions() {
+    // the mid-game sequences are random play from the start position. "midhop" stops in the middle of a
+    // jump chain, so it covers the skip-chain restrictions
+    static const std::vector<perft_position_t> positions = {
+        {"start", {}, {14, 118, 1412, 19700, 289316, 4433988}},
+        {"midgame",
+         {26, 60, 53, 26, 58, 20, 60, 55, 53, 47, 9,  53, 58, 24, 50, 60, 34, 21, 53, 3,
+          41, 14, 60, 54, 17, 60, 24, 0,  31, 34, 40, 20, 23, 2,  3,  1,  60, 46, 19, 23,
+          60, 20, 48, 8,  60, 44, 45, 17, 44, 23, 44, 17, 49, 60, 47, 59, 60, 25, 60, 33},
+         {45, 1887, 74432, 3087596}},
+        {"midhop",
+         {39, 29, 60, 37, 25, 20, 60, 17, 32, 60, 57, 60, 18, 60, 17, 13, 15, 60, 21, 23,
+          19, 60, 28, 26, 60, 12, 60, 52, 60, 15, 60, 21, 49, 28, 12, 56, 60, 28, 25, 34,
+          20, 60, 28, 24, 51, 50, 60, 23, 60, 33, 60, 18, 20, 28, 35, 21, 59, 12, 26, 27},
+         {1, 33, 1190, 30584, 1088868}},
+    };
+    return positions;
+}
+
+void setup_perft_position(const perft_position_t& position, GameState_t game_state) {
+    initialize_state(game_state);
+    for (size_t k = 0; k < position.moves.size(); k++) {
+        int move = position.moves[k];
+        int mask[N_MOVES] = {0};
+        set_action_mask(game_state, mask);
+        if (move < 0 || move >= (int)N_MOVES || !mask[move]) {
+            throw std::runtime_error(std::string("illegal move ") + std::to_string(move) + " at move " +
+                                     std::to_string(k) + " of perft position " + position.name);
+        }
+        update_state(game_state, move);
+    }
+}
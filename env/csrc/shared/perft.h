@@ -0,0 +1,33 @@
+#pragma once
+#include "bitboard.h"
+#include "board.h"
+#include "constants.h"
+#include <cstdint>
+#include <vector>
+
+// perft: the number of move sequences of a given length from a position, the usual move generator check.
+// a ply is one entry of the sub-move action space (N_MOVES), so a multi-jump turn spans one ply per jump plus
+// END TURN. a finished game is a leaf at any depth.
+//
+// the three counters walk the same tree through different move generators (flat-cell tables, bitboards and
+// the incremental mask cache), so they have to agree with each other as well as with the recorded counts. perft
+// walks the tree with make/unmake (see undo.h).
+uint64_t perft(GameState_t game_state, int depth);
+// perft that also checks unmake_move: the whole state buffer, hash and turn count included, has to come back
+// byte for byte after every unmake and after the walk. throws std::logic_error at the first node that doesn't
+uint64_t perft_checked(GameState_t game_state, int depth);
+uint64_t perft_bitboard(const BitboardState_t& bb_state, int depth);
+uint64_t perft_mask_cache(GameState_t game_state, int depth);
+
+// reference positions: the start position and mid-game positions reached by a fixed sub-move sequence from it.
+// nodes[d] is the perft count at depth d + 1
+struct perft_position_t {
+    const char* name;
+    std::vector<int> moves;
+    std::vector<uint64_t> nodes;
+};
+
+const std::vector<perft_position_t>& perft_positions();
+
+// initialize_state, then the position's moves. throws std::runtime_error if one of them is illegal
+void setup_perft_position(const perft_position_t& position, GameState_t game_state);
@@ -0,0 +1,176 @@
+#include "replay.h"
+#include "board.h"
+#include "constants.h"
+#include "engine.h"
+#include "game_log.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+TextReplaySource_t::TextReplaySource_t(std::istream& in, uint64_t game_index)
+    : in(in), game_index(game_index), in_game(game_index == 0), spool(std::tmpfile()) {
+    if (!spool)
+        throw std::runtime_error("could not create a temporary file for the replay");
+}
+
+TextReplaySource_t::~TextReplaySource_t() {
+    std::fclose(spool);
+}
+
+// the next action of the game from the stream. lines that aren't moves are skipped like the renderer always did
+bool TextReplaySource_t::read_line_action(int& action) {
+    std::string line;
+    while (!stream_done && std::getline(in, line)) {
+        if (is_game_separator_text(line)) {
+            if (in_game) {
+                stream_done = true;
+                break;
+            }
+            in_game = ++current_game == game_index;
+            continue;
+        }
+        if (!in_game)
+            continue;
+        action = parse_move_text(line);
+        if (action >= 0)
+            return true;
+    }
+    stream_done = true;
+    return false;
+}
+
+bool TextReplaySource_t::found_game() {
+    // the GAME line is only seen once the stream gets there
+    while (!in_game && !stream_done) {
+        std::string line;
+        if (!std::getline(in, line)) {
+            stream_done = true;
+            break;
+        }
+        if (is_game_separator_text(line))
+            in_game = ++current_game == game_index;
+    }
+    return in_game;
+}
+
+bool TextReplaySource_t::next(int& action) {
+    if (offset < n_spooled) {
+        // stdio wants a seek between a write and a read on the same FILE anyway
+        if (spool_offset != offset || spool_writing)
+            std::fseek(spool, (long)offset, SEEK_SET);
+        action = std::fgetc(spool);
+        spool_offset = ++offset;
+        spool_writing = false;
+        return true;
+    }
+    if (!read_line_action(action))
+        return false;
+    if (spool_offset != n_spooled || !spool_writing)
+        std::fseek(spool, 0, SEEK_END);
+    std::fputc(action, spool);
+    spool_writing = true;
+    spool_offset = ++n_spooled;
+    offset = n_spooled;
+    return true;
+}
+
+void TextReplaySource_t::rewind(uint64_t position) {
+    offset = std::min(position, n_spooled);
+}
+
+Replay_t::Replay_t(replay_source_t& source, int keyframe_interval, int max_keyframes)
+    : source(source), interval(std::max(keyframe_interval, 1)), max_keyframes(std::max(max_keyframes, 2)) {
+    view.position = source.position();
+    initialize_state(GameState_t(view.state.data()));
+    scan = view;
+    add_keyframe(view);
+}
+
+void Replay_t::add_keyframe(const cursor_t& cursor) {
+    if ((int)keyframes.size() == max_keyframes) {
+        // keep the even ones, which are exactly the multiples of the doubled interval
+        size_t kept = 0;
+        for (size_t k = 0; k < keyframes.size(); k += 2)
+            keyframes[kept++] = keyframes[k];
+        keyframes.resize(kept);
+        interval *= 2;
+        if (cursor.move % interval != 0)
+            return;
+    }
+    keyframes.push_back({cursor.move, cursor.position, cursor.state});
+}
+
+// one move from the cursor's position. moves past the scan cursor extend it (and the keyframes), the rest are
+// re-read from the source
+bool Replay_t::advance(cursor_t& cursor) {
+    if (end_reached && cursor.move >= scan.move)
+        return false;
+    GameState_t game_state(cursor.state.data());
+    int action;
+    source.rewind(cursor.position);
+    bool read = source.next(action);
+    if (read && cursor.move >= scan.move) {
+        int mask[N_MOVES] = {0};
+        set_action_mask(game_state, mask);
+        if (action < 0 || action >= (int)N_MOVES || !mask[action]) {
+            error_message = "illegal action " + std::to_string(action) + " at move " + std::to_string(cursor.move);
+            read = false;
+        }
+    }
+    if (!read || *game_state.winner != 0) {
+        // the frontier is the only cursor that can get here before the end is known
+        end_reached = true;
+        return false;
+    }
+
+    replay_move_t& move = cursor.last;
+    move.player = *game_state.current_player;
+    move.action = action;
+    move.from = OFF_BOARD;
+    move.to = OFF_BOARD;
+    if (action != (int)N_MOVES - 1) {
+        int piece = action / N_DIRECTIONS;
+        move.from = game_state.piece_cell(move.player, piece);
+        update_state(game_state, action);
+        move.to = game_state.piece_cell(move.player, piece);
+    } else {
+        update_state(game_state, action);
+    }
+    cursor.has_last = true;
+    cursor.move++;
+    cursor.position = source.position();
+
+    if (cursor.move > scan.move) {
+        scan = cursor;
+        if (scan.move % interval == 0)
+            add_keyframe(scan);
+    }
+    return true;
+}
+
+bool Replay_t::step() {
+    return advance(view);
+}
+
+void Replay_t::read_ahead(uint64_t max_moves) {
+    for (uint64_t k = 0; k < max_moves && advance(scan); k++) {
+    }
+}
+
+void Replay_t::seek(uint64_t target) {
+    if (target < view.move || target - view.move > (uint64_t)interval) {
+        // the last keyframe before the target, so at least one move is replayed and last_move() is set again.
+        // keyframes are sorted by move and the first one is move 0
+        auto it = std::lower_bound(keyframes.begin(), keyframes.end(), target,
+                                   [](const keyframe_t& keyframe, uint64_t move) { return keyframe.move < move; });
+        const keyframe_t& keyframe = (it == keyframes.begin()) ? *it : *(it - 1);
+        if (keyframe.move > view.move || target < view.move) {
+            view.move = keyframe.move;
+            view.position = keyframe.position;
+            view.state = keyframe.state;
+            view.has_last = false;
+        }
+    }
+    while (view.move < target && advance(view)) {
+    }
+}
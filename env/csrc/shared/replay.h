@@ -0,0 +1,166 @@
+#pragma once
+#include "board.h"
+#include "constants.h"
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <istream>
+#include <string>
+#include <vector>
+
+// seekable replay of one game from a log that may be far too long to hold or replay up front. the actions
+// come from a replay_source_t, read only as far as playback (or a scan ahead) needs. every keyframe_interval
+// moves the state is saved, and a seek restores the last keyframe before the target and replays the rest.
+// the number of keyframes is capped: when the cap is hit every other keyframe is dropped and the interval
+// doubles, so memory stays bounded and a seek never replays more than one interval.
+
+// the actions of one game in order. position() is an opaque offset of the next action that rewind() goes back to
+class replay_source_t {
+public:
+    virtual ~replay_source_t() = default;
+    // false at the end of the game
+    virtual bool next(int& action) = 0;
+    virtual uint64_t position() const = 0;
+    virtual void rewind(uint64_t position) = 0;
+};
+
+// actions already in memory, like a memory-mapped binary log
+class ArrayReplaySource_t : public replay_source_t {
+public:
+    ArrayReplaySource_t(const uint8_t* actions, uint64_t n_actions) : actions(actions), n_actions(n_actions) {}
+
+    bool next(int& action) override {
+        if (offset >= n_actions)
+            return false;
+        action = actions[offset++];
+        return true;
+    }
+    uint64_t position() const override {
+        return offset;
+    }
+    void rewind(uint64_t position) override {
+        offset = position;
+    }
+
+private:
+    const uint8_t* actions;
+    uint64_t n_actions;
+    uint64_t offset = 0;
+};
+
+// game `game_index` of a text log (see game_log.h), parsed line by line as it's needed. the stream doesn't have
+// to be seekable (stdin works): the parsed actions are spooled to an anonymous temporary file, one byte each,
+// and read back from there after a rewind. throws std::runtime_error if the temporary file can't be created
+class TextReplaySource_t : public replay_source_t {
+public:
+    TextReplaySource_t(std::istream& in, uint64_t game_index);
+    ~TextReplaySource_t() override;
+    TextReplaySource_t(const TextReplaySource_t&) = delete;
+    TextReplaySource_t& operator=(const TextReplaySource_t&) = delete;
+
+    bool next(int& action) override;
+    uint64_t position() const override {
+        return offset;
+    }
+    void rewind(uint64_t position) override;
+
+    // whether the game was found, false once the stream ended before its GAME line
+    bool found_game();
+
+private:
+    bool read_line_action(int& action);
+
+    std::istream& in;
+    uint64_t game_index;
+    uint64_t current_game = 0;
+    bool in_game = false;
+    bool stream_done = false;
+    FILE* spool;
+    uint64_t n_spooled = 0;
+    uint64_t offset = 0;
+    // where the spool's file position is and whether the last access wrote, the spool is read and appended
+    // through the same FILE
+    uint64_t spool_offset = 0;
+    bool spool_writing = true;
+};
+
+struct replay_move_t {
+    int player;
+    int action;
+    // the piece's cell before and after, OFF_BOARD for END TURN
+    int from;
+    int to;
+};
+
+class Replay_t {
+public:
+    Replay_t(replay_source_t& source, int keyframe_interval = 64, int max_keyframes = 1024);
+
+    // the state after `current()` moves
+    GameState_t state() {
+        return GameState_t(view.state.data());
+    }
+    uint64_t current() const {
+        return view.move;
+    }
+    // the move that led to the current state, null at move 0
+    const replay_move_t* last_move() const {
+        return view.has_last ? &view.last : nullptr;
+    }
+
+    // moves known so far. the length of the game once finished() is set
+    uint64_t n_known() const {
+        return scan.move;
+    }
+    // the whole game has been read: the source ended, the game was won or an action was illegal
+    bool finished() const {
+        return end_reached;
+    }
+    // non-empty if the replay stopped at an illegal action
+    const std::string& error() const {
+        return error_message;
+    }
+
+    // apply the next move, false at the end of the game
+    bool step();
+    // go to the state after `target` moves, or the last one if the game is shorter
+    void seek(uint64_t target);
+    // read up to max_moves moves past n_known() without moving the current state, to learn the game's length
+    // and lay down keyframes ahead of playback
+    void read_ahead(uint64_t max_moves);
+
+    int keyframe_interval() const {
+        return interval;
+    }
+    size_t n_keyframes() const {
+        return keyframes.size();
+    }
+
+private:
+    struct cursor_t {
+        uint64_t move = 0;
+        uint64_t position = 0;
+        std::array<int, TOTAL_STATE> state;
+        bool has_last = false;
+        replay_move_t last;
+    };
+
+    struct keyframe_t {
+        uint64_t move;
+        uint64_t position;
+        std::array<int, TOTAL_STATE> state;
+    };
+
+    bool advance(cursor_t& cursor);
+    void add_keyframe(const cursor_t& cursor);
+
+    replay_source_t& source;
+    int interval;
+    int max_keyframes;
+    std::vector<keyframe_t> keyframes;
+    // the shown position, and the furthest position read so far
+    cursor_t view;
+    cursor_t scan;
+    bool end_reached = false;
+    std::string error_message;
+};
@@ -0,0 +1,82 @@
+#include "sampling.h"
+#include "board.h"
+#include "constants.h"
+#include "engine.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+int sample_action(const int* mask, const float* logits, uint64_t seed, uint64_t stream, uint64_t step, int* legal,
+                  int& n_legal) {
+    n_legal = 0;
+    float max_logit = -std::numeric_limits<float>::infinity();
+    for (int move = 0; move < (int)N_MOVES; move++) {
+        if (mask[move]) {
+            legal[n_legal++] = move;
+            if (logits)
+                max_logit = std::max(max_logit, logits[move]);
+        }
+    }
+    if (n_legal == 0) {
+        return -1;
+    }
+
+    auto bits = philox_draw(seed, stream, step);
+    // multiply-shift, the bias is below n_legal / 2^32
+    int uniform = legal[((uint64_t)bits[0] * (uint32_t)n_legal) >> 32];
+    // with every legal move at -inf there is no weight at all, that falls back to uniform like an all-equal softmax
+    if (!logits || max_logit == -std::numeric_limits<float>::infinity()) {
+        return uniform;
+    }
+    // +inf logits take all the weight (exp(x - max) would be nan for them), drawn uniformly among themselves
+    if (max_logit == std::numeric_limits<float>::infinity()) {
+        int n_certain = 0;
+        for (int k = 0; k < n_legal; k++) {
+            n_certain += logits[legal[k]] == max_logit;
+        }
+        int pick = ((uint64_t)bits[0] * (uint32_t)n_certain) >> 32;
+        for (int k = 0; k < n_legal; k++) {
+            if (logits[legal[k]] == max_logit && pick-- == 0)
+                return legal[k];
+        }
+    }
+
+    // inverse cdf over the legal moves with a 53-bit uniform, shifted by the max so exp can't overflow
+    double weights[N_MOVES];
+    double total = 0.0;
+    for (int k = 0; k < n_legal; k++) {
+        weights[k] = std::exp((double)logits[legal[k]] - (double)max_logit);
+        total += weights[k];
+    }
+    double target = (double)((((uint64_t)bits[1] << 32) | bits[2]) >> 11) * 0x1.0p-53 * total;
+    int chosen = -1;
+    for (int k = 0; k < n_legal; k++) {
+        if (weights[k] > 0.0) {
+            chosen = legal[k];
+            target -= weights[k];
+            if (target < 0.0)
+                break;
+        }
+    }
+    // rounding can leave target at >= 0 past the end, which picks the last move with any weight. nan logits
+    // leave none
+    return (chosen >= 0) ? chosen : uniform;
+}
+
+template <typename State>
+static int sample_action_impl(State game_state, const float* logits, uint64_t seed, uint64_t stream, uint64_t step,
+                              int* legal, int& n_legal) {
+    int mask[N_MOVES] = {0};
+    set_action_mask(game_state, mask);
+    return sample_action(mask, logits, seed, stream, step, legal, n_legal);
+}
+
+int sample_action(GameState_t game_state, const float* logits, uint64_t seed, uint64_t stream, uint64_t step,
+                  int* legal, int& n_legal) {
+    return sample_action_impl(game_state, logits, seed, stream, step, legal, n_legal);
+}
+
+int sample_action(CompactGameState_t game_state, const float* logits, uint64_t seed, uint64_t stream, uint64_t step,
+                  int* legal, int& n_legal) {
+    return sample_action_impl(game_state, logits, seed, stream, step, legal, n_legal);
+}
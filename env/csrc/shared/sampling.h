@@ -0,0 +1,56 @@
+#pragma once
+#include "board.h"
+#include "constants.h"
+#include <array>
+#include <cstdint>
+
+// legal move sampling with a counter-based rng: every draw is philox4x32-10 of (stream, step) under the seed, so
+// it only depends on those three numbers and not on which thread drew it or what was drawn before. the batched
+// op uses the caller's env ids as the stream (the row when there are none), generate the game index, so results
+// are the same for any thread count or batch split.
+
+using philox_block_t = std::array<uint32_t, 4>;
+
+// philox4x32 with 10 rounds (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3")
+constexpr philox_block_t philox4x32_10(philox_block_t counter, uint64_t key) {
+    uint32_t k0 = (uint32_t)key;
+    uint32_t k1 = (uint32_t)(key >> 32);
+    for (int round = 0; round < 10; round++) {
+        uint64_t product0 = (uint64_t)0xD2511F53u * counter[0];
+        uint64_t product1 = (uint64_t)0xCD9E8D57u * counter[2];
+        counter = {(uint32_t)(product1 >> 32) ^ counter[1] ^ k0, (uint32_t)product1,
+                   (uint32_t)(product0 >> 32) ^ counter[3] ^ k1, (uint32_t)product0};
+        k0 += 0x9E3779B9u;
+        k1 += 0xBB67AE85u;
+    }
+    return counter;
+}
+
+constexpr bool philox_equal(const philox_block_t& a, const philox_block_t& b) {
+    return a[0] == b[0] && a[1] == b[1] && a[2] == b[2] && a[3] == b[3];
+}
+
+// the known-answer vectors of the Random123 reference implementation
+static_assert(philox_equal(philox4x32_10({0, 0, 0, 0}, 0), {0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8}),
+              "philox4x32_10 doesn't match the reference");
+static_assert(philox_equal(philox4x32_10({0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}, 0xffffffffffffffffULL),
+                           {0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd}),
+              "philox4x32_10 doesn't match the reference");
+
+// 128 random bits for one draw
+constexpr philox_block_t philox_draw(uint64_t seed, uint64_t stream, uint64_t step) {
+    return philox4x32_10({(uint32_t)step, (uint32_t)(step >> 32), (uint32_t)stream, (uint32_t)(stream >> 32)}, seed);
+}
+
+// a move with mask[move] != 0 drawn with (seed, stream, step): uniformly when logits is null, otherwise with
+// probability softmax(logits) over the legal moves (the logits of illegal moves are never read, a legal move
+// with a -inf logit is never drawn unless they all are, and legal moves with a +inf logit are drawn uniformly
+// among themselves and nothing else is). returns -1 when nothing is legal. legal (N_MOVES
+// entries) gets the legal moves in order and n_legal their count, both in the same pass over the mask
+int sample_action(const int* mask, const float* logits, uint64_t seed, uint64_t stream, uint64_t step, int* legal,
+                  int& n_legal);
+// the same from a state, with the mask set_action_mask would write
+int sample_action(GameState_t game_state, const float* logits, uint64_t seed, uint64_t stream, uint64_t step,
+                  int* legal, int& n_legal);
+int sample_action(CompactGameState_t game_state, const float* logits, uint64_t seed, uint64_t stream, uint64_t step,
+                  int* legal, int& n_legal);
@@ -0,0 +1,268 @@
+#include "simd_mask.h"
+#include "board.h"
+#include "constants.h"
+#include "engine.h"
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SIMD_MASK_X86 1
+#endif
+
+static const int MAX_LANES = 16;
+
+// one block of games in structure-of-arrays form. the grids stay where they are: lane k of the block
+// reads its cells at grid_base + k * state_bytes
+struct mask_block_t {
+    int32_t piece_cell[N_PIECES_PER_PLAYER][MAX_LANES];
+    int32_t last_skipped_piece[MAX_LANES];
+    // the direction that would undo the last jump, -1 if there is no hop in progress
+    int32_t reverse_direction[MAX_LANES];
+    const uint8_t* grid_base;
+    // the block's masks, move-major: moves[m][k] is move m of lane k
+    int32_t moves[N_MOVES][MAX_LANES];
+};
+
+template <typename State>
+struct state_layout;
+
+template <>
+struct state_layout<GameState_t> {
+    typedef int element_t;
+    static const int state_bytes = TOTAL_STATE * sizeof(int);
+};
+
+template <>
+struct state_layout<CompactGameState_t> {
+    typedef uint8_t element_t;
+    static const int state_bytes = COMPACT_STATE;
+};
+
+template <typename State>
+static void load_block(typename state_layout<State>::element_t* first, int n_lanes, mask_block_t& block) {
+    for (int k = 0; k < n_lanes; k++) {
+        State game_state(first + k * (state_layout<State>::state_bytes / sizeof(*first)));
+        int player = *game_state.current_player;
+        for (size_t i = 0; i < N_PIECES_PER_PLAYER; i++) {
+            block.piece_cell[i][k] = game_state.piece_cell(player, i);
+        }
+        int last_skipped_piece = *game_state.last_skipped_piece;
+        block.last_skipped_piece[k] = last_skipped_piece;
+        block.reverse_direction[k] = (last_skipped_piece == -1) ? -1 : (*game_state.last_direction + 3) % N_DIRECTIONS;
+    }
+    block.grid_base = reinterpret_cast<const uint8_t*>(first);
+}
+
+static void store_block(const mask_block_t& block, int n_lanes, int* dest) {
+    for (int k = 0; k < n_lanes; k++) {
+        auto row = dest + k * N_MOVES;
+        for (size_t m = 0; m < N_MOVES; m++) {
+            row[m] = block.moves[m][k];
+        }
+    }
+}
+
+#ifdef SIMD_MASK_X86
+
+// the cell tables are int arrays laid out [cell][direction], so entry (cell, d) is at cell * N_DIRECTIONS + d
+static const int* const step_table = &step_targets[0][0];
+static const int* const jump_table = &jump_targets[0][0];
+
+// grid values are gathered as 32-bit loads at byte offsets. for the compact layout that reads the cell
+// and the three bytes after it (still inside the state), so the cell is the sign-extended low byte
+template <int ElementBytes>
+__attribute__((target("avx2"))) static inline __m256i gather_grid_avx2(const uint8_t* base, __m256i lane_offset,
+                                                                       __m256i cell) {
+    auto offset = _mm256_add_epi32(lane_offset, _mm256_slli_epi32(cell, ElementBytes == 4 ? 2 : 0));
+    auto value = _mm256_i32gather_epi32(reinterpret_cast<const int*>(base), offset, 1);
+    return (ElementBytes == 4) ? value : _mm256_srai_epi32(_mm256_slli_epi32(value, 24), 24);
+}
+
+template <int ElementBytes, int StateBytes>
+__attribute__((target("avx2"))) static void set_block_mask_avx2(mask_block_t& block) {
+    const auto zero = _mm256_setzero_si256();
+    const auto one = _mm256_set1_epi32(1);
+    const auto minus_one = _mm256_set1_epi32(-1);
+    const auto lane_offset = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(StateBytes));
+    auto last_skipped_piece = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block.last_skipped_piece));
+    auto reverse_direction = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block.reverse_direction));
+    auto skip_move = _mm256_cmpgt_epi32(last_skipped_piece, minus_one);
+
+    for (int i = 0; i < (int)N_PIECES_PER_PLAYER; i++) {
+        auto cell = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block.piece_cell[i]));
+        auto is_skipped = _mm256_cmpeq_epi32(last_skipped_piece, _mm256_set1_epi32(i));
+        // every piece can move at the start of a turn, only the skipping piece once a hop started
+        auto movable = _mm256_or_si256(_mm256_andnot_si256(skip_move, minus_one), is_skipped);
+        auto table_index = _mm256_mullo_epi32(cell, _mm256_set1_epi32(N_DIRECTIONS));
+        for (int d = 0; d < (int)N_DIRECTIONS; d++) {
+            auto index = _mm256_add_epi32(table_index, _mm256_set1_epi32(d));
+            auto one_step = _mm256_i32gather_epi32(step_table, index, 4);
+            auto two_step = _mm256_i32gather_epi32(jump_table, index, 4);
+            auto one_step_on_board = _mm256_cmpgt_epi32(one_step, minus_one);
+            auto two_step_on_board = _mm256_cmpgt_epi32(two_step, minus_one);
+            // off-board targets are clamped to cell 0, their results are masked out anyway
+            auto one_step_empty = _mm256_cmpeq_epi32(
+                gather_grid_avx2<ElementBytes>(block.grid_base, lane_offset, _mm256_max_epi32(one_step, zero)), zero);
+            auto two_step_empty = _mm256_cmpeq_epi32(
+                gather_grid_avx2<ElementBytes>(block.grid_base, lane_offset, _mm256_max_epi32(two_step, zero)), zero);
+
+            auto can_step = _mm256_andnot_si256(skip_move, one_step_empty);
+            auto undo = _mm256_and_si256(is_skipped, _mm256_cmpeq_epi32(reverse_direction, _mm256_set1_epi32(d)));
+            auto can_jump = _mm256_andnot_si256(one_step_empty, _mm256_andnot_si256(undo, two_step_on_board));
+            can_jump = _mm256_and_si256(can_jump, two_step_empty);
+            auto legal = _mm256_and_si256(_mm256_and_si256(movable, one_step_on_board), _mm256_or_si256(can_step, can_jump));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(block.moves[i * N_DIRECTIONS + d]), _mm256_and_si256(legal, one));
+        }
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(block.moves[N_MOVES - 1]), _mm256_and_si256(skip_move, one));
+}
+
+template <int ElementBytes>
+__attribute__((target("avx512f"))) static inline __m512i gather_grid_avx512(const uint8_t* base, __m512i lane_offset,
+                                                                           __m512i cell) {
+    auto offset = _mm512_add_epi32(lane_offset, _mm512_slli_epi32(cell, ElementBytes == 4 ? 2 : 0));
+    auto value = _mm512_i32gather_epi32(offset, base, 1);
+    return (ElementBytes == 4) ? value : _mm512_srai_epi32(_mm512_slli_epi32(value, 24), 24);
+}
+
+template <int ElementBytes, int StateBytes>
+__attribute__((target("avx512f"))) static void set_block_mask_avx512(mask_block_t& block) {
+    const auto zero = _mm512_setzero_si512();
+    const auto one = _mm512_set1_epi32(1);
+    const auto lane_offset = _mm512_mullo_epi32(
+        _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15), _mm512_set1_epi32(StateBytes));
+    auto last_skipped_piece = _mm512_loadu_si512(block.last_skipped_piece);
+    auto reverse_direction = _mm512_loadu_si512(block.reverse_direction);
+    __mmask16 skip_move = _mm512_cmpge_epi32_mask(last_skipped_piece, zero);
+
+    for (int i = 0; i < (int)N_PIECES_PER_PLAYER; i++) {
+        auto cell = _mm512_loadu_si512(block.piece_cell[i]);
+        __mmask16 is_skipped = _mm512_cmpeq_epi32_mask(last_skipped_piece, _mm512_set1_epi32(i));
+        // every piece can move at the start of a turn, only the skipping piece once a hop started
+        __mmask16 movable = (__mmask16)(~skip_move) | is_skipped;
+        auto table_index = _mm512_mullo_epi32(cell, _mm512_set1_epi32(N_DIRECTIONS));
+        for (int d = 0; d < (int)N_DIRECTIONS; d++) {
+            auto index = _mm512_add_epi32(table_index, _mm512_set1_epi32(d));
+            __mmask16 legal = 0;
+            if (movable != 0) {
+                auto one_step = _mm512_i32gather_epi32(index, step_table, 4);
+                auto two_step = _mm512_i32gather_epi32(index, jump_table, 4);
+                __mmask16 one_step_on_board = _mm512_cmpge_epi32_mask(one_step, zero);
+                __mmask16 two_step_on_board = _mm512_cmpge_epi32_mask(two_step, zero);
+                // off-board targets are clamped to cell 0, their results are masked out anyway
+                __mmask16 one_step_empty = _mm512_cmpeq_epi32_mask(
+                    gather_grid_avx512<ElementBytes>(block.grid_base, lane_offset, _mm512_max_epi32(one_step, zero)),
+                    zero);
+                __mmask16 two_step_empty = _mm512_cmpeq_epi32_mask(
+                    gather_grid_avx512<ElementBytes>(block.grid_base, lane_offset, _mm512_max_epi32(two_step, zero)),
+                    zero);
+
+                __mmask16 can_step = one_step_empty & ~skip_move;
+                __mmask16 undo = is_skipped & _mm512_cmpeq_epi32_mask(reverse_direction, _mm512_set1_epi32(d));
+                __mmask16 can_jump = ~one_step_empty & two_step_on_board & two_step_empty & ~undo;
+                legal = movable & one_step_on_board & (can_step | can_jump);
+            }
+            _mm512_storeu_si512(block.moves[i * N_DIRECTIONS + d], _mm512_maskz_mov_epi32(legal, one));
+        }
+    }
+    _mm512_storeu_si512(block.moves[N_MOVES - 1], _mm512_maskz_mov_epi32(skip_move, one));
+}
+
+#endif
+
+static simd_isa_t detect_simd_isa_impl() {
+#ifdef SIMD_MASK_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return simd_isa_t::avx512;
+    if (__builtin_cpu_supports("avx2"))
+        return simd_isa_t::avx2;
+#endif
+    return simd_isa_t::scalar;
+}
+
+simd_isa_t detect_simd_isa() {
+    static const simd_isa_t detected = detect_simd_isa_impl();
+    return detected;
+}
+
+static std::atomic<simd_isa_t> simd_isa{detect_simd_isa()};
+
+simd_isa_t get_simd_isa() {
+    return simd_isa.load();
+}
+
+simd_isa_t set_simd_isa(simd_isa_t isa) {
+    isa = std::min(isa, detect_simd_isa());
+    simd_isa.store(isa);
+    return isa;
+}
+
+const char* simd_isa_name(simd_isa_t isa) {
+    switch (isa) {
+    case simd_isa_t::avx512:
+        return "avx512";
+    case simd_isa_t::avx2:
+        return "avx2";
+    default:
+        return "scalar";
+    }
+}
+
+simd_isa_t simd_isa_from_name(const std::string& name) {
+    if (name == "avx512")
+        return simd_isa_t::avx512;
+    if (name == "avx2")
+        return simd_isa_t::avx2;
+    if (name != "scalar")
+        throw std::invalid_argument("unknown simd isa: " + name);
+    return simd_isa_t::scalar;
+}
+
+// masks for states [begin, end): full blocks go through the vector kernel, the tail through set_action_mask
+template <typename State>
+static void set_action_mask_range(typename state_layout<State>::element_t* states, int64_t begin, int64_t end,
+                                  int* dest, simd_isa_t isa) {
+    constexpr int state_size = state_layout<State>::state_bytes / sizeof(*states);
+    int64_t i = begin;
+#ifdef SIMD_MASK_X86
+    constexpr int element_bytes = sizeof(*states);
+    constexpr int state_bytes = state_layout<State>::state_bytes;
+    int lanes = (isa == simd_isa_t::avx512) ? 16 : (isa == simd_isa_t::avx2) ? 8 : 0;
+    if (lanes != 0) {
+        mask_block_t block;
+        for (; i + lanes <= end; i += lanes) {
+            load_block<State>(states + i * state_size, lanes, block);
+            if (isa == simd_isa_t::avx512) {
+                set_block_mask_avx512<element_bytes, state_bytes>(block);
+            } else {
+                set_block_mask_avx2<element_bytes, state_bytes>(block);
+            }
+            store_block(block, lanes, dest + i * N_MOVES);
+        }
+    }
+#endif
+    for (; i < end; i++) {
+        auto row = dest + i * N_MOVES;
+        std::fill_n(row, N_MOVES, 0);
+        set_action_mask(State(states + i * state_size), row);
+    }
+}
+
+template <typename State>
+static void set_action_mask_simd_impl(typename state_layout<State>::element_t* states, int n_batch, int* dest) {
+    auto isa = get_simd_isa();
+    // chunks are split on envs like the other batch loops, each chunk runs its own blocks and tail
+    parallel_for_chunks(n_batch, [&](int64_t begin, int64_t end) {
+        set_action_mask_range<State>(states, begin, end, dest, isa);
+    });
+}
+
+void set_action_mask_simd(int* states, int n_batch, int* dest) {
+    set_action_mask_simd_impl<GameState_t>(states, n_batch, dest);
+}
+
+void set_action_mask_simd(uint8_t* states, int n_batch, int* dest) {
+    set_action_mask_simd_impl<CompactGameState_t>(states, n_batch, dest);
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include "board.h"
+#include "constants.h"
+#include <cstdint>
+#include <string>
+
+// batch action mask kernel. games are processed in blocks of 8 (AVX2) or 16 (AVX-512): the pieces and
+// metadata of a block are transposed into a structure-of-arrays block, then every (piece, direction) pair
+// is evaluated for all the games of the block at once with gathers from the step/jump tables and the
+// grids. the masks are exactly the ones set_action_mask writes.
+enum class simd_isa_t { scalar, avx2, avx512 };
+
+// the best ISA the cpu supports, checked once at runtime. non-x86 builds always get scalar
+simd_isa_t detect_simd_isa();
+simd_isa_t get_simd_isa();
+// forces an ISA (mostly for tests and benchmarks), clamped to what the cpu supports
+simd_isa_t set_simd_isa(simd_isa_t isa);
+const char* simd_isa_name(simd_isa_t isa);
+// throws std::invalid_argument for anything but "scalar", "avx2" and "avx512"
+simd_isa_t simd_isa_from_name(const std::string& name);
+
+// masks for n_batch states stored back to back (int32 or compact layout) into dest, n_batch x N_MOVES.
+// the same masks set_action_mask writes, using the ISA from get_simd_isa()
+void set_action_mask_simd(int* states, int n_batch, int* dest);
+void set_action_mask_simd(uint8_t* states, int n_batch, int* dest);
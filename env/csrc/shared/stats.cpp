@@ -0,0 +1,213 @@
+#include "stats.h"
+#include "constants.h"
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+const char* const stats_kernel_names[N_KERNELS] = {
+    "set_action_mask",
+    "write_action_mask",
+    "update_state",
+    "get_action_mask_batched",
+    "update_state_batched",
+    "step_batched",
+    "step_cached_batched",
+    "encode_observation_batched",
+    "step_observe_batched",
+    "vec_env_step",
+    "sample_actions_batched",
+    "step_shaped_batched",
+    "evaluate_batched",
+    "step_limited_batched",
+    "get_action_mask_multiplayer_batched",
+    "step_multiplayer_batched",
+};
+
+#ifdef CHINESE_CHECKERS_STATS
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> trace_enabled{false};
+
+namespace {
+
+struct trace_record_t {
+    const char* name;
+    int64_t start_ns;
+    int64_t end_ns;
+    int64_t n;
+    int tid;
+};
+
+// a thread's counters and events. threads register on first use and fold everything into the retired totals
+// when they exit, so a short-lived worker's counts outlive it
+struct thread_stats_t {
+    stats_block_t block{};
+    std::mutex events_mutex;
+    std::vector<trace_record_t> events;
+    int tid = 0;
+};
+
+std::mutex registry_mutex;
+std::vector<thread_stats_t*> registry;
+stats_block_t retired{};
+std::vector<trace_record_t> retired_events;
+int next_tid = 0;
+
+template <typename F>
+void for_each_counter(stats_block_t& block, const F& fn) {
+    for (int k = 0; k < N_KERNELS; k++) {
+        fn(block.calls[k]);
+        fn(block.states[k]);
+        fn(block.ns[k]);
+    }
+    for (auto& counter : block.legal_moves)
+        fn(counter);
+    fn(block.hop_jumps);
+    fn(block.hop_chains);
+    for (auto& counter : block.wins)
+        fn(counter);
+}
+
+void add_block(stats_block_t& dst, stats_block_t& src) {
+    std::vector<uint64_t> values;
+    for_each_counter(src, [&](std::atomic<uint64_t>& counter) { values.push_back(counter.load()); });
+    size_t i = 0;
+    for_each_counter(dst, [&](std::atomic<uint64_t>& counter) { stats_bump(counter, values[i++]); });
+}
+
+struct thread_registration_t {
+    std::unique_ptr<thread_stats_t> stats = std::make_unique<thread_stats_t>();
+
+    thread_registration_t() {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        stats->tid = next_tid++;
+        registry.push_back(stats.get());
+    }
+
+    ~thread_registration_t() {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        registry.erase(std::find(registry.begin(), registry.end(), stats.get()));
+        add_block(retired, stats->block);
+        std::lock_guard<std::mutex> events_lock(stats->events_mutex);
+        retired_events.insert(retired_events.end(), stats->events.begin(), stats->events.end());
+    }
+};
+
+thread_stats_t& local_thread_stats() {
+    thread_local thread_registration_t registration;
+    return *registration.stats;
+}
+
+}  // namespace
+
+stats_block_t& local_stats() {
+    return local_thread_stats().block;
+}
+
+stats_snapshot_t get_stats() {
+    stats_snapshot_t snapshot{};
+    stats_block_t total{};
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    add_block(total, retired);
+    for (auto* stats : registry)
+        add_block(total, stats->block);
+    for (int k = 0; k < N_KERNELS; k++) {
+        snapshot.calls[k] = total.calls[k].load();
+        snapshot.states[k] = total.states[k].load();
+        snapshot.ns[k] = total.ns[k].load();
+    }
+    for (size_t m = 0; m <= N_MOVES; m++)
+        snapshot.legal_moves[m] = total.legal_moves[m].load();
+    snapshot.hop_jumps = total.hop_jumps.load();
+    snapshot.hop_chains = total.hop_chains.load();
+    for (size_t p = 0; p < STATS_MAX_PLAYERS; p++)
+        snapshot.wins[p] = total.wins[p].load();
+    return snapshot;
+}
+
+void reset_stats() {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    auto clear = [](std::atomic<uint64_t>& counter) { counter.store(0, std::memory_order_relaxed); };
+    for_each_counter(retired, clear);
+    for (auto* stats : registry)
+        for_each_counter(stats->block, clear);
+}
+
+void set_trace_enabled(bool enabled) {
+    trace_enabled.store(enabled);
+}
+
+bool get_trace_enabled() {
+    return trace_enabled.load(std::memory_order_relaxed);
+}
+
+void trace_event(const char* name, int64_t start_ns, int64_t end_ns, int64_t n) {
+    if (!trace_enabled.load(std::memory_order_relaxed))
+        return;
+    auto& stats = local_thread_stats();
+    std::lock_guard<std::mutex> lock(stats.events_mutex);
+    stats.events.push_back({name, start_ns, end_ns, n, stats.tid});
+}
+
+void clear_trace() {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    retired_events.clear();
+    for (auto* stats : registry) {
+        std::lock_guard<std::mutex> events_lock(stats->events_mutex);
+        stats->events.clear();
+    }
+}
+
+void write_trace(const std::string& path) {
+    std::vector<trace_record_t> events;
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        events = retired_events;
+        for (auto* stats : registry) {
+            std::lock_guard<std::mutex> events_lock(stats->events_mutex);
+            events.insert(events.end(), stats->events.begin(), stats->events.end());
+        }
+    }
+    std::ofstream out(path);
+    if (!out.is_open())
+        throw std::runtime_error("could not open trace file: " + path);
+    int64_t origin = events.empty() ? 0 : events[0].start_ns;
+    for (const auto& event : events)
+        origin = std::min(origin, event.start_ns);
+    // complete ("X") events, timestamps in microseconds from the first event
+    out << "{\"traceEvents\": [";
+    for (size_t i = 0; i < events.size(); i++) {
+        const auto& event = events[i];
+        out << (i ? "," : "") << "\n  {\"name\": \"" << event.name << "\", \"ph\": \"X\", \"pid\": 0, \"tid\": "
+            << event.tid << ", \"ts\": " << (double)(event.start_ns - origin) / 1e3
+            << ", \"dur\": " << (double)(event.end_ns - event.start_ns) / 1e3 << ", \"args\": {\"n\": " << event.n
+            << "}}";
+    }
+    out << "\n], \"displayTimeUnit\": \"ns\"}\n";
+    if (!out)
+        throw std::runtime_error("could not write trace file: " + path);
+}
+
+#else
+
+stats_snapshot_t get_stats() {
+    return stats_snapshot_t{};
+}
+
+void reset_stats() {}
+
+void set_trace_enabled(bool) {}
+
+bool get_trace_enabled() {
+    return false;
+}
+
+void trace_event(const char*, int64_t, int64_t, int64_t) {}
+
+void write_trace(const std::string&) {}
+
+void clear_trace() {}
+
+#endif
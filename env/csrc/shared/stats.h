@@ -0,0 +1,169 @@
+#pragma once
+#include "constants.h"
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// engine counters and trace events, compiled in only with CHINESE_CHECKERS_STATS defined (the cmake option of
+// the same name, STATS=1 for setup.py). without it every hook below is an empty inline function and the engine
+// is the same code as before.
+//
+// counters live in one block per thread and are only written by that thread (relaxed load + store, no locked
+// instructions); get_stats() sums the blocks. the per-state kernels only count calls, the batched ones are
+// timed around the whole batch so the clock reads amortize over it. the game counters (legal moves, hop
+// chains, wins) are only bumped where games advance: the step functions, the VecEnv and generate. search,
+// perft and sampling call the same per-state kernels on positions no game reaches.
+#ifdef CHINESE_CHECKERS_STATS
+static constexpr bool stats_enabled = true;
+#else
+static constexpr bool stats_enabled = false;
+#endif
+
+enum stats_kernel_t {
+    KERNEL_SET_ACTION_MASK,
+    KERNEL_WRITE_ACTION_MASK,
+    KERNEL_UPDATE_STATE,
+    KERNEL_GET_ACTION_MASK_BATCHED,
+    KERNEL_UPDATE_STATE_BATCHED,
+    KERNEL_STEP_BATCHED,
+    KERNEL_STEP_CACHED_BATCHED,
+    KERNEL_ENCODE_OBSERVATION_BATCHED,
+    KERNEL_STEP_OBSERVE_BATCHED,
+    KERNEL_VEC_ENV_STEP,
+    KERNEL_SAMPLE_ACTIONS_BATCHED,
+    KERNEL_STEP_SHAPED_BATCHED,
+    KERNEL_EVALUATE_BATCHED,
+    KERNEL_STEP_LIMITED_BATCHED,
+    KERNEL_GET_ACTION_MASK_MULTIPLAYER_BATCHED,
+    KERNEL_STEP_MULTIPLAYER_BATCHED,
+    N_KERNELS,
+};
+
+// the win counters cover the multiplayer star's largest player count
+static const size_t STATS_MAX_PLAYERS = 6;
+
+extern const char* const stats_kernel_names[N_KERNELS];
+
+struct stats_snapshot_t {
+    // per kernel: calls, states processed and nanoseconds spent (0 for the untimed per-state kernels)
+    uint64_t calls[N_KERNELS];
+    uint64_t states[N_KERNELS];
+    uint64_t ns[N_KERNELS];
+    // legal_moves[k]: masks handed to a game with k legal moves
+    uint64_t legal_moves[N_MOVES + 1];
+    // jumps played in games and hop chains ended with END TURN, their ratio is the mean chain length
+    uint64_t hop_jumps;
+    uint64_t hop_chains;
+    // wins[p - 1]: games won by player p
+    uint64_t wins[STATS_MAX_PLAYERS];
+};
+
+// all zeros without CHINESE_CHECKERS_STATS
+stats_snapshot_t get_stats();
+// meant to be called while nothing is running, a concurrent increment may survive it
+void reset_stats();
+
+// chrome trace events (chrome://tracing, perfetto), recorded while enabled. no-ops without
+// CHINESE_CHECKERS_STATS
+void set_trace_enabled(bool enabled);
+bool get_trace_enabled();
+// a complete event on the calling thread's track, with n as its only arg. times are from stats_now_ns()
+void trace_event(const char* name, int64_t start_ns, int64_t end_ns, int64_t n);
+// every recorded event as trace-event JSON, throws std::runtime_error if the file can't be written
+void write_trace(const std::string& path);
+// drop the recorded events
+void clear_trace();
+
+#ifdef CHINESE_CHECKERS_STATS
+#include <atomic>
+
+struct stats_block_t {
+    std::atomic<uint64_t> calls[N_KERNELS];
+    std::atomic<uint64_t> states[N_KERNELS];
+    std::atomic<uint64_t> ns[N_KERNELS];
+    std::atomic<uint64_t> legal_moves[N_MOVES + 1];
+    std::atomic<uint64_t> hop_jumps;
+    std::atomic<uint64_t> hop_chains;
+    std::atomic<uint64_t> wins[STATS_MAX_PLAYERS];
+};
+
+// the calling thread's block
+stats_block_t& local_stats();
+extern std::atomic<bool> trace_enabled;
+
+inline void stats_bump(std::atomic<uint64_t>& counter, uint64_t n) {
+    counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+#endif
+
+inline int64_t stats_now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// a call of one of the untimed per-state kernels
+inline void stats_count_call(stats_kernel_t kernel) {
+#ifdef CHINESE_CHECKERS_STATS
+    auto& stats = local_stats();
+    stats_bump(stats.calls[kernel], 1);
+    stats_bump(stats.states[kernel], 1);
+#else
+    (void)kernel;
+#endif
+}
+
+// a mask handed to a game for its next move
+inline void stats_count_mask(const int* mask) {
+#ifdef CHINESE_CHECKERS_STATS
+    int n_legal = 0;
+    for (int m = 0; m < (int)N_MOVES; m++) {
+        n_legal += mask[m] != 0;
+    }
+    stats_bump(local_stats().legal_moves[n_legal], 1);
+#else
+    (void)mask;
+#endif
+}
+
+// a move a game played: jumped is whether it was a jump (the mover is still to move), winner the state's winner
+// after it, before any reset
+inline void stats_count_move(size_t move, bool jumped, int winner) {
+#ifdef CHINESE_CHECKERS_STATS
+    auto& stats = local_stats();
+    if (jumped)
+        stats_bump(stats.hop_jumps, 1);
+    else if (move == N_MOVES - 1)
+        stats_bump(stats.hop_chains, 1);
+    if (winner != 0)
+        stats_bump(stats.wins[winner - 1], 1);
+#else
+    (void)move;
+    (void)jumped;
+    (void)winner;
+#endif
+}
+
+// times a batched kernel from construction to destruction, and records it as a trace event while tracing
+class StatsTimer_t {
+public:
+#ifdef CHINESE_CHECKERS_STATS
+    StatsTimer_t(stats_kernel_t kernel, int64_t n_states)
+        : kernel(kernel), n_states(n_states), start(stats_now_ns()) {}
+    ~StatsTimer_t() {
+        int64_t end = stats_now_ns();
+        auto& stats = local_stats();
+        stats_bump(stats.calls[kernel], 1);
+        stats_bump(stats.states[kernel], (uint64_t)n_states);
+        stats_bump(stats.ns[kernel], (uint64_t)(end - start));
+        if (trace_enabled.load(std::memory_order_relaxed))
+            trace_event(stats_kernel_names[kernel], start, end, n_states);
+    }
+
+private:
+    stats_kernel_t kernel;
+    int64_t n_states;
+    int64_t start;
+#else
+    StatsTimer_t(stats_kernel_t, int64_t) {}
+#endif
+};
@@ -0,0 +1,34 @@
+#include "symmetry.h"
+#include "board.h"
+#include "constants.h"
+
+template <typename State>
+static void transform_state_impl(State src, State dst, symmetry_t sym) {
+    const auto& cells = symmetry_tables.cell[sym];
+    bool swap = symmetry_swaps_players(sym);
+    // swapping exchanges the player ids 1 and 2, everything else (EMPTY, INVALID) stays
+    auto player_of = [&](int player) { return (swap && player > 0) ? 3 - player : player; };
+
+    for (int cell = 0; cell < (int)NUM_CELLS; cell++) {
+        dst.grid[cells[cell]] = player_of(src.grid[cell]);
+    }
+    for (int player = 1; player <= (int)N_PLAYERS; player++) {
+        for (int i = 0; i < (int)N_PIECES_PER_PLAYER; i++) {
+            dst.set_piece(player_of(player), i, cells[src.piece_cell(player, i)]);
+        }
+    }
+    *dst.current_player = player_of(*src.current_player);
+    *dst.last_skipped_piece = *src.last_skipped_piece;
+    *dst.last_direction = (*src.last_direction == -1) ? -1 : symmetry_tables.direction[sym][*src.last_direction];
+    *dst.winner = player_of(*src.winner);
+    *dst.turn_count = *src.turn_count;
+    *dst.hash = compute_hash(dst);
+}
+
+void transform_state(GameState_t src, GameState_t dst, symmetry_t sym) {
+    transform_state_impl(src, dst, sym);
+}
+
+void transform_state(CompactGameState_t src, CompactGameState_t dst, symmetry_t sym) {
+    transform_state_impl(src, dst, sym);
+}
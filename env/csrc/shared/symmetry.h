@@ -0,0 +1,81 @@
+#pragma once
+#include "board.h"
+#include "constants.h"
+#include <array>
+#include <cstdint>
+
+// board symmetries, for data augmentation. the star has a left-right mirror, which keeps every piece on
+// its side, and a player swap: a 180 degree rotation with the two players exchanged, which maps a game
+// onto the same game played from the other side. together with the identity and their composition that's
+// a group of 4, and every element is its own inverse.
+//
+// under a symmetry, cell c goes to cell[c] and direction d to direction[d]. pieces keep their index and
+// the swap also exchanges the players, so move piece * N_DIRECTIONS + d of the player to move becomes
+// piece * N_DIRECTIONS + direction[d] of the (new) player to move: mask(transform(s))[move[m]] == mask(s)[m]
+enum symmetry_t { SYM_IDENTITY = 0, SYM_MIRROR = 1, SYM_SWAP = 2, SYM_MIRROR_SWAP = 3 };
+static const size_t N_SYMMETRIES = 4;
+
+struct symmetry_tables_t {
+    // off-board cells map to themselves
+    std::array<std::array<int, NUM_CELLS>, N_SYMMETRIES> cell;
+    std::array<std::array<int, N_DIRECTIONS>, N_SYMMETRIES> direction;
+    std::array<std::array<int, N_MOVES>, N_SYMMETRIES> move;
+};
+
+// the mirror reverses every row between its min_max_cols bounds. the rotation also reverses the rows, which
+// works because min_max_cols is the same read from either end. the directions aren't written down: they're
+// found by matching the step_targets (the odd-row neighbor layout) of every cell before and after, so a
+// table that doesn't preserve the board fails to compile
+constexpr symmetry_tables_t make_symmetry_tables() {
+    symmetry_tables_t t{};
+    for (int sym = 0; sym < (int)N_SYMMETRIES; sym++) {
+        bool mirror = sym & SYM_MIRROR;
+        bool rotate = sym & SYM_SWAP;
+        for (int r = 0; r < (int)ROWS; r++) {
+            for (int c = 0; c < (int)COLS; c++) {
+                int cell = r * COLS + c;
+                if (!is_valid_cell_constexpr(r, c)) {
+                    t.cell[sym][cell] = cell;
+                    continue;
+                }
+                // the rotation is the mirror followed by flipping the rows
+                int mapped_c = (mirror != rotate) ? min_max_cols[r][0] + min_max_cols[r][1] - c : c;
+                int mapped_r = rotate ? (int)ROWS - 1 - r : r;
+                if (min_max_cols[mapped_r][0] != min_max_cols[r][0] || min_max_cols[mapped_r][1] != min_max_cols[r][1])
+                    throw "min_max_cols is not symmetric between the two halves of the board";
+                t.cell[sym][cell] = mapped_r * COLS + mapped_c;
+            }
+        }
+        for (int d = 0; d < (int)N_DIRECTIONS; d++) {
+            t.direction[sym][d] = -1;
+            for (int mapped_d = 0; mapped_d < (int)N_DIRECTIONS && t.direction[sym][d] == -1; mapped_d++) {
+                bool matches = true;
+                for (int cell = 0; cell < (int)NUM_CELLS; cell++) {
+                    int target = step_targets[cell][d];
+                    if (target == OFF_BOARD)
+                        continue;
+                    matches = matches && step_targets[t.cell[sym][cell]][mapped_d] == t.cell[sym][target];
+                }
+                if (matches)
+                    t.direction[sym][d] = mapped_d;
+            }
+            if (t.direction[sym][d] == -1)
+                throw "symmetry doesn't preserve the board";
+        }
+        for (int m = 0; m < (int)N_MOVES - 1; m++) {
+            t.move[sym][m] = (m / N_DIRECTIONS) * N_DIRECTIONS + t.direction[sym][m % N_DIRECTIONS];
+        }
+        t.move[sym][N_MOVES - 1] = N_MOVES - 1;
+    }
+    return t;
+}
+
+static constexpr symmetry_tables_t symmetry_tables = make_symmetry_tables();
+
+inline bool symmetry_swaps_players(int sym) {
+    return (sym & SYM_SWAP) != 0;
+}
+
+// dst gets src under the symmetry, the hash included. src and dst must not overlap
+void transform_state(GameState_t src, GameState_t dst, symmetry_t sym);
+void transform_state(CompactGameState_t src, CompactGameState_t dst, symmetry_t sym);
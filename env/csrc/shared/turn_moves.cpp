@@ -0,0 +1,123 @@
+#include "turn_moves.h"
+#include "bitboard.h"
+#include "board.h"
+#include "constants.h"
+#include "engine.h"
+#include <algorithm>
+
+template <int D>
+static inline bitboard_t jump_targets_in(bitboard_t from, bitboard_t others, bitboard_t empty) {
+    return shift_bitboard<D>(shift_bitboard<D>(from) & others) & empty;
+}
+
+template <int D>
+static inline bitboard_t step_targets_in(bitboard_t from, bitboard_t empty) {
+    return shift_bitboard<D>(from) & empty;
+}
+
+// a jump can be followed by any jump except straight back, so the search tracks the cells reached by
+// the last jump in each direction separately
+template <int D>
+static inline bitboard_t expand_direction(const bitboard_t* frontier, bitboard_t others, bitboard_t empty) {
+    constexpr int back = (D + 3) % N_DIRECTIONS;
+    bitboard_t from = 0;
+    for (int d = 0; d < (int)N_DIRECTIONS; d++) {
+        if (d != back) {
+            from |= frontier[d];
+        }
+    }
+    return jump_targets_in<D>(from, others, empty);
+}
+
+bitboard_t turn_destinations(bitboard_t origin, bitboard_t occupied, int last_direction, bool allow_steps) {
+    // the moving piece has left its cell, so it can't be jumped over and it can be landed on again
+    auto others = occupied & ~origin;
+    auto empty = bitboard_tables.valid & ~others;
+
+    bitboard_t frontier[N_DIRECTIONS];
+    bitboard_t reached[N_DIRECTIONS];
+    frontier[0] = jump_targets_in<0>(origin, others, empty);
+    frontier[1] = jump_targets_in<1>(origin, others, empty);
+    frontier[2] = jump_targets_in<2>(origin, others, empty);
+    frontier[3] = jump_targets_in<3>(origin, others, empty);
+    frontier[4] = jump_targets_in<4>(origin, others, empty);
+    frontier[5] = jump_targets_in<5>(origin, others, empty);
+    if (last_direction != -1) {
+        // mid-hop, the piece can't undo the jump it just made
+        frontier[(last_direction + 3) % N_DIRECTIONS] = 0;
+    }
+
+    // flood fill over (cell, direction of the last jump) until no new pair shows up
+    bitboard_t any_new = 0;
+    for (int d = 0; d < (int)N_DIRECTIONS; d++) {
+        reached[d] = frontier[d];
+        any_new |= frontier[d];
+    }
+    while (any_new != 0) {
+        bitboard_t next[N_DIRECTIONS] = {
+            expand_direction<0>(frontier, others, empty), expand_direction<1>(frontier, others, empty),
+            expand_direction<2>(frontier, others, empty), expand_direction<3>(frontier, others, empty),
+            expand_direction<4>(frontier, others, empty), expand_direction<5>(frontier, others, empty)};
+        any_new = 0;
+        for (int d = 0; d < (int)N_DIRECTIONS; d++) {
+            frontier[d] = next[d] & ~reached[d];
+            reached[d] |= frontier[d];
+            any_new |= frontier[d];
+        }
+    }
+
+    bitboard_t destinations = origin;
+    for (int d = 0; d < (int)N_DIRECTIONS; d++) {
+        destinations |= reached[d];
+    }
+    if (allow_steps) {
+        destinations |= step_targets_in<0>(origin, empty) | step_targets_in<1>(origin, empty) |
+                        step_targets_in<2>(origin, empty) | step_targets_in<3>(origin, empty) |
+                        step_targets_in<4>(origin, empty) | step_targets_in<5>(origin, empty);
+    }
+    return destinations;
+}
+
+void set_turn_action_mask(const BitboardState_t& bb_state, int* dest) {
+    auto player = bb_state.current_player;
+    auto last_skipped_piece = bb_state.last_skipped_piece;
+    auto skip_move = last_skipped_piece != -1;
+    auto occupied = bb_state.pieces[0] | bb_state.pieces[1];
+
+    for (int i = 0; i < (int)N_PIECES_PER_PLAYER; i++) {
+        if (skip_move && last_skipped_piece != i) {
+            continue;
+        }
+        auto origin = bit_at(bb_state.piece_bits[player - 1][i]);
+        auto destinations = turn_destinations(origin, occupied, bb_state.last_direction, !skip_move);
+        if (!skip_move) {
+            destinations &= ~origin;
+        }
+        auto row = dest + i * N_VALID_CELLS;
+        while (destinations != 0) {
+            row[bitboard_lowest_bit(destinations)] = 1;
+            destinations &= destinations - 1;
+        }
+    }
+}
+
+template <typename State>
+static void update_state_turn_impl(State game_state, size_t turn_move) {
+    int current_player = *game_state.current_player;
+    int piece_num = turn_move / N_VALID_CELLS;
+    int to = bitboard_tables.bit_to_cell[turn_move % N_VALID_CELLS];
+    int from = game_state.piece_cell(current_player, piece_num);
+    // we assume the move is valid, ending a hop where it is leaves the piece in place
+    if (from != to) {
+        game_state.update_state(from, to, current_player, piece_num);
+    }
+    game_state.next_turn();
+}
+
+void update_state_turn(GameState_t game_state, size_t turn_move) {
+    update_state_turn_impl(game_state, turn_move);
+}
+
+void update_state_turn(CompactGameState_t game_state, size_t turn_move) {
+    update_state_turn_impl(game_state, turn_move);
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include "bitboard.h"
+#include "board.h"
+#include "constants.h"
+
+// turn-level ("macro move") action space: one action per turn, a (piece, final destination) pair.
+// action = piece_num * N_VALID_CELLS + destination bit, where the destination is numbered like the
+// bitboard cells (row-major over the playable cells, see bitboard_tables.bit_to_cell). a turn is either
+// a single step or any chain of jumps, so this replaces the sub-move sequence ending in END TURN.
+static const size_t N_TURN_MOVES = N_PIECES_PER_PLAYER * N_VALID_CELLS;
+
+// every cell the piece on `origin` can end its turn on through chains of jumps over `occupied`
+// (which includes the piece itself), plus the single steps when allow_steps is set. a jump can never be
+// followed by its reverse, including the one that brought the piece to origin when last_direction != -1.
+// the result always contains origin, callers decide whether staying put is a legal turn.
+bitboard_t turn_destinations(bitboard_t origin, bitboard_t occupied, int last_direction, bool allow_steps);
+
+// dest has N_TURN_MOVES entries and is expected to be zeroed. at the start of a turn every piece can move
+// and staying put isn't allowed. if a hop is already in progress (last_skipped_piece != -1) only that
+// piece can move, only by jumping, and its current cell means ending the turn where it is.
+void set_turn_action_mask(const BitboardState_t& bb_state, int* dest);
+
+void update_state_turn(GameState_t game_state, size_t turn_move);
+void update_state_turn(CompactGameState_t game_state, size_t turn_move);
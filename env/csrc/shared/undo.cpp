@@ -0,0 +1,108 @@
+#include "undo.h"
+#include "board.h"
+#include "constants.h"
+#include "engine.h"
+#include <stdexcept>
+
+template <typename State>
+static undo_record_t make_move_impl(State game_state, size_t move) {
+    undo_record_t record;
+    record.hash = *game_state.hash;
+    record.current_player = (uint8_t)*game_state.current_player;
+    record.last_skipped_piece = (int8_t)*game_state.last_skipped_piece;
+    record.last_direction = (int8_t)*game_state.last_direction;
+    record.winner = (uint8_t)*game_state.winner;
+    record.padding = 0;
+    if (move == N_MOVES - 1) {
+        record.piece = -1;
+        record.from = record.to = 0;
+    } else {
+        int piece_num = (int)(move / N_DIRECTIONS);
+        record.piece = (int8_t)piece_num;
+        record.from = (uint8_t)game_state.piece_cell(record.current_player, piece_num);
+    }
+    update_state(game_state, move);
+    if (record.piece >= 0) {
+        record.to = (uint8_t)game_state.piece_cell(record.current_player, record.piece);
+    }
+    return record;
+}
+
+template <typename State>
+static void unmake_move_impl(State game_state, const undo_record_t& record) {
+    int player = record.current_player;
+    if (record.piece >= 0) {
+        game_state.grid[record.to] = EMPTY;
+        game_state.grid[record.from] = player;
+        game_state.set_piece(player, record.piece, record.from);
+    }
+    // only next_turn switches players, and it always does
+    if (*game_state.current_player != player) {
+        *game_state.turn_count -= 1;
+    }
+    *game_state.current_player = player;
+    *game_state.last_skipped_piece = record.last_skipped_piece;
+    *game_state.last_direction = record.last_direction;
+    *game_state.winner = record.winner;
+    *game_state.hash = record.hash;
+}
+
+undo_record_t make_move(GameState_t game_state, size_t move) {
+    return make_move_impl(game_state, move);
+}
+
+undo_record_t make_move(CompactGameState_t game_state, size_t move) {
+    return make_move_impl(game_state, move);
+}
+
+void unmake_move(GameState_t game_state, const undo_record_t& record) {
+    unmake_move_impl(game_state, record);
+}
+
+void unmake_move(CompactGameState_t game_state, const undo_record_t& record) {
+    unmake_move_impl(game_state, record);
+}
+
+template <typename State>
+static void stack_make(std::vector<undo_record_t>& records, size_t& n_records, State game_state, size_t move) {
+    if (n_records == records.size()) {
+        throw std::length_error("UndoStack is full");
+    }
+    records[n_records++] = make_move_impl(game_state, move);
+}
+
+template <typename State>
+static void stack_unmake(std::vector<undo_record_t>& records, size_t& n_records, State game_state) {
+    if (n_records == 0) {
+        throw std::logic_error("UndoStack::unmake called on an empty stack");
+    }
+    unmake_move_impl(game_state, records[--n_records]);
+}
+
+void UndoStack_t::make(GameState_t game_state, size_t move) {
+    stack_make(records, n_records, game_state, move);
+}
+
+void UndoStack_t::make(CompactGameState_t game_state, size_t move) {
+    stack_make(records, n_records, game_state, move);
+}
+
+void UndoStack_t::unmake(GameState_t game_state) {
+    stack_unmake(records, n_records, game_state);
+}
+
+void UndoStack_t::unmake(CompactGameState_t game_state) {
+    stack_unmake(records, n_records, game_state);
+}
+
+void UndoStack_t::unmake_all(GameState_t game_state) {
+    while (n_records > 0) {
+        unmake_move_impl(game_state, records[--n_records]);
+    }
+}
+
+void UndoStack_t::unmake_all(CompactGameState_t game_state) {
+    while (n_records > 0) {
+        unmake_move_impl(game_state, records[--n_records]);
+    }
+}
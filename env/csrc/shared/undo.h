@@ -0,0 +1,66 @@
+#pragma once
+#include "board.h"
+#include "constants.h"
+#include <cstdint>
+#include <vector>
+
+// make/unmake: update_state that hands back what it overwrote, so search can walk a tree in one state buffer
+// instead of copying the whole state before every trial move. a record is 16 bytes against TOTAL_STATE ints.
+struct undo_record_t {
+    uint64_t hash;               // the hash before the move, restoring it is cheaper than undoing the xors
+    int8_t piece;                // the piece that moved, -1 for END TURN
+    uint8_t from;                // its cell before the move
+    uint8_t to;                  // and after it
+    uint8_t current_player;      // the player to move before the move, who is also the mover
+    int8_t last_skipped_piece;
+    int8_t last_direction;
+    uint8_t winner;
+    uint8_t padding;
+};
+static_assert(sizeof(undo_record_t) == 16, "undo_record_t should stay 16 bytes");
+
+// update_state (the move must be legal), returning what unmake_move needs to take it back
+undo_record_t make_move(GameState_t game_state, size_t move);
+undo_record_t make_move(CompactGameState_t game_state, size_t move);
+// restores the state from before make_move bit for bit, the hash and turn count included. records have to be
+// unmade in the reverse order they were made in
+void unmake_move(GameState_t game_state, const undo_record_t& record);
+void unmake_move(CompactGameState_t game_state, const undo_record_t& record);
+
+// the records of a line of moves, for depth-first search and rollouts that go back to where they started. the
+// capacity is allocated up front and never grows
+class UndoStack_t {
+public:
+    explicit UndoStack_t(size_t capacity) : records(capacity) {}
+
+    // make_move, with the record pushed. throws std::length_error when the stack is full
+    void make(GameState_t game_state, size_t move);
+    void make(CompactGameState_t game_state, size_t move);
+    // unmake the last move made. throws std::logic_error when the stack is empty
+    void unmake(GameState_t game_state);
+    void unmake(CompactGameState_t game_state);
+    // unmake everything, back to the state the first make started from
+    void unmake_all(GameState_t game_state);
+    void unmake_all(CompactGameState_t game_state);
+
+    size_t size() const {
+        return n_records;
+    }
+
+    size_t capacity() const {
+        return records.size();
+    }
+
+    bool empty() const {
+        return n_records == 0;
+    }
+
+    // forget the records without unmaking them
+    void clear() {
+        n_records = 0;
+    }
+
+private:
+    std::vector<undo_record_t> records;
+    size_t n_records = 0;
+};
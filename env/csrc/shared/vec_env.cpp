@@ -0,0 +1,170 @@
+#include "vec_env.h"
+#include "board.h"
+#include "constants.h"
+#include "engine.h"
+#include "episode.h"
+#include "mask_cache.h"
+#include "observation.h"
+#include "stats.h"
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+// a step of a few hundred envs takes tens of microseconds, so waiting starts with spinning and only backs off to
+// yielding and then to short sleeps when nothing happens for a while, which keeps idle workers off the cpus
+template <typename F>
+static void wait_until(const F& ready) {
+    for (int i = 0; i < 2048; i++) {
+        if (ready())
+            return;
+    }
+    for (int i = 0; i < 256; i++) {
+        if (ready())
+            return;
+        std::this_thread::yield();
+    }
+    while (!ready()) {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+}
+
+VecEnv_t::VecEnv_t(int n_envs, int n_workers, const vec_env_buffers_t& buffers, const episode_limits_t& limits)
+    : n_envs(n_envs), n_workers(n_workers), limits(limits), buffers(buffers), caches(std::max(n_envs, 0)),
+      trackers(std::max(n_envs, 0)), workers(std::max(n_workers, 0)) {
+    if (n_envs <= 0 || n_workers < 0)
+        throw std::invalid_argument("VecEnv needs n_envs > 0 and n_workers >= 0");
+    if (limits.max_turns < 0 || limits.stall_turns < 0)
+        throw std::invalid_argument("VecEnv limits must be >= 0");
+    if (buffers.truncated == nullptr && (limits.max_turns > 0 || limits.stall_turns > 0))
+        throw std::invalid_argument("VecEnv needs a truncated buffer with episode limits");
+    if ((buffers.observations == nullptr) == (buffers.observations_bf16 == nullptr))
+        throw std::invalid_argument("VecEnv needs exactly one observation buffer");
+    // contiguous slices, the first n_envs % n_workers get one env more
+    int begin = 0;
+    for (int w = 0; w < n_workers; w++) {
+        workers[w].begin = begin;
+        begin += n_envs / n_workers + (w < n_envs % n_workers);
+        workers[w].end = begin;
+    }
+    threads.reserve(n_workers);
+    for (int w = 0; w < n_workers; w++) {
+        threads.emplace_back(&VecEnv_t::worker_loop, this, w);
+    }
+    reset();
+}
+
+VecEnv_t::~VecEnv_t() {
+    try {
+        recv();
+    } catch (const std::exception&) {
+        // the step failed, there's nothing left to hand the error to
+    }
+    if (n_workers > 0) {
+        start(COMMAND_STOP);
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+}
+
+void VecEnv_t::run(command_t command, int begin, int end) {
+    StatsTimer_t timer(KERNEL_VEC_ENV_STEP, end - begin);
+    for (int i = begin; i < end; i++) {
+        GameState_t game_state(buffers.states + (size_t)i * TOTAL_STATE);
+        int* mask = buffers.masks + (size_t)i * N_MOVES;
+        if (command == COMMAND_RESET) {
+            initialize_state(game_state);
+            init_mask_cache(game_state, caches[i]);
+            init_episode_tracker(game_state, trackers[i]);
+            write_action_mask(game_state, caches[i], mask);
+            buffers.rewards[i] = 0.0f;
+            buffers.dones[i] = false;
+            if (buffers.truncated)
+                buffers.truncated[i] = false;
+        } else if (buffers.truncated) {
+            int* final_state = buffers.final_states ? buffers.final_states + (size_t)i * TOTAL_STATE : nullptr;
+            step_state_cached_limited(game_state, caches[i], trackers[i], limits, buffers.actions[i],
+                                      buffers.rewards[i], buffers.dones[i], buffers.truncated[i], mask, final_state);
+        } else {
+            step_state_cached(game_state, caches[i], buffers.actions[i], buffers.rewards[i], buffers.dones[i], mask);
+        }
+        if (buffers.observations)
+            encode_observation(game_state, buffers.observations + (size_t)i * OBS_SIZE, buffers.layout);
+        else
+            encode_observation(game_state, buffers.observations_bf16 + (size_t)i * OBS_SIZE, buffers.layout);
+    }
+}
+
+// the command is written before the generation is bumped, and the release/acquire pair on the generation makes it
+// (and the actions buffer) visible to the workers. their done stores pair with the acquire loads in ready() the
+// same way for the outputs
+void VecEnv_t::start(command_t command) {
+    this->command.store(command, std::memory_order_relaxed);
+    generation.fetch_add(1, std::memory_order_release);
+}
+
+void VecEnv_t::worker_loop(int w) {
+    worker_t& worker = workers[w];
+    uint64_t seen = 0;
+    while (true) {
+        wait_until([&] { return generation.load(std::memory_order_acquire) != seen; });
+        seen = generation.load(std::memory_order_acquire);
+        auto current = (command_t)command.load(std::memory_order_relaxed);
+        if (current == COMMAND_STOP)
+            return;
+        // an exception escaping the thread would terminate the process, recv() rethrows it on the caller's
+        try {
+            run(current, worker.begin, worker.end);
+        } catch (...) {
+            worker.error = std::current_exception();
+        }
+        worker.done.store(seen, std::memory_order_release);
+    }
+}
+
+bool VecEnv_t::ready() const {
+    uint64_t current = generation.load(std::memory_order_relaxed);
+    for (const auto& worker : workers) {
+        if (worker.done.load(std::memory_order_acquire) != current)
+            return false;
+    }
+    return true;
+}
+
+void VecEnv_t::reset() {
+    recv();
+    if (n_workers == 0) {
+        run(COMMAND_RESET, 0, n_envs);
+        return;
+    }
+    start(COMMAND_RESET);
+    in_flight = true;
+    recv();
+}
+
+void VecEnv_t::send() {
+    if (in_flight)
+        throw std::logic_error("VecEnv::send called again before recv");
+    if (n_workers == 0) {
+        run(COMMAND_STEP, 0, n_envs);
+        return;
+    }
+    start(COMMAND_STEP);
+    in_flight = true;
+}
+
+void VecEnv_t::recv() {
+    if (!in_flight)
+        return;
+    wait_until([&] { return ready(); });
+    in_flight = false;
+    std::exception_ptr error;
+    for (auto& worker : workers) {
+        if (worker.error && !error)
+            error = worker.error;
+        worker.error = nullptr;
+    }
+    if (error)
+        std::rethrow_exception(error);
+}
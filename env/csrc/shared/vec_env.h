@@ -0,0 +1,85 @@
+#pragma once
+#include "board.h"
+#include "constants.h"
+#include "episode.h"
+#include "mask_cache.h"
+#include "observation.h"
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <thread>
+#include <vector>
+
+// a vectorized environment: n_envs int32 games stepped by a fixed set of worker threads, each owning a
+// contiguous slice of the envs. every buffer belongs to the caller (the python side hands in its tensors), so
+// results are read in place with no copies. the calling thread and the workers only talk through atomic
+// generation counters: send() publishes a new generation and returns, the workers pick it up, step their
+// slice and publish it back, and recv() waits until every worker has. in between, the caller is free to run
+// inference on the previous observations.
+//
+// the envs reset themselves when a game ends (like step_state) and keep their action masks in a mask cache. with
+// episode limits (see episode.h) they also reset when a game is cut, dones then stays false and truncated is set.
+// the position a game ended in is copied to final_states before the reset, if the caller gave one along with a
+// truncated buffer.
+struct vec_env_buffers_t {
+    int* states;           // n_envs x TOTAL_STATE
+    const int* actions;    // n_envs, read by send()
+    float* rewards;        // n_envs
+    bool* dones;           // n_envs, a game was won
+    int* masks;            // n_envs x N_MOVES
+    float* observations;   // n_envs x OBS_SIZE, or null when observations_bf16 is set
+    uint16_t* observations_bf16;
+    obs_layout_t layout = obs_layout_t::chw;
+    bool* truncated = nullptr;  // n_envs, a game was cut by the limits. may be null without limits
+    int* final_states = nullptr;  // n_envs x TOTAL_STATE, rows of the envs that ended this step. may be null
+};
+
+class VecEnv_t {
+public:
+    // n_workers == 0 steps every env on the calling thread inside send()
+    VecEnv_t(int n_envs, int n_workers, const vec_env_buffers_t& buffers, const episode_limits_t& limits = {});
+    ~VecEnv_t();
+    VecEnv_t(const VecEnv_t&) = delete;
+    VecEnv_t& operator=(const VecEnv_t&) = delete;
+
+    // start every env from the initial position and write its mask and observation. waits for any step in flight
+    void reset();
+    // start stepping every env with the current contents of the actions buffer. throws std::logic_error if the
+    // previous step wasn't received yet
+    void send();
+    // wait for the step started by send(), a no-op if there is none. an exception thrown while a worker stepped
+    // its slice is rethrown here (the first one if several did), its envs are then left mid-step until reset()
+    void recv();
+    // whether recv() would return without waiting
+    bool ready() const;
+
+    const int n_envs;
+    const int n_workers;
+    const episode_limits_t limits;
+
+private:
+    enum command_t { COMMAND_STEP, COMMAND_RESET, COMMAND_STOP };
+
+    // one cache line per worker so the done counters don't share lines
+    struct alignas(64) worker_t {
+        std::atomic<uint64_t> done{0};
+        int begin = 0;
+        int end = 0;
+        // set by the worker before it publishes done, taken by recv()
+        std::exception_ptr error;
+    };
+
+    void run(command_t command, int begin, int end);
+    void start(command_t command);
+    void worker_loop(int w);
+
+    vec_env_buffers_t buffers;
+    std::vector<mask_cache_t> caches;
+    std::vector<episode_tracker_t> trackers;
+
+    std::atomic<uint64_t> generation{0};
+    std::atomic<int> command{COMMAND_STEP};
+    std::vector<worker_t> workers;
+    std::vector<std::thread> threads;
+    bool in_flight = false;
+};
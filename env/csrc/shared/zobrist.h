@@ -0,0 +1,44 @@
+#pragma once
+#include "constants.h"
+#include <array>
+#include <cstdint>
+
+// zobrist keys for the 64-bit position hash kept in the state metadata. a position hashes to the XOR of
+// the keys of its pieces, of the side to move and of the hop in progress, so states with the same board
+// and the same legal moves hash the same whatever their turn_count
+struct zobrist_keys_t {
+    // piece[p][cell] for a piece of player p + 1 on a flat cell
+    std::array<std::array<uint64_t, NUM_CELLS>, N_PLAYERS> piece;
+    // xored in while it's player 2's turn
+    uint64_t player_2_to_move;
+    // hop[piece][direction] while last_skipped_piece/last_direction are set
+    std::array<std::array<uint64_t, N_DIRECTIONS>, N_PIECES_PER_PLAYER> hop;
+};
+
+// splitmix64, fixed seed so hashes are stable across builds and can be stored in datasets
+constexpr uint64_t zobrist_next(uint64_t& seed) {
+    seed += 0x9e3779b97f4a7c15ULL;
+    uint64_t z = seed;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+constexpr zobrist_keys_t make_zobrist_keys() {
+    zobrist_keys_t keys{};
+    uint64_t seed = 0x4368696e65736543ULL;
+    for (size_t p = 0; p < N_PLAYERS; p++) {
+        for (size_t cell = 0; cell < NUM_CELLS; cell++) {
+            keys.piece[p][cell] = zobrist_next(seed);
+        }
+    }
+    keys.player_2_to_move = zobrist_next(seed);
+    for (size_t i = 0; i < N_PIECES_PER_PLAYER; i++) {
+        for (size_t d = 0; d < N_DIRECTIONS; d++) {
+            keys.hop[i][d] = zobrist_next(seed);
+        }
+    }
+    return keys;
+}
+
+static constexpr zobrist_keys_t zobrist_keys = make_zobrist_keys();
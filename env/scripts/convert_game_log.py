@@ -0,0 +1,40 @@
+#!/usr/bin/env python3
+"""
+Convert game logs between the text format ("PLAYER <p> MOVE: ...") and the binary format.
+
+The direction is picked from the input: a binary log is written out as text and anything else is parsed
+as text. Every game is replayed, so an illegal move aborts the conversion.
+"""
+
+import sys
+import os
+
+# Add the project root to the path so we can import the Python module
+sys.path.append(os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+
+from src.chinese_checkers_ext import game_log_from_text, game_log_to_text
+from src.chinese_checkers_ext.game_log import GAME_LOG_MAGIC
+
+
+def main():
+    if len(sys.argv) != 3:
+        print(f"Usage: {sys.argv[0]} <input_log> <output_log>")
+        sys.exit(1)
+
+    input_path, output_path = sys.argv[1], sys.argv[2]
+    if not os.path.exists(input_path):
+        print(f"Error: File '{input_path}' does not exist.")
+        sys.exit(1)
+
+    with open(input_path, "rb") as f:
+        is_binary = f.read(len(GAME_LOG_MAGIC)) == GAME_LOG_MAGIC
+    if is_binary:
+        game_log_to_text(input_path, output_path)
+        print(f"Wrote text log: {output_path}")
+    else:
+        game_log_from_text(input_path, output_path)
+        print(f"Wrote binary log: {output_path}")
+
+
+if __name__ == "__main__":
+    main()
@@ -3,12 +3,15 @@
 Validate moves in a Chinese Checkers game log file.
 
 This script reads a game log file and validates each move to identify any
-correctness issues in either the move generation or rendering.
+correctness issues in either the move generation or rendering. Binary logs
+(generate's default output) are converted to text first, so line numbers
+refer to the text form.
 """
 
 import sys
 import os
 import pathlib
+import tempfile
 from dataclasses import dataclass
 from typing import List, Tuple, Optional
 
@@ -23,7 +26,9 @@ from src.chinese_checkers_ext import (
     even_row_neighbors,
     odd_row_neighbors,
     double_step_neighbors,
+    game_log_to_text,
 )
+from src.chinese_checkers_ext.game_log import GAME_LOG_MAGIC
 
 # Constants
 EMPTY = 0
@@ -284,18 +289,35 @@ def validate_move(game_state: GameState, move: Move) -> Tuple[bool, str]:
     return True, ""
 
 
+def read_log_lines(log_path: str) -> List[str]:
+    """Read the lines of a text log, or of the text form of a binary log."""
+    with open(log_path, 'rb') as f:
+        is_binary = f.read(len(GAME_LOG_MAGIC)) == GAME_LOG_MAGIC
+    if not is_binary:
+        with open(log_path, 'r') as f:
+            return f.readlines()
+    with tempfile.TemporaryDirectory() as tmp_dir:
+        text_path = os.path.join(tmp_dir, "log.txt")
+        game_log_to_text(log_path, text_path)
+        with open(text_path, 'r') as f:
+            return f.readlines()
+
+
 def validate_log_file(log_path: str) -> List[Tuple[int, str, str]]:
     """
     Validate all moves in a game log file.
     Returns a list of errors with line number, move, and error message.
     """
-    with open(log_path, 'r') as f:
-        lines = f.readlines()
+    lines = read_log_lines(log_path)
     
     errors = []
     game_state = GameState()
     
     for i, line in enumerate(lines):
+        # "GAME <g>" starts the next game of a multi-game log
+        if line.startswith("GAME "):
+            game_state = GameState()
+            continue
         move = parse_move(line)
         if not move:
             errors.append((i+1, line.strip(), "Could not parse move"))
@@ -310,8 +332,7 @@ def validate_log_file(log_path: str) -> List[Tuple[int, str, str]]:
 
 def analyze_piece_distribution(log_path: str):
     """Analyze how many times each piece is moved in the game."""
-    with open(log_path, 'r') as f:
-        lines = f.readlines()
+    lines = read_log_lines(log_path)
     
     player1_piece_counts = [0] * 10
     player2_piece_counts = [0] * 10
@@ -336,7 +357,7 @@ def analyze_piece_distribution(log_path: str):
 
 def main():
     if len(sys.argv) < 2:
-        print(f"Usage: {sys.argv[0]} <game_log_file>")
+        print(f"Usage: {sys.argv[0]} <game_log_file> (text or binary)")
         sys.exit(1)
     
     log_path = sys.argv[1]
@@ -345,7 +366,12 @@ def main():
         sys.exit(1)
     
     print(f"Validating game log: {log_path}")
-    errors = validate_log_file(log_path)
+    try:
+        errors = validate_log_file(log_path)
+    except RuntimeError as e:
+        # converting a binary log replays it, so an illegal move stops the conversion
+        print(f"❌ Could not read the binary log: {e}")
+        sys.exit(1)
     
     if not errors:
         print("✅ All moves are valid!")
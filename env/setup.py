@@ -17,8 +17,12 @@ def get_extensions():
         "-Wl,-rpath,@loader_path",
     ]
     extra_compile_args = {
-        "cxx": ["-O3" if not debug_mode else "-O0", "-fdiagnostics-color=always", "-g" if debug_mode else ""],
+        # NDEBUG like the cmake Release build: it drops the asserts and the mask cache's full-recompute check
+        "cxx": ["-O3" if not debug_mode else "-O0", "-fdiagnostics-color=always", "-g" if debug_mode else "-DNDEBUG"],
     }
+    # STATS=1 compiles in the engine counters behind get_stats() and the trace events, see csrc/shared/stats.h
+    if os.getenv("STATS", "0") == "1":
+        extra_compile_args["cxx"].append("-DCHINESE_CHECKERS_STATS")
 
     this_dir = os.path.dirname(os.path.abspath(__file__))
     extensions_dir = os.path.join(this_dir, "csrc")
@@ -1,6 +1,6 @@
 import torch
 from . import _C as c_ext
-from typing import Callable
+from typing import Callable, Tuple
 
 even_row_neighbors = c_ext.even_row_neighbors
 odd_row_neighbors = c_ext.odd_row_neighbors
@@ -11,8 +11,104 @@ N_PIECES_PER_PLAYER = c_ext.N_PIECES_PER_PLAYER
 N_DIRECTIONS = c_ext.N_DIRECTIONS
 N_MOVES = c_ext.N_MOVES
 TOTAL_STATE = c_ext.TOTAL_STATE
+COMPACT_STATE = c_ext.COMPACT_STATE
+BITBOARD_STATE = c_ext.BITBOARD_STATE
+N_VALID_CELLS = c_ext.N_VALID_CELLS
+N_TURN_MOVES = c_ext.N_TURN_MOVES
+MASK_CACHE_SIZE = c_ext.MASK_CACHE_SIZE
+N_OBS_CHANNELS = c_ext.N_OBS_CHANNELS
+OBS_SIZE = c_ext.OBS_SIZE
+N_SYMMETRIES = c_ext.N_SYMMETRIES
+SYM_IDENTITY = c_ext.SYM_IDENTITY
+SYM_MIRROR = c_ext.SYM_MIRROR
+SYM_SWAP = c_ext.SYM_SWAP
+SYM_MIRROR_SWAP = c_ext.SYM_MIRROR_SWAP
+N_STAR_POINTS = c_ext.N_STAR_POINTS
+STATS_ENABLED = c_ext.STATS_ENABLED
+N_EVAL_FEATURES = c_ext.N_EVAL_FEATURES
+EVAL_DISTANCE_1 = c_ext.EVAL_DISTANCE_1
+EVAL_DISTANCE_2 = c_ext.EVAL_DISTANCE_2
+EVAL_HOME_1 = c_ext.EVAL_HOME_1
+EVAL_HOME_2 = c_ext.EVAL_HOME_2
+EPISODE_TRACKER_SIZE = c_ext.EPISODE_TRACKER_SIZE
 MIN_MAX_COLS = c_ext.min_max_cols
+STEP_TARGETS = c_ext.step_targets
+JUMP_TARGETS = c_ext.jump_targets
+SYMMETRY_CELLS = c_ext.symmetry_cells
+SYMMETRY_DIRECTIONS = c_ext.symmetry_directions
+SYMMETRY_MOVES = c_ext.symmetry_moves
+STAR_POINT_CELLS = c_ext.star_point_cells
+GOAL_CELLS = c_ext.goal_cells
+VALID_CELLS = c_ext.valid_cells
+ZOBRIST_PIECE_KEYS = c_ext.zobrist_piece_keys
+ZOBRIST_PLAYER_2_KEY = c_ext.zobrist_player_2_key
+ZOBRIST_HOP_KEYS = c_ext.zobrist_hop_keys
 
-initialize_state_batched: Callable[[int], torch.Tensor] = c_ext.initialize_state_batched
+initialize_state_batched: Callable[..., torch.Tensor] = c_ext.initialize_state_batched
+to_compact_batched: Callable[[torch.Tensor], torch.Tensor] = c_ext.to_compact_batched
+from_compact_batched: Callable[[torch.Tensor], torch.Tensor] = c_ext.from_compact_batched
+get_state_hash_batched: Callable[[torch.Tensor], torch.Tensor] = c_ext.get_state_hash_batched
 get_action_mask_batched: Callable[[torch.Tensor], torch.Tensor] = c_ext.get_action_mask_batched
 update_state_batched: Callable[[torch.Tensor, torch.Tensor], int] = c_ext.update_state_batched
+get_action_mask_batched_out: Callable[[torch.Tensor, torch.Tensor], int] = c_ext.get_action_mask_batched_out
+step_batched: Callable[[torch.Tensor, torch.Tensor, torch.Tensor, torch.Tensor, torch.Tensor], int] = c_ext.step_batched
+
+init_mask_cache_batched: Callable[[torch.Tensor], torch.Tensor] = c_ext.init_mask_cache_batched
+step_cached_batched: Callable[..., int] = c_ext.step_cached_batched
+set_mask_cache_verify: Callable[[bool], None] = c_ext.set_mask_cache_verify
+get_mask_cache_verify: Callable[[], bool] = c_ext.get_mask_cache_verify
+
+encode_observation_batched: Callable[..., torch.Tensor] = c_ext.encode_observation_batched
+encode_observation_batched_out: Callable[..., int] = c_ext.encode_observation_batched_out
+step_observe_batched: Callable[..., int] = c_ext.step_observe_batched
+
+evaluate_batched: Callable[[torch.Tensor], torch.Tensor] = c_ext.evaluate_batched
+step_shaped_batched: Callable[..., int] = c_ext.step_shaped_batched
+
+init_episode_tracker_batched: Callable[[torch.Tensor], torch.Tensor] = c_ext.init_episode_tracker_batched
+step_limited_batched: Callable[..., int] = c_ext.step_limited_batched
+
+sample_actions_batched: Callable[..., torch.Tensor] = c_ext.sample_actions_batched
+sample_actions_csr_batched: Callable[..., Tuple[torch.Tensor, torch.Tensor, torch.Tensor]] = \
+    c_ext.sample_actions_csr_batched
+
+transform_state_batched: Callable[[torch.Tensor, torch.Tensor], torch.Tensor] = c_ext.transform_state_batched
+transform_actions_batched: Callable[[torch.Tensor, torch.Tensor], torch.Tensor] = c_ext.transform_actions_batched
+transform_moves_batched: Callable[[torch.Tensor, torch.Tensor], torch.Tensor] = c_ext.transform_moves_batched
+
+multiplayer_state_size: Callable[[int], int] = c_ext.multiplayer_state_size
+initialize_multiplayer_batched: Callable[[int, int], torch.Tensor] = c_ext.initialize_multiplayer_batched
+get_action_mask_multiplayer_batched: Callable[[torch.Tensor, int], torch.Tensor] = \
+    c_ext.get_action_mask_multiplayer_batched
+step_multiplayer_batched: Callable[..., int] = c_ext.step_multiplayer_batched
+
+to_bitboard_batched: Callable[[torch.Tensor], torch.Tensor] = c_ext.to_bitboard_batched
+from_bitboard_batched: Callable[[torch.Tensor], torch.Tensor] = c_ext.from_bitboard_batched
+get_action_mask_bitboard_batched: Callable[[torch.Tensor], torch.Tensor] = c_ext.get_action_mask_bitboard_batched
+update_state_bitboard_batched: Callable[[torch.Tensor, torch.Tensor], int] = c_ext.update_state_bitboard_batched
+
+get_turn_action_mask_batched: Callable[[torch.Tensor], torch.Tensor] = c_ext.get_turn_action_mask_batched
+update_state_turn_batched: Callable[[torch.Tensor, torch.Tensor], int] = c_ext.update_state_turn_batched
+
+get_action_mask_simd_batched: Callable[[torch.Tensor], torch.Tensor] = c_ext.get_action_mask_simd_batched
+set_simd_isa: Callable[[str], str] = c_ext.set_simd_isa
+get_simd_isa: Callable[[], str] = c_ext.get_simd_isa
+
+get_stats: Callable[[], dict] = c_ext.get_stats
+reset_stats: Callable[[], None] = c_ext.reset_stats
+set_trace_enabled: Callable[[bool], None] = c_ext.set_trace_enabled
+write_trace: Callable[[str], None] = c_ext.write_trace
+clear_trace: Callable[[], None] = c_ext.clear_trace
+
+write_game_log: Callable[[str, torch.Tensor, torch.Tensor], None] = c_ext.write_game_log
+game_log_from_text: Callable[[str, str], None] = c_ext.game_log_from_text
+game_log_to_text: Callable[[str, str], None] = c_ext.game_log_to_text
+from .game_log import GameLog, load_game_log
+
+MCTS = c_ext.MCTS
+VecEnv = c_ext.VecEnv
+alphabeta_search_batched: Callable[..., Tuple[torch.Tensor, torch.Tensor, torch.Tensor, torch.Tensor, float]] = \
+    c_ext.alphabeta_search_batched
+
+set_parallel_config: Callable[..., None] = c_ext.set_parallel_config
+get_parallel_config: Callable[[], Tuple[int, int]] = c_ext.get_parallel_config
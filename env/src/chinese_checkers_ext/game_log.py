@@ -0,0 +1,64 @@
+"""Zero-copy reader for the binary game logs written by `generate` and `write_game_log` (see csrc/shared/game_log.h)."""
+from typing import NamedTuple, Union
+import os
+import numpy as np
+import torch
+
+GAME_LOG_MAGIC = b"CCGLOG\0\0"
+GAME_LOG_VERSION = 2
+GAME_LOG_FINALIZED = 1
+
+_header_dtype = np.dtype([
+    ("magic", "S8"),
+    ("version", "<u4"),
+    ("header_size", "<u4"),
+    ("n_actions", "<u8"),
+    ("n_games", "<u8"),
+    ("index_offset", "<u8"),
+    ("flags", "<u8"),
+])
+
+
+class GameLog(NamedTuple):
+    # uint8 sub-move actions of every game back to back, memory-mapped copy-on-write
+    actions: Union[np.ndarray, torch.Tensor]
+    # int64, game g is actions[game_offsets[g]:game_offsets[g + 1]]
+    game_offsets: Union[np.ndarray, torch.Tensor]
+
+    @property
+    def n_games(self) -> int:
+        return len(self.game_offsets) - 1
+
+    def game(self, g: int):
+        return self.actions[int(self.game_offsets[g]):int(self.game_offsets[g + 1])]
+
+
+def load_game_log(path: str, as_torch: bool = False) -> GameLog:
+    """Map a binary game log without reading it. With as_torch the arrays are wrapped with torch.from_numpy,
+    which shares the mapping."""
+    header = np.fromfile(path, dtype=_header_dtype, count=1)
+    # numpy drops the trailing zero bytes of the magic
+    if len(header) == 0 or header["magic"][0] != GAME_LOG_MAGIC.rstrip(b"\0"):
+        raise ValueError(f"not a game log: {path}")
+    header = header[0]
+    if header["version"] != GAME_LOG_VERSION:
+        raise ValueError(f"unsupported game log version {header['version']}: {path}")
+
+    header_size = int(header["header_size"])
+    n_games = int(header["n_games"])
+    if not int(header["flags"]) & GAME_LOG_FINALIZED:
+        # the writer never finished, everything after the header is one game
+        n_actions = os.path.getsize(path) - header_size
+        game_offsets = np.array([0, n_actions], dtype=np.int64)
+    else:
+        n_actions = int(header["n_actions"])
+        game_offsets = np.memmap(path, dtype="<i8", mode="c", offset=int(header["index_offset"]), shape=(n_games + 1,))
+    # np.memmap can't map zero bytes
+    if n_actions > 0:
+        actions = np.memmap(path, dtype=np.uint8, mode="c", offset=header_size, shape=(n_actions,))
+    else:
+        actions = np.zeros(0, dtype=np.uint8)
+
+    if as_torch:
+        return GameLog(torch.from_numpy(actions), torch.from_numpy(np.asarray(game_offsets)))
+    return GameLog(actions, game_offsets)
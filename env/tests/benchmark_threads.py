@@ -0,0 +1,71 @@
+#!/usr/bin/env python3
+import os
+import time
+import torch
+import click
+from chinese_checkers_ext import (
+    initialize_state_batched,
+    get_action_mask_batched,
+    update_state_batched,
+    set_parallel_config,
+    get_parallel_config,
+)
+
+def random_steps(state, num_steps):
+    """Step every env in the batch num_steps times with uniformly random legal moves."""
+    mask_time = 0.0
+    update_time = 0.0
+    for _ in range(num_steps):
+        start_time = time.perf_counter()
+        mask = get_action_mask_batched(state)
+        mask_time += time.perf_counter() - start_time
+
+        actions = torch.multinomial(mask.float(), 1).squeeze(1).to(torch.int32)
+
+        start_time = time.perf_counter()
+        update_state_batched(state, actions)
+        update_time += time.perf_counter() - start_time
+    return mask_time, update_time
+
+@click.command()
+@click.option('--batch-size', default=16384, help='Number of environments stepped together')
+@click.option('--num-steps', default=50, help='Number of steps per measurement')
+@click.option('--grain-size', default=256, help='Minimum number of envs handed to a thread')
+@click.option('--max-threads', default=os.cpu_count(), help='Largest thread count to measure')
+def benchmark(batch_size, num_steps, grain_size, max_threads):
+    """Measure how the batched ops scale with the number of threads."""
+    # set_parallel_config only caps the ops within torch's pool, so the pool has to fit the largest count
+    torch.set_num_threads(max_threads)
+    thread_counts = [1]
+    while thread_counts[-1] * 2 <= max_threads:
+        thread_counts.append(thread_counts[-1] * 2)
+    if thread_counts[-1] != max_threads:
+        thread_counts.append(max_threads)
+
+    # every thread count steps the same games with the same actions, the results must match
+    torch.manual_seed(0)
+    reference_state = None
+    baseline = None
+    print(f"{'threads':>8} {'init (ms)':>10} {'mask (ns/env)':>14} {'update (ns/env)':>16} {'steps/s':>12} {'speedup':>8}")
+    for n_threads in thread_counts:
+        set_parallel_config(n_threads, grain_size)
+        assert get_parallel_config() == (n_threads, grain_size)
+
+        start_time = time.perf_counter()
+        state = initialize_state_batched(batch_size)
+        init_time = time.perf_counter() - start_time
+
+        torch.manual_seed(0)
+        mask_time, update_time = random_steps(state, num_steps)
+        if reference_state is None:
+            reference_state = state
+        assert torch.equal(state, reference_state), f"Results differ with {n_threads} threads"
+
+        n_env_steps = batch_size * num_steps
+        steps_per_sec = n_env_steps / (mask_time + update_time)
+        baseline = baseline or steps_per_sec
+        print(f"{n_threads:>8} {init_time * 1e3:>10.2f} {mask_time / n_env_steps * 1e9:>14.1f} "
+              f"{update_time / n_env_steps * 1e9:>16.1f} {steps_per_sec:>12.0f} {steps_per_sec / baseline:>7.2f}x")
+
+if __name__ == "__main__":
+    benchmark()
@@ -1,15 +1,36 @@
 import torch
 import numpy as np
 import pytest
+import json
 import random
 from typing import List, Tuple, Optional
 
 # Import the C++ extension module
 from chinese_checkers_ext import (
     initialize_state_batched, get_action_mask_batched, update_state_batched,
+    get_action_mask_batched_out, step_batched,
+    COMPACT_STATE, to_compact_batched, from_compact_batched,
     ROWS, COLS, N_PIECES_PER_PLAYER, N_DIRECTIONS, N_MOVES, TOTAL_STATE,
     even_row_neighbors, odd_row_neighbors, double_step_neighbors,
-    MIN_MAX_COLS
+    MIN_MAX_COLS, STEP_TARGETS, JUMP_TARGETS, BITBOARD_STATE,
+    to_bitboard_batched, from_bitboard_batched,
+    get_action_mask_bitboard_batched, update_state_bitboard_batched,
+    N_VALID_CELLS, N_TURN_MOVES, VALID_CELLS,
+    get_turn_action_mask_batched, update_state_turn_batched,
+    get_action_mask_simd_batched, set_simd_isa,
+    get_state_hash_batched, ZOBRIST_PIECE_KEYS, ZOBRIST_PLAYER_2_KEY, ZOBRIST_HOP_KEYS,
+    MCTS, alphabeta_search_batched,
+    write_game_log, load_game_log, game_log_from_text, game_log_to_text,
+    MASK_CACHE_SIZE, init_mask_cache_batched, step_cached_batched, set_mask_cache_verify, get_mask_cache_verify,
+    N_OBS_CHANNELS, OBS_SIZE, encode_observation_batched, encode_observation_batched_out, step_observe_batched,
+    N_SYMMETRIES, SYM_IDENTITY, SYM_SWAP, SYMMETRY_CELLS, SYMMETRY_MOVES,
+    transform_state_batched, transform_actions_batched, transform_moves_batched, VecEnv,
+    N_STAR_POINTS, STAR_POINT_CELLS, multiplayer_state_size, initialize_multiplayer_batched,
+    get_action_mask_multiplayer_batched, step_multiplayer_batched,
+    STATS_ENABLED, get_stats, reset_stats, set_trace_enabled, write_trace, clear_trace,
+    N_EVAL_FEATURES, EVAL_DISTANCE_1, EVAL_HOME_1, GOAL_CELLS, evaluate_batched, step_shaped_batched,
+    EPISODE_TRACKER_SIZE, init_episode_tracker_batched, step_limited_batched,
+    sample_actions_batched, sample_actions_csr_batched, set_parallel_config, get_parallel_config,
 )
 
 # Constants
@@ -97,8 +118,7 @@ class PythonGameState:
     def save_to_tensor(self, state_tensor=None, batch_idx=0):
         """Save game state to a tensor."""
         if state_tensor is None:
-            state_tensor = torch.zeros((1, ROWS*COLS + 2*N_PIECES_PER_PLAYER*2 + 5), 
-                                      dtype=torch.int32)
+            state_tensor = torch.zeros((1, TOTAL_STATE), dtype=torch.int32)
         
         # Copy grid to tensor
         state_tensor[batch_idx, :ROWS*COLS] = torch.tensor(self.grid.flatten(), dtype=torch.int32)
@@ -121,8 +141,26 @@ class PythonGameState:
         state_tensor[batch_idx, metadata_start + 2] = self.last_direction
         state_tensor[batch_idx, metadata_start + 3] = self.winner
         state_tensor[batch_idx, metadata_start + 4] = self.turn_count
+
+        # the 64-bit hash is stored as two int32 words, low word first
+        hash_value = self.compute_hash()
+        for word in range(2):
+            value = (hash_value >> (32 * word)) & 0xFFFFFFFF
+            state_tensor[batch_idx, metadata_start + 5 + word] = value - (1 << 32) if value >= (1 << 31) else value
         
         return state_tensor
+
+    def compute_hash(self):
+        """Compute the zobrist hash of the position from scratch."""
+        hash_value = 0
+        for player, pieces in ((PLAYER1, self.player_1_pieces), (PLAYER2, self.player_2_pieces)):
+            for r, c in pieces:
+                hash_value ^= ZOBRIST_PIECE_KEYS[player - 1][r * COLS + c]
+        if self.current_player == PLAYER2:
+            hash_value ^= ZOBRIST_PLAYER_2_KEY
+        if self.last_skipped_piece != -1:
+            hash_value ^= ZOBRIST_HOP_KEYS[self.last_skipped_piece][self.last_direction]
+        return hash_value
     
     def occupied(self, r, c):
         """Check if a cell is occupied."""
@@ -329,6 +367,22 @@ def py_update_state_batched(game_state_batch, action_batch):
     
     return 0  # Return 0 to match the C++ interface
 
+# player 1 wins by stepping its last piece from (12, 4) into (13, 4)
+WINNING_MOVE = 9 * N_DIRECTIONS + 2
+
+def win_in_one_state():
+    """Return a single state where player 1 has nine pieces home and WINNING_MOVE wins."""
+    game = PythonGameState(initialize_state_batched(1))
+    game.grid[game.grid > 0] = EMPTY
+    goal = [(16, 6), (15, 5), (15, 6), (14, 5), (14, 6), (14, 7), (13, 5), (13, 6), (13, 7), (12, 4)]
+    for i, (r, c) in enumerate(goal):
+        game.player_1_pieces[i] = (r, c)
+        game.grid[r, c] = PLAYER1
+    for i, c in enumerate(range(1, 11)):
+        game.player_2_pieces[i] = (9, c)
+        game.grid[9, c] = PLAYER2
+    return game.save_to_tensor()
+
 # Test Implementations
 
 def test_initialization():
@@ -598,4 +652,759 @@ def test_random_game():
             print(f"Game over at move {move_num}. Winner: Player {game.winner}")
             break
     
-    print(f"Random game completed after {move_num + 1} moves.")
\ No newline at end of file
+    print(f"Random game completed after {move_num + 1} moves.")
+
+def test_bitboard_random_games():
+    """Test that the bitboard representation tracks the flat layout move for move."""
+    n_batch = 16
+    flat_state = initialize_state_batched(n_batch)
+    bb_state = to_bitboard_batched(flat_state)
+    assert bb_state.shape == (n_batch, BITBOARD_STATE)
+    assert torch.all(from_bitboard_batched(bb_state) == flat_state), "Bitboard round trip differs"
+
+    for move_num in range(200):
+        flat_mask = get_action_mask_batched(flat_state)
+        bb_mask = get_action_mask_bitboard_batched(bb_state)
+        assert torch.all(flat_mask == bb_mask), f"Action masks differ at move {move_num}"
+
+        actions = torch.multinomial(flat_mask.float(), 1).squeeze(1).to(torch.int32)
+        update_state_batched(flat_state, actions)
+        update_state_bitboard_batched(bb_state, actions)
+        assert torch.all(from_bitboard_batched(bb_state) == flat_state), f"States differ at move {move_num}"
+
+def test_step_batched():
+    """Test that the fused step matches update + mask and resets finished games."""
+    n_batch = 8
+    state = initialize_state_batched(n_batch)
+    expected_state = state.clone()
+    rewards = torch.zeros(n_batch, dtype=torch.float32)
+    dones = torch.zeros(n_batch, dtype=torch.bool)
+    mask = torch.zeros((n_batch, N_MOVES), dtype=torch.int32)
+    get_action_mask_batched_out(state, mask)
+    assert torch.all(mask == get_action_mask_batched(state)), "Preallocated mask differs"
+
+    for move_num in range(100):
+        actions = torch.multinomial(mask.float(), 1).squeeze(1).to(torch.int32)
+        update_state_batched(expected_state, actions)
+        step_batched(state, actions, rewards, dones, mask)
+        assert torch.all(state == expected_state), f"States differ at move {move_num}"
+        assert torch.all(mask == get_action_mask_batched(expected_state)), f"Masks differ at move {move_num}"
+        assert not dones.any() and torch.all(rewards == 0)
+
+    state = win_in_one_state()
+
+    rewards = torch.zeros(1, dtype=torch.float32)
+    dones = torch.zeros(1, dtype=torch.bool)
+    mask = torch.zeros((1, N_MOVES), dtype=torch.int32)
+    step_batched(state, torch.tensor([WINNING_MOVE], dtype=torch.int32), rewards, dones, mask)
+    assert dones[0].item(), "Finished game should be done"
+    assert rewards[0].item() == 1.0, "Winning move should be rewarded"
+    assert torch.all(state == initialize_state_batched(1)), "Finished game should be reset"
+    assert torch.all(mask == get_action_mask_batched(state)), "Mask should belong to the reset game"
+
+@pytest.mark.parametrize("compact", [False, True])
+def test_mask_cache(compact):
+    """Test that the incrementally maintained masks match step_batched over random rollouts."""
+    n_batch = 16
+    state = initialize_state_batched(n_batch, compact=compact)
+    expected_state = state.clone()
+    cache = init_mask_cache_batched(state)
+    assert cache.shape == (n_batch, MASK_CACHE_SIZE) and cache.dtype == torch.uint8
+    rewards = torch.zeros(n_batch, dtype=torch.float32)
+    dones = torch.zeros(n_batch, dtype=torch.bool)
+    expected_rewards, expected_dones = rewards.clone(), dones.clone()
+    mask = get_action_mask_batched(state)
+    expected_mask = mask.clone()
+
+    # every update is also checked against a full rebuild of the cache inside the extension
+    verify = get_mask_cache_verify()
+    set_mask_cache_verify(True)
+    try:
+        for move_num in range(300):
+            actions = torch.multinomial(mask.float(), 1).squeeze(1).to(torch.int32)
+            step_batched(expected_state, actions, expected_rewards, expected_dones, expected_mask)
+            step_cached_batched(state, cache, actions, rewards, dones, mask)
+            assert torch.all(state == expected_state), f"States differ at move {move_num}"
+            assert torch.all(mask == expected_mask), f"Masks differ at move {move_num}"
+    finally:
+        set_mask_cache_verify(verify)
+
+def reference_observation(state: torch.Tensor) -> torch.Tensor:
+    """Own/opponent/empty/hop planes of one int32 state, rotated for player 2, (N_OBS_CHANNELS, ROWS, COLS)."""
+    game = PythonGameState(state.unsqueeze(0))
+    player = game.current_player
+    obs = torch.zeros((N_OBS_CHANNELS, ROWS * COLS), dtype=torch.float32)
+    for r in range(ROWS):
+        for c in range(COLS):
+            if not is_valid_cell(r, c):
+                continue
+            cell = r * COLS + c
+            target = cell if player == PLAYER1 else SYMMETRY_CELLS[SYM_SWAP][cell]
+            value = game.grid[r, c]
+            obs[0 if value == player else 1 if value != EMPTY else 2, target] = 1.0
+    if game.last_skipped_piece != -1:
+        pieces = game.player_1_pieces if player == PLAYER1 else game.player_2_pieces
+        r, c = pieces[game.last_skipped_piece]
+        cell = r * COLS + c
+        obs[3, cell if player == PLAYER1 else SYMMETRY_CELLS[SYM_SWAP][cell]] = 1.0
+    return obs.reshape(N_OBS_CHANNELS, ROWS, COLS)
+
+def test_observation_encoder():
+    """Test the observation planes against a Python encoder, across layouts, dtypes and the fused step."""
+    n_batch = 8
+    state = initialize_state_batched(n_batch)
+    # both players see the same start position from their own side
+    swapped = state.clone()
+    swapped[:, ROWS * COLS + 4 * N_PIECES_PER_PLAYER] = PLAYER2  # current_player
+    assert torch.equal(encode_observation_batched(state), encode_observation_batched(swapped))
+
+    rewards = torch.zeros(n_batch, dtype=torch.float32)
+    dones = torch.zeros(n_batch, dtype=torch.bool)
+    mask = get_action_mask_batched(state)
+    obs = torch.empty((n_batch, OBS_SIZE), dtype=torch.bfloat16)
+    for move_num in range(60):
+        actions = torch.multinomial(mask.float(), 1).squeeze(1).to(torch.int32)
+        step_observe_batched(state, actions, rewards, dones, mask, obs, "hwc")
+        expected = torch.stack([reference_observation(state[i]) for i in range(n_batch)])
+        chw = encode_observation_batched(state)
+        assert chw.shape == (n_batch, N_OBS_CHANNELS, ROWS, COLS)
+        assert torch.equal(chw, expected), f"Observations differ at move {move_num}"
+        hwc = encode_observation_batched(state, layout="hwc", dtype="bfloat16")
+        assert torch.equal(hwc.float(), expected.permute(0, 2, 3, 1))
+        assert torch.equal(obs.view(hwc.shape), hwc), f"Fused step observation differs at move {move_num}"
+
+    out = torch.empty((n_batch, N_OBS_CHANNELS, ROWS, COLS), dtype=torch.float32)
+    encode_observation_batched_out(state, out)
+    assert torch.equal(out, encode_observation_batched(state))
+    with pytest.raises(Exception):
+        encode_observation_batched(state, layout="nchw")
+
+@pytest.mark.parametrize("compact", [False, True])
+def test_symmetries(compact):
+    """Test that transformed states have the transformed action masks, over random rollouts."""
+    n_batch = 4 * N_SYMMETRIES
+    symmetries = torch.arange(n_batch) % N_SYMMETRIES
+    state = initialize_state_batched(n_batch, compact=compact)
+    assert torch.equal(transform_state_batched(state, torch.full((n_batch,), SYM_IDENTITY)), state)
+    # the start grid is symmetric under every one of them, only the piece order and the side to move change
+    start = transform_state_batched(state, symmetries)
+    start = from_compact_batched(start) if compact else start
+    assert torch.equal(start[:, :ROWS * COLS], initialize_state_batched(n_batch)[:, :ROWS * COLS])
+
+    for move_num in range(120):
+        mask = get_action_mask_batched(state)
+        transformed = transform_state_batched(state, symmetries)
+        assert torch.equal(get_action_mask_batched(transformed), transform_actions_batched(mask, symmetries)), \
+            f"Masks differ at move {move_num}"
+        assert torch.equal(transform_state_batched(transformed, symmetries), state), \
+            f"Symmetry is not an involution at move {move_num}"
+
+        # playing the transformed move on the transformed state commutes with the transform
+        actions = torch.multinomial(mask.float(), 1).squeeze(1).to(torch.int32)
+        moved = transform_moves_batched(actions, symmetries)
+        assert moved.dtype == torch.int32
+        assert all(moved[i] == SYMMETRY_MOVES[symmetries[i]][actions[i]] for i in range(n_batch))
+        update_state_batched(state, actions)
+        update_state_batched(transformed, moved)
+        assert torch.equal(transform_state_batched(state, symmetries), transformed), \
+            f"Transformed move differs at move {move_num}"
+
+    with pytest.raises(Exception):
+        transform_state_batched(state, torch.full((n_batch,), N_SYMMETRIES))
+
+@pytest.mark.parametrize("n_workers", [0, 3])
+def test_vec_env(n_workers):
+    """Test that the threaded vector env steps like step_batched and hands out its own buffers."""
+    n_envs = 10
+    env = VecEnv(n_envs, n_workers)
+    obs, mask = env.reset()
+    assert obs.data_ptr() == env.observations.data_ptr() and mask.data_ptr() == env.masks.data_ptr()
+    expected_state = initialize_state_batched(n_envs)
+    assert torch.equal(env.states, expected_state)
+    expected_rewards = torch.zeros(n_envs, dtype=torch.float32)
+    expected_dones = torch.zeros(n_envs, dtype=torch.bool)
+    expected_mask = get_action_mask_batched(expected_state)
+
+    for move_num in range(200):
+        actions = torch.multinomial(mask.float(), 1).squeeze(1).to(torch.int32)
+        # the async half: the actions are in the env's buffer once send returns
+        env.send(actions)
+        with pytest.raises(Exception):
+            env.send(actions)
+        obs, rewards, dones, mask = env.recv()
+        step_batched(expected_state, actions, expected_rewards, expected_dones, expected_mask)
+        assert torch.equal(env.states, expected_state), f"States differ at move {move_num}"
+        assert torch.equal(mask, expected_mask) and torch.equal(rewards, expected_rewards)
+        assert torch.equal(dones, expected_dones)
+        assert torch.equal(obs, encode_observation_batched(expected_state)), f"Observations differ at move {move_num}"
+
+    # actions=None steps with whatever was written into env.actions
+    env.actions.copy_(torch.multinomial(mask.float(), 1).squeeze(1))
+    step_batched(expected_state, env.actions.clone(), expected_rewards, expected_dones, expected_mask)
+    env.step()
+    assert torch.equal(env.states, expected_state)
+
+    actions = torch.multinomial(mask.float(), 1).squeeze(1).to(torch.int32)
+    bad = actions.clone()
+    bad[3] = N_MOVES
+    with pytest.raises(RuntimeError):
+        env.send(bad)
+    bad[3] = (mask[3] == 0).nonzero()[0, 0].item()
+    with pytest.raises(RuntimeError):
+        env.send(bad)
+    # nothing was stepped, so the env takes the next send
+    env.step(actions)
+
+@pytest.mark.parametrize("n_workers", [0, 2])
+def test_vec_env_worker_error(n_workers):
+    """Test that an exception thrown while stepping is raised by recv instead of ending the process."""
+    env = VecEnv(4, n_workers)
+    obs, mask = env.reset()
+    verify = get_mask_cache_verify()
+    set_mask_cache_verify(True)
+    try:
+        # move player 2's first piece to the center behind the mask cache's back, the next cached update of env 0
+        # then disagrees with a rebuild
+        env.states[0, 16 * COLS + 6] = EMPTY
+        env.states[0, 8 * COLS + 6] = PLAYER2
+        env.states[0, ROWS * COLS + 2 * N_PIECES_PER_PLAYER:ROWS * COLS + 2 * N_PIECES_PER_PLAYER + 2] = \
+            torch.tensor([8, 6], dtype=torch.int32)
+        actions = torch.multinomial(mask.float(), 1).squeeze(1).to(torch.int32)
+        with pytest.raises(RuntimeError):
+            env.step(actions)
+        # the env is usable again after a reset
+        obs, mask = env.reset()
+        env.step(torch.multinomial(mask.float(), 1).squeeze(1).to(torch.int32))
+    finally:
+        set_mask_cache_verify(verify)
+
+@pytest.mark.parametrize("n_players", [2, 3, 4, 6])
+def test_multiplayer(n_players):
+    """Test the star for 2, 3, 4 and 6 players: 2 players play the 2-player game, and no piece is ever lost."""
+    n_batch = 8
+    cells = [cell for point in STAR_POINT_CELLS for cell in point]
+    assert len(set(cells)) == N_STAR_POINTS * N_PIECES_PER_PLAYER
+    assert all(is_valid_cell(cell // COLS, cell % COLS) for cell in cells)
+    state = initialize_multiplayer_batched(n_batch, n_players)
+    assert state.shape == (n_batch, multiplayer_state_size(n_players)) and state.dtype == torch.uint8
+    rewards = torch.zeros(n_batch, dtype=torch.float32)
+    dones = torch.zeros(n_batch, dtype=torch.bool)
+    mask = get_action_mask_multiplayer_batched(state, n_players)
+    expected_state = initialize_state_batched(n_batch)
+    expected_rewards = rewards.clone()
+    expected_dones = dones.clone()
+    expected_mask = get_action_mask_batched(expected_state)
+
+    for move_num in range(300):
+        grid = state[:, :ROWS * COLS].view(torch.int8)
+        for player in range(1, n_players + 1):
+            assert torch.all((grid == player).sum(dim=1) == N_PIECES_PER_PLAYER), f"Pieces lost at move {move_num}"
+        if n_players == 2:
+            assert torch.equal(grid.int(), expected_state[:, :ROWS * COLS]), f"Grids differ at move {move_num}"
+            assert torch.equal(mask, expected_mask), f"Masks differ at move {move_num}"
+        actions = torch.multinomial(mask.float(), 1).squeeze(1).to(torch.int32)
+        step_multiplayer_batched(state, actions, rewards, dones, mask, n_players)
+        if n_players == 2:
+            step_batched(expected_state, actions, expected_rewards, expected_dones, expected_mask)
+            assert torch.equal(rewards, expected_rewards) and torch.equal(dones, expected_dones)
+
+    with pytest.raises(Exception):
+        initialize_multiplayer_batched(n_batch, 5)
+    with pytest.raises(Exception):
+        get_action_mask_multiplayer_batched(state, 6 if n_players != 6 else 4)
+
+def test_stats(tmp_path):
+    """Test the engine counters, which only count in a CHINESE_CHECKERS_STATS build."""
+    n_batch = 16
+    reset_stats()
+    set_trace_enabled(True)
+    state = initialize_state_batched(n_batch)
+    rewards = torch.zeros(n_batch, dtype=torch.float32)
+    dones = torch.zeros(n_batch, dtype=torch.bool)
+    mask = get_action_mask_batched(state)
+    n_wins = 0
+    for _ in range(50):
+        actions = torch.multinomial(mask.float(), 1).squeeze(1).to(torch.int32)
+        step_batched(state, actions, rewards, dones, mask)
+        n_wins += dones.sum().item()
+    set_trace_enabled(False)
+    stats = get_stats()
+    assert stats["enabled"] == STATS_ENABLED
+    step = stats["kernels"]["step_batched"]
+    if not STATS_ENABLED:
+        assert step["calls"] == 0 and sum(stats["legal_moves"]) == 0
+        return
+    assert step["calls"] == 50 and step["states"] == 50 * n_batch and step["ns"] > 0
+    assert stats["kernels"]["update_state"]["calls"] == 50 * n_batch
+    # one mask per state from get_action_mask_batched, then one per step. only the steps' masks go to a game
+    assert stats["kernels"]["set_action_mask"]["calls"] == 51 * n_batch
+    assert sum(stats["legal_moves"]) == 50 * n_batch
+    assert stats["hop_chains"] <= stats["hop_jumps"]
+    assert sum(stats["wins"]) == n_wins
+
+    trace = tmp_path / "trace.json"
+    write_trace(str(trace))
+    events = json.loads(trace.read_text())["traceEvents"]
+    assert sum(event["name"] == "step_batched" for event in events) == 50
+    clear_trace()
+    reset_stats()
+    assert get_stats()["kernels"]["step_batched"]["calls"] == 0
+
+    # search walks positions no game reaches, they only show up in the kernel calls
+    alphabeta_search_batched(state[:2], max_depth=2, time_limit_ms=1000)
+    stats = get_stats()
+    assert stats["kernels"]["set_action_mask"]["calls"] > 0
+    assert sum(stats["legal_moves"]) == 0 and sum(stats["wins"]) == 0 and stats["hop_jumps"] == 0
+
+    # the other step ops are timed like step_batched and count their games the same way
+    reset_stats()
+    mask = get_action_mask_batched(state)
+    actions = torch.multinomial(mask.float(), 1).squeeze(1).to(torch.int32)
+    step_shaped_batched(state, actions, rewards, dones, mask, 0.1)
+    evaluate_batched(state)
+    actions = torch.multinomial(mask.float(), 1).squeeze(1).to(torch.int32)
+    truncated = torch.zeros(n_batch, dtype=torch.bool)
+    step_limited_batched(state, init_episode_tracker_batched(state), actions, rewards, dones, truncated, mask,
+                         torch.tensor([0], dtype=torch.int32), torch.tensor([0], dtype=torch.int32))
+    star = initialize_multiplayer_batched(n_batch, 6)
+    star_mask = get_action_mask_multiplayer_batched(star, 6)
+    actions = torch.multinomial(star_mask.float(), 1).squeeze(1).to(torch.int32)
+    step_multiplayer_batched(star, actions, rewards, dones, star_mask, 6)
+    stats = get_stats()
+    for name in ("step_shaped_batched", "evaluate_batched", "step_limited_batched",
+                 "get_action_mask_multiplayer_batched", "step_multiplayer_batched"):
+        assert stats["kernels"][name]["calls"] == 1 and stats["kernels"][name]["states"] == n_batch, name
+    assert sum(stats["legal_moves"]) == 3 * n_batch
+    assert len(stats["wins"]) == 6
+
+def hex_distance(cell_a: int, cell_b: int) -> int:
+    """Hex distance on the odd-row-shifted grid."""
+    (ra, ca), (rb, cb) = divmod(cell_a, COLS), divmod(cell_b, COLS)
+    dq, dr = (ca - (ra - (ra & 1)) // 2) - (cb - (rb - (rb & 1)) // 2), ra - rb
+    return (abs(dq) + abs(dr) + abs(dq + dr)) // 2
+
+def reference_features(state: torch.Tensor) -> List[int]:
+    """Goal distance and pieces home of both players, straight from the definition."""
+    grid = state[:ROWS * COLS].tolist()
+    distances, homes = [], []
+    for player in (PLAYER1, PLAYER2):
+        goal = GOAL_CELLS[player - 1]
+        pieces = [cell for cell in range(ROWS * COLS) if grid[cell] == player]
+        free = [cell for cell in goal if grid[cell] != player]
+        distances.append(sum(hex_distance(cell, free[0]) for cell in pieces if cell not in goal) if free else 0)
+        homes.append(sum(cell in goal for cell in pieces))
+    return distances + homes
+
+def test_evaluation():
+    """Test the heuristic features against the definition and the shaped rewards against step_batched."""
+    n_batch = 8
+    shaping = 0.1
+    state = initialize_state_batched(n_batch)
+    features = evaluate_batched(state)
+    assert features.shape == (n_batch, N_EVAL_FEATURES)
+    assert torch.equal(evaluate_batched(to_compact_batched(state)), features)
+    # the start position is the same for both players
+    assert features[0].tolist() == [features[0, EVAL_DISTANCE_1].item()] * 2 + [0, 0]
+
+    rewards = torch.zeros(n_batch, dtype=torch.float32)
+    dones = torch.zeros(n_batch, dtype=torch.bool)
+    mask = get_action_mask_batched(state)
+    expected_state = state.clone()
+    expected_rewards = rewards.clone()
+    expected_dones = dones.clone()
+    expected_mask = mask.clone()
+    for move_num in range(150):
+        features = evaluate_batched(state)
+        assert all(features[i].tolist() == reference_features(state[i]) for i in range(n_batch)), \
+            f"Features differ at move {move_num}"
+        player = state[:, ROWS * COLS + 4 * N_PIECES_PER_PLAYER].long()
+        before = features.gather(1, (EVAL_DISTANCE_1 + player - 1).unsqueeze(1)).squeeze(1)
+        actions = torch.multinomial(mask.float(), 1).squeeze(1).to(torch.int32)
+        step_shaped_batched(state, actions, rewards, dones, mask, shaping)
+        step_batched(expected_state, actions, expected_rewards, expected_dones, expected_mask)
+        after = evaluate_batched(state).gather(1, (EVAL_DISTANCE_1 + player - 1).unsqueeze(1)).squeeze(1)
+        assert torch.equal(state, expected_state) and torch.equal(mask, expected_mask)
+        # no game ends this early, so nothing was reset under the after features
+        assert not dones.any()
+        assert torch.allclose(rewards, expected_rewards + shaping * (before - after).float())
+
+def test_episode_limits():
+    """Test the turn caps and stall windows of step_limited_batched against a reference, and VecEnv's truncation."""
+    n_batch = 8
+    meta = ROWS * COLS + 4 * N_PIECES_PER_PLAYER
+    max_turns = torch.tensor([0, 0, 30, 30, 60, 60, 0, 0], dtype=torch.int32)
+    stall_turns = torch.tensor([12], dtype=torch.int32)
+    state = initialize_state_batched(n_batch)
+    start = state[0].clone()
+    trackers = init_episode_tracker_batched(state)
+    assert trackers.shape == (n_batch, EPISODE_TRACKER_SIZE)
+    rewards = torch.zeros(n_batch, dtype=torch.float32)
+    terminated = torch.zeros(n_batch, dtype=torch.bool)
+    truncated = torch.zeros(n_batch, dtype=torch.bool)
+    final_state = torch.zeros_like(state)
+    mask = get_action_mask_batched(state)
+
+    best = evaluate_batched(state)[:, EVAL_DISTANCE_1:EVAL_DISTANCE_1 + 2].tolist()
+    last_progress = [0] * n_batch
+    n_truncated = 0
+    for move_num in range(600):
+        actions = torch.multinomial(mask.float(), 1).squeeze(1).to(torch.int32)
+        # the reference plays the move on a copy and applies the rules of episode.h
+        after = state.clone()
+        update_state_batched(after, actions)
+        distances = evaluate_batched(after)[:, EVAL_DISTANCE_1:EVAL_DISTANCE_1 + 2].tolist()
+        expected = []
+        for i in range(n_batch):
+            player, turn = state[i, meta].item(), after[i, meta + 4].item()
+            if after[i, meta].item() != player and distances[i][player - 1] < best[i][player - 1]:
+                best[i][player - 1] = distances[i][player - 1]
+                last_progress[i] = turn
+            cut = (0 < max_turns[i].item() <= turn) or turn - last_progress[i] >= stall_turns.item()
+            expected.append(cut and after[i, meta + 3].item() == 0)
+
+        step_limited_batched(state, trackers, actions, rewards, terminated, truncated, mask, max_turns, stall_turns,
+                             final_state)
+        assert truncated.tolist() == expected, f"Truncations differ at move {move_num}"
+        assert not (terminated & truncated).any()
+        assert torch.all(rewards[truncated] == 0)
+        for i in torch.nonzero(truncated | terminated).flatten().tolist():
+            assert torch.equal(state[i], start), "A finished game wasn't reset"
+            assert torch.equal(final_state[i], after[i]), "The final state isn't the position before the reset"
+            best[i] = evaluate_batched(state[i:i + 1])[0, EVAL_DISTANCE_1:EVAL_DISTANCE_1 + 2].tolist()
+            last_progress[i] = 0
+        assert torch.equal(mask, get_action_mask_batched(state))
+        n_truncated += truncated.sum().item()
+    assert n_truncated > 0
+
+    # without limits it is step_batched
+    state = initialize_state_batched(n_batch)
+    expected_state = state.clone()
+    trackers = init_episode_tracker_batched(state)
+    no_limit = torch.zeros(1, dtype=torch.int32)
+    mask = get_action_mask_batched(state)
+    expected_mask = mask.clone()
+    expected_rewards = rewards.clone()
+    expected_dones = terminated.clone()
+    for move_num in range(100):
+        actions = torch.multinomial(mask.float(), 1).squeeze(1).to(torch.int32)
+        step_limited_batched(state, trackers, actions, rewards, terminated, truncated, mask, no_limit, no_limit)
+        step_batched(expected_state, actions, expected_rewards, expected_dones, expected_mask)
+        assert torch.equal(state, expected_state) and torch.equal(mask, expected_mask)
+        assert torch.equal(terminated, expected_dones) and not truncated.any()
+
+    env = VecEnv(4, 0, max_turns=5)
+    obs, mask = env.reset()
+    seen = torch.zeros(4, dtype=torch.bool)
+    for _ in range(200):
+        env.step(torch.multinomial(mask.float(), 1).squeeze(1).to(torch.int32))
+        assert not (env.dones & env.truncated).any()
+        assert torch.all(env.states[env.truncated, meta + 4] == 0)
+        assert torch.all(env.states[:, meta + 4] < 5)
+        assert torch.all(env.final_states[env.truncated, meta + 4] == 5)
+        seen |= env.truncated
+    assert seen.all()
+
+def test_sample_actions():
+    """Test that the sampled moves are legal, reproducible for any thread split, and follow the logits."""
+    n_batch = 64
+    state = initialize_state_batched(n_batch)
+    for _ in range(40):
+        mask = get_action_mask_batched(state)
+        update_state_batched(state, torch.multinomial(mask.float(), 1).squeeze(1).to(torch.int32))
+    mask = get_action_mask_batched(state)
+
+    moves = sample_actions_batched(state, 7, 3)
+    assert moves.dtype == torch.int32 and torch.all(mask.gather(1, moves.long().unsqueeze(1)) == 1)
+    assert torch.equal(sample_actions_batched(to_compact_batched(state), 7, 3), moves)
+    assert not torch.equal(sample_actions_batched(state, 7, 4), moves)
+    n_threads, grain_size = get_parallel_config()
+    try:
+        for threads, grain in [(1, 1), (4, 1), (4, 1000)]:
+            set_parallel_config(threads, grain)
+            assert torch.equal(sample_actions_batched(state, 7, 3), moves), f"Moves differ with {threads}/{grain}"
+    finally:
+        set_parallel_config(n_threads, grain_size)
+
+    # with env ids the draws follow the env rather than its row: the rows default to ids 0..n-1, and a shuffled
+    # sub-batch draws what its envs drew in the full batch
+    assert torch.equal(sample_actions_batched(state, 7, 3, env_ids=torch.arange(n_batch)), moves)
+    envs = torch.randperm(n_batch)[:n_batch // 3]
+    assert torch.equal(sample_actions_batched(state[envs], 7, 3, env_ids=envs), moves[envs])
+    with pytest.raises(Exception):
+        sample_actions_batched(state, 7, 3, env_ids=envs)
+
+    csr_moves, crow_indices, col_indices = sample_actions_csr_batched(state, 7, 3)
+    assert torch.equal(csr_moves, moves)
+    assert torch.equal(sample_actions_csr_batched(state[envs], 7, 3, env_ids=envs)[0], moves[envs])
+    assert torch.equal(crow_indices.diff(), mask.sum(1).to(torch.int64))
+    assert torch.equal(col_indices.long(), torch.nonzero(mask)[:, 1])
+
+    # all the weight on one legal move per row, -inf on the rest
+    favorite = torch.multinomial(mask.float(), 1).squeeze(1)
+    logits = torch.full((n_batch, N_MOVES), float("-inf"))
+    logits[torch.arange(n_batch), favorite] = 0.0
+    assert torch.equal(sample_actions_batched(state, 11, 0, logits).long(), favorite)
+
+    # +inf logits are certain: the favorite wins over any finite logit, and two +inf moves split the draws
+    logits = torch.zeros((n_batch, N_MOVES))
+    logits[torch.arange(n_batch), favorite] = float("inf")
+    assert torch.equal(sample_actions_batched(state, 11, 0, logits).long(), favorite)
+    two = torch.nonzero(mask[0]).flatten()[:2]
+    logits = torch.zeros((1, N_MOVES))
+    logits[0, two] = float("inf")
+    drawn = {sample_actions_batched(state[:1], 5, step, logits)[0].item() for step in range(64)}
+    assert drawn == set(two.tolist())
+
+    # a single state drawn over many steps follows the softmax of its legal logits
+    row = state[:1]
+    legal = torch.nonzero(mask[0]).flatten()
+    logits = torch.zeros(1, N_MOVES)
+    logits[0, legal] = torch.linspace(-1.0, 1.0, len(legal))
+    n_draws = 4000
+    counts = torch.zeros(N_MOVES)
+    for step in range(n_draws):
+        counts[sample_actions_batched(row, 5, step, logits)[0].item()] += 1
+    expected = torch.softmax(logits[0, legal], 0)
+    assert torch.all((counts[legal] / n_draws - expected).abs() < 0.03)
+    assert counts.sum() == counts[legal].sum()
+
+def test_move_target_tables():
+    """Test that the flat-cell step/jump tables match the row-parity neighbor offsets."""
+    def cell_or_sentinel(r, c):
+        return r * COLS + c if is_valid_cell(r, c) else -1
+
+    for r in range(ROWS):
+        for c in range(COLS):
+            cell = r * COLS + c
+            if not is_valid_cell(r, c):
+                assert all(t == -1 for t in STEP_TARGETS[cell]), f"Invalid cell {r},{c} has step targets"
+                assert all(t == -1 for t in JUMP_TARGETS[cell]), f"Invalid cell {r},{c} has jump targets"
+                continue
+            deltas = even_row_neighbors if r % 2 == 0 else odd_row_neighbors
+            for d in range(N_DIRECTIONS):
+                step = (r + deltas[d][0], c + deltas[d][1])
+                jump = (r + double_step_neighbors[d][0], c + double_step_neighbors[d][1])
+                assert STEP_TARGETS[cell][d] == cell_or_sentinel(*step), f"Step target wrong at {r},{c} dir {d}"
+                assert JUMP_TARGETS[cell][d] == cell_or_sentinel(*jump), f"Jump target wrong at {r},{c} dir {d}"
+
+def test_compact_layout():
+    """Test that the compact uint8 layout plays the same games as the int32 layout."""
+    n_batch = 16
+    state = initialize_state_batched(n_batch)
+    compact_state = initialize_state_batched(n_batch, compact=True)
+    assert compact_state.dtype == torch.uint8 and compact_state.shape == (n_batch, COMPACT_STATE)
+    assert compact_state.element_size() * COMPACT_STATE * 4 <= state.element_size() * TOTAL_STATE
+    assert torch.all(to_compact_batched(state) == compact_state), "Compact initialization differs"
+
+    rewards = torch.zeros(n_batch, dtype=torch.float32)
+    dones = torch.zeros(n_batch, dtype=torch.bool)
+    compact_rewards = torch.zeros(n_batch, dtype=torch.float32)
+    compact_dones = torch.zeros(n_batch, dtype=torch.bool)
+    mask = get_action_mask_batched(state)
+    compact_mask = get_action_mask_batched(compact_state)
+    for move_num in range(200):
+        assert torch.all(mask == compact_mask), f"Action masks differ at move {move_num}"
+        actions = torch.multinomial(mask.float(), 1).squeeze(1).to(torch.int32)
+        if move_num % 2 == 0:
+            update_state_batched(state, actions)
+            update_state_batched(compact_state, actions)
+            mask = get_action_mask_batched(state)
+            compact_mask = get_action_mask_batched(compact_state)
+        else:
+            step_batched(state, actions, rewards, dones, mask)
+            step_batched(compact_state, actions, compact_rewards, compact_dones, compact_mask)
+            assert torch.all(rewards == compact_rewards) and torch.all(dones == compact_dones)
+        assert torch.all(from_compact_batched(compact_state) == state), f"States differ at move {move_num}"
+
+def test_turn_action_space():
+    """Test that turn-level moves reach exactly the cells a sequence of sub-moves can end a turn on."""
+    def turn_endings(state):
+        # walk every sub-move sequence of the turn, keyed by the (piece, destination) turn move
+        start = PythonGameState(state)
+        start_pieces = start.player_1_pieces if start.current_player == PLAYER1 else start.player_2_pieces
+        endings = {}
+        stack = [state]
+        seen = set()
+        while stack:
+            s = stack.pop()
+            key = tuple(s[0].tolist())
+            if key in seen:
+                continue
+            seen.add(key)
+            mask = get_action_mask_batched(s)[0]
+            for move in torch.nonzero(mask).squeeze(1).tolist():
+                nxt = s.clone()
+                update_state_batched(nxt, torch.tensor([move], dtype=torch.int32))
+                game = PythonGameState(nxt)
+                if game.current_player == start.current_player:
+                    stack.append(nxt)
+                    continue
+                piece = PythonGameState(s).last_skipped_piece if move == N_MOVES - 1 else move // N_DIRECTIONS
+                pieces = game.player_1_pieces if start.current_player == PLAYER1 else game.player_2_pieces
+                r, c = pieces[piece]
+                # hopping around back to the starting cell is not a turn
+                if (r, c) != tuple(start_pieces[piece]):
+                    endings[piece * N_VALID_CELLS + VALID_CELLS.index(r * COLS + c)] = nxt
+        return endings
+
+    state = initialize_state_batched(1)
+    for turn_num in range(30):
+        mask = get_turn_action_mask_batched(state)
+        assert mask.shape == (1, N_TURN_MOVES)
+        endings = turn_endings(state)
+        assert set(torch.nonzero(mask[0]).squeeze(1).tolist()) == set(endings), f"Turn masks differ at turn {turn_num}"
+
+        move = random.choice(sorted(endings))
+        update_state_turn_batched(state, torch.tensor([move], dtype=torch.int32))
+        expected = PythonGameState(endings[move])
+        game = PythonGameState(state)
+        assert game.current_player == expected.current_player, f"Turn not ended at turn {turn_num}"
+        assert np.array_equal(game.grid, expected.grid), f"Boards differ at turn {turn_num}"
+        if game.winner != 0:
+            break
+
+def test_simd_action_mask():
+    """Test that the SIMD mask kernel matches get_action_mask_batched on about a million random positions."""
+    # one extra env past a multiple of 16 so every ISA also runs its scalar tail
+    n_batch = 4097
+    isas = [isa for isa in ("scalar", "avx2", "avx512") if set_simd_isa(isa) == isa]
+    try:
+        for compact in (False, True):
+            state = initialize_state_batched(n_batch, compact=compact)
+            rewards = torch.zeros(n_batch, dtype=torch.float32)
+            dones = torch.zeros(n_batch, dtype=torch.bool)
+            mask = get_action_mask_batched(state)
+            for move_num in range(128):
+                for isa in isas:
+                    set_simd_isa(isa)
+                    assert torch.equal(get_action_mask_simd_batched(state), mask), \
+                        f"{isa} masks differ at move {move_num} (compact={compact})"
+                actions = torch.multinomial(mask.float(), 1).squeeze(1).to(torch.int32)
+                step_batched(state, actions, rewards, dones, mask)
+    finally:
+        # requests are clamped to the cpu, so this restores the best available ISA
+        set_simd_isa("avx512")
+
+def test_state_hash():
+    """Test that the incremental zobrist hash matches a from-scratch hash and identifies transpositions."""
+    n_batch = 16
+    state = initialize_state_batched(n_batch)
+    for move_num in range(200):
+        hashes = get_state_hash_batched(state)
+        assert hashes.dtype == torch.int64 and hashes.shape == (n_batch,)
+        for i in range(n_batch):
+            expected = PythonGameState(state, i).compute_hash()
+            assert hashes[i].item() & 0xFFFFFFFFFFFFFFFF == expected, f"Hash differs at move {move_num}, env {i}"
+        assert torch.equal(get_state_hash_batched(to_compact_batched(state)), hashes), "Compact hash differs"
+
+        mask = get_action_mask_batched(state)
+        actions = torch.multinomial(mask.float(), 1).squeeze(1).to(torch.int32)
+        update_state_batched(state, actions)
+
+    # the same three steps in a different order reach the same position
+    first = initialize_state_batched(1)
+    second = initialize_state_batched(1)
+    for move in (38, 36, 57):
+        update_state_batched(first, torch.tensor([move], dtype=torch.int32))
+    for move in (57, 36, 38):
+        update_state_batched(second, torch.tensor([move], dtype=torch.int32))
+    assert torch.equal(first, second)
+    assert get_state_hash_batched(first).item() != get_state_hash_batched(initialize_state_batched(1)).item()
+
+def test_mcts():
+    """Test that MCTS batches leaves across trees and finds a winning move."""
+    n_batch = 4
+    calls = []
+
+    def uniform(states, masks):
+        calls.append(states.shape[0])
+        assert states.shape[1] == TOTAL_STATE and masks.shape == (states.shape[0], N_MOVES)
+        assert torch.all(masks.sum(dim=1) > 0), "Positions without a legal move should not be evaluated"
+        return torch.ones(masks.shape), torch.zeros(states.shape[0])
+
+    mcts = MCTS(n_simulations=64, leaves_per_tree=8)
+    state = initialize_state_batched(n_batch)
+    visits, values = mcts.search(state, uniform)
+    assert visits.shape == (n_batch, N_MOVES) and values.shape == (n_batch,)
+    assert torch.all(visits[get_action_mask_batched(state) == 0] == 0), "Illegal moves were visited"
+    # the first simulation of every tree expands its root
+    assert torch.all(visits.sum(dim=1) == 63)
+    assert max(calls) > n_batch, "Leaves should be evaluated in batches across trees"
+
+    visits, values = mcts.search(win_in_one_state(), uniform)
+    assert visits[0].argmax().item() == WINNING_MOVE, "MCTS should find the winning move"
+    assert values[0].item() > 0
+
+    # ten pieces can't block ten, so the empty cells are filled in to leave player 1 without a legal move
+    blocked = initialize_state_batched(1)
+    blocked[0, :ROWS * COLS][blocked[0, :ROWS * COLS] == EMPTY] = PLAYER2
+    assert get_action_mask_batched(blocked).sum().item() == 0
+    visits, values = mcts.search(torch.cat([blocked, initialize_state_batched(1)]), uniform)
+    assert torch.all(visits[0] == 0) and values[0].item() == 0.0, "A blocked root should score as a draw"
+    assert visits[1].sum().item() == 63
+
+def test_alphabeta_search():
+    """Test that alpha-beta returns legal moves, finds a win in one and reports its speed."""
+    state = initialize_state_batched(2)
+    update_state_batched(state, torch.tensor([38, 20], dtype=torch.int32))
+    best_moves, scores, depths, nodes, nodes_per_second = alphabeta_search_batched(state, max_depth=4, n_threads=2)
+    mask = get_action_mask_batched(state)
+    for i in range(2):
+        assert mask[i, best_moves[i]].item() == 1, "Best move should be legal"
+    assert torch.all(depths == 4) and torch.all(nodes > 0) and nodes_per_second > 0
+
+    best_moves, scores, _, _, _ = alphabeta_search_batched(win_in_one_state(), max_depth=3, time_limit_ms=1000)
+    assert best_moves[0].item() == WINNING_MOVE, "Alpha-beta should find the winning move"
+    assert scores[0].item() > 0
+
+def test_game_log(tmp_path):
+    """Test that binary game logs round-trip through the mmap loader and the text format."""
+    games = []
+    for length in (40, 0, 25):
+        state = initialize_state_batched(1)
+        actions = []
+        for _ in range(length):
+            legal = get_action_mask_batched(state)[0].nonzero().flatten().tolist()
+            actions.append(random.choice(legal))
+            update_state_batched(state, torch.tensor(actions[-1:], dtype=torch.int32))
+        games.append(actions)
+    actions = torch.tensor([a for game in games for a in game], dtype=torch.uint8)
+    game_offsets = torch.tensor([0, 40, 40, 65], dtype=torch.int64)
+
+    log_path = str(tmp_path / "games.cclog")
+    write_game_log(log_path, actions, game_offsets)
+    log = load_game_log(log_path, as_torch=True)
+    # the empty game is dropped
+    assert log.n_games == 2
+    assert torch.equal(log.actions, actions)
+    assert log.game_offsets.tolist() == [0, 40, 65]
+
+    text_path = str(tmp_path / "games.txt")
+    game_log_to_text(log_path, text_path)
+    lines = open(text_path).read().splitlines()
+    assert len(lines) == 66 and lines[40] == "GAME 1"
+    assert lines[0].startswith("PLAYER 1 MOVE: ")
+
+    round_trip_path = str(tmp_path / "round_trip.cclog")
+    game_log_from_text(text_path, round_trip_path)
+    assert open(round_trip_path, "rb").read() == open(log_path, "rb").read()
+
+    with open(text_path, "a") as f:
+        f.write("PLAYER 1 MOVE: 9 9\n")
+    with pytest.raises(RuntimeError):
+        game_log_from_text(text_path, round_trip_path)
+
+def test_empty_game_log(tmp_path):
+    """Test that a finalized log without actions reads back as zero games, not as an unfinished log."""
+    log_path = str(tmp_path / "empty.cclog")
+    write_game_log(log_path, torch.zeros(0, dtype=torch.uint8), torch.tensor([0, 0], dtype=torch.int64))
+    log = load_game_log(log_path)
+    assert log.n_games == 0 and len(log.actions) == 0
+    assert list(log.game_offsets) == [0]
+
+    text_path = str(tmp_path / "empty.txt")
+    game_log_to_text(log_path, text_path)
+    assert open(text_path).read() == ""
+    round_trip_path = str(tmp_path / "round_trip.cclog")
+    game_log_from_text(text_path, round_trip_path)
+    assert open(round_trip_path, "rb").read() == open(log_path, "rb").read()